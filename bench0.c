@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "radix-trie.h"
+
+/*
+ * node allocator: insert throughput and teardown time, malloc against
+ * RADIX_TRIE_ARENA, on sequential and random 32 bit keys.
+ *
+ *   bench0 [number of keys]
+ */
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#define ROUNDS 3
+
+static void
+run(const char *name, int flags, uint32_t *keys, int size)
+{
+    nod *trie;
+    double t0, t1, t2, t3, t4;
+    double best[4] = { 1e9, 1e9, 1e9, 1e9 };
+    void *val;
+    int i, r, found;
+
+    // best of ROUNDS, the first one pays for the page faults
+    for (r = 0; r < ROUNDS; r++)
+    {
+        trie = radix_trie_create(flags);
+        found = 0;
+
+        t0 = now();
+        for (i = 0; i < size; i++)
+            trie = radix_trie_insert(trie, keys[i], 32, (void*)(long)(i + 1));
+        t1 = now();
+
+        for (i = 0; i < size; i++)
+            found += radix_trie_find(trie, keys[i], 32, &val);
+        t2 = now();
+
+        // half of the keys go, and come back from the free lists
+        for (i = 0; i < size; i += 2)
+            radix_trie_delete(trie, keys[i], 32);
+        for (i = 0; i < size; i += 2)
+            trie = radix_trie_insert(trie, keys[i], 32, (void*)(long)(i + 1));
+        t3 = now();
+
+        radix_trie_delete_all(trie);
+        t4 = now();
+
+        if (t1 - t0 < best[0]) best[0] = t1 - t0;
+        if (t2 - t1 < best[1]) best[1] = t2 - t1;
+        if (t3 - t2 < best[2]) best[2] = t3 - t2;
+        if (t4 - t3 < best[3]) best[3] = t4 - t3;
+    }
+
+    printf("%-8s %-7s %8.2f %8.2f %10.2f %10.2f %s\n", name,
+           flags & RADIX_TRIE_ARENA ? "arena" : "malloc",
+           size / best[0] * 1e-6, size / best[1] * 1e-6,
+           best[2] * 1e3, best[3] * 1e3,
+           found == size ? "" : "(keys missing)");
+}
+
+int
+main(int argc, char **argv)
+{
+    int i, size = argc > 1 ? atoi(argv[1]) : 1000000;
+    uint32_t *keys = (uint32_t*)malloc(size * sizeof(uint32_t));
+
+    printf("%d keys, RADIX_TRIE_AUTO layout\n", size);
+    printf("%-8s %-7s %8s %8s %10s %10s\n", "keys", "alloc",
+           "Mins/s", "Mfind/s", "churn ms", "free ms");
+
+    for (i = 0; i < size; i++)
+        keys[i] = i;
+    run("seq", RADIX_TRIE_AUTO, keys, size);
+    run("seq", RADIX_TRIE_AUTO | RADIX_TRIE_ARENA, keys, size);
+
+    srand(1);
+    for (i = 0; i < size; i++)
+        keys[i] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+    run("random", RADIX_TRIE_AUTO, keys, size);
+    run("random", RADIX_TRIE_AUTO | RADIX_TRIE_ARENA, keys, size);
+
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "radix-trie.h"
+
+/*
+ * bulk load: radix_trie_build_sorted against an insert loop, on
+ * sequential keys (as test1) and sorted random keys.
+ *
+ *   bench1 [number of keys]
+ */
+
+#define ROUNDS 3
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int
+cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void
+run(const char *name, int flags, uint32_t *keys, void **vals, int size)
+{
+    double t0, t1, insert = 1e9, build = 1e9;
+    nod *trie;
+    int i, r;
+
+    for (r = 0; r < ROUNDS; r++)
+    {
+        trie = radix_trie_create(flags);
+        t0 = now();
+        for (i = 0; i < size; i++)
+            trie = radix_trie_insert(trie, keys[i], 32, vals[i]);
+        t1 = now();
+        radix_trie_delete_all(trie);
+        if (t1 - t0 < insert)
+            insert = t1 - t0;
+
+        trie = radix_trie_create(flags);
+        t0 = now();
+        trie = radix_trie_build_sorted(trie, keys, 0, vals, size);
+        t1 = now();
+        radix_trie_delete_all(trie);
+        if (t1 - t0 < build)
+            build = t1 - t0;
+    }
+
+    printf("%-8s %-14s %10.1f %10.1f %8.1fx\n", name,
+           flags & RADIX_TRIE_ARENA ? "auto, arena" : "auto",
+           insert * 1e3, build * 1e3, insert / build);
+}
+
+int
+main(int argc, char **argv)
+{
+    int i, size = argc > 1 ? atoi(argv[1]) : 1000000;
+    uint32_t *keys = (uint32_t*)malloc(size * sizeof(uint32_t));
+    void **vals = (void**)malloc(size * sizeof(void*));
+
+    printf("%d keys, best of %d\n", size, ROUNDS);
+    printf("%-8s %-14s %10s %10s %9s\n", "keys", "layout", "insert ms", "build ms", "speedup");
+
+    for (i = 0; i < size; i++)
+    {
+        keys[i] = i;
+        vals[i] = (void*)(long)(i + 1);
+    }
+    run("seq", RADIX_TRIE_AUTO, keys, vals, size);
+    run("seq", RADIX_TRIE_AUTO | RADIX_TRIE_ARENA, keys, vals, size);
+
+    srand(1);
+    for (i = 0; i < size; i++)
+        keys[i] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+    qsort(keys, size, sizeof(uint32_t), cmp);
+    run("random", RADIX_TRIE_AUTO, keys, vals, size);
+    run("random", RADIX_TRIE_AUTO | RADIX_TRIE_ARENA, keys, vals, size);
+
+    free(keys);
+    free(vals);
+    return 0;
+}
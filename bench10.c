@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <malloc.h>
+#include "radix-trie.h"
+
+/*
+ * RADIX_TRIE_ORDER: bytes a key and lookups per second of tries of
+ * each order in one binary, for sequential keys (as test1) and random
+ * keys (as test2). The bytes are those malloc gave out while the trie
+ * was built, the fill and depth those radix_trie_stats gives.
+ *
+ *   bench10 [number of keys]
+ */
+
+#define LOOKUPS 2000000
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+static size_t
+heap(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    return mallinfo2().uordblks;
+#else
+    return (size_t)mallinfo().uordblks;
+#endif
+}
+
+int
+main(int argc, char **argv)
+{
+    int size = argc > 1 ? atoi(argv[1]) : 1 << 20;
+    uint32_t *keys = (uint32_t*)malloc(size * sizeof(uint32_t));
+    int kind, order, i;
+
+    printf("%d keys\n", size);
+    printf("%-8s %6s %12s %12s %8s %6s\n", "keys", "order", "B/key", "Mfind/s", "fill", "depth");
+
+    for (kind = 0; kind < 2; kind++)
+    {
+        unsigned seed = 1;
+
+        for (i = 0; i < size; i++)
+            keys[i] = kind ? rnd(&seed) : (uint32_t)i;
+
+        for (order = 1; order <= 5; order++)
+        {
+            size_t h = heap();
+            struct radix_trie_stats st;
+            double t0;
+            long sum = 0;
+            void *v;
+            nod *t;
+
+            t = radix_trie_create(RADIX_TRIE_AUTO | RADIX_TRIE_ORDER(order));
+            for (i = 0; i < size; i++)
+                radix_trie_insert(t, keys[i], 32, (void*)(long)(i + 1));
+            h = heap() - h;
+
+            seed = 5;
+            t0 = now();
+            for (i = 0; i < LOOKUPS; i++)
+                if (radix_trie_find(t, keys[rnd(&seed) % size], 32, &v))
+                    sum += (long)v;
+            t0 = now() - t0;
+            if (sum == 0)
+                printf("nothing found\n");
+
+            radix_trie_stats(t, &st);
+            printf("%-8s %6d %12.1f %12.2f %8.2f %6d\n", kind ? "random" : "seq", order,
+                   (double)h / size, LOOKUPS / t0 * 1e-6, st.fill, st.depth);
+
+            radix_trie_delete_all(t);
+        }
+    }
+
+    free(keys);
+    return 0;
+}
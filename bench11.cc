@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "radix-trie.hpp"
+#include "radix-trie.h"
+
+/*
+ * radix_trie<>: lookups per second and bytes a key of the template
+ * against the C trie of the same order, for sequential keys (as test1)
+ * and random keys (as test2), values the index of each key.
+ *
+ *   bench11 [number of keys]
+ */
+
+#define LOOKUPS (1 << 22)
+#define ROUNDS 5
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+int
+main(int argc, char **argv)
+{
+    int size = argc > 1 ? atoi(argv[1]) : 1 << 20;
+    uint32_t *keys = (uint32_t*)malloc(size * sizeof(uint32_t));
+    uint32_t *q = (uint32_t*)malloc(LOOKUPS * sizeof(uint32_t));
+    int kind, i, j;
+
+    printf("%d keys, order 4\n", size);
+    printf("%-8s %12s %12s %12s\n", "keys", "C Mfind/s", "C++ Mfind/s", "C++ B/key");
+
+    for (kind = 0; kind < 2; kind++)
+    {
+        radix_trie<uint32_t, uint32_t, 4> t;
+        nod *c = radix_trie_create(RADIX_TRIE_AUTO | RADIX_TRIE_ORDER(4));
+        unsigned seed = 1;
+        double best[2] = { 1e9, 1e9 };
+        long sum = 0;
+        void *v;
+
+        for (i = 0; i < size; i++)
+        {
+            keys[i] = kind ? rnd(&seed) : (uint32_t)i;
+            radix_trie_insert(c, keys[i], 32, (void*)(long)i);
+            t.insert_or_assign(keys[i], i);
+        }
+        for (i = 0; i < LOOKUPS; i++)
+            q[i] = keys[rnd(&seed) % size];
+
+        // the best of a few rounds, in turn
+        for (j = 0; j < ROUNDS; j++)
+        {
+            double t0 = now(), t1, t2;
+
+            for (i = 0; i < LOOKUPS; i++)
+                if (radix_trie_find(c, q[i], 32, &v))
+                    sum += (long)v;
+            t1 = now();
+            for (i = 0; i < LOOKUPS; i++)
+            {
+                const uint32_t *x = t.find(q[i]);
+
+                if (x)
+                    sum -= *x;
+            }
+            t2 = now();
+            best[0] = t1 - t0 < best[0] ? t1 - t0 : best[0];
+            best[1] = t2 - t1 < best[1] ? t2 - t1 : best[1];
+        }
+        if (sum != 0)
+            printf("lookups differ\n");
+
+        printf("%-8s %12.2f %12.2f %12.1f\n", kind ? "random" : "seq",
+               LOOKUPS / best[0] * 1e-6, LOOKUPS / best[1] * 1e-6, (double)t.memory() / t.size());
+
+        radix_trie_delete_all(c);
+    }
+
+    free(q);
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,545 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <malloc.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "radix-trie.hpp"
+#include "radix-trie.h"
+
+/*
+ * the benchmark suite, "make bench" writes its CSV to bench.csv.
+ *
+ * For each key distribution and each map, the time a key of inserting
+ * every key, finding keys there and keys not there, walking the map in
+ * key order and deleting every key, in ns/op and ops/s, with the bytes
+ * a key malloc gave out for the map and the peak RSS it added. Each
+ * map runs in a process of its own, so the peak RSS is its own.
+ *
+ * Distributions, 32 bit keys:
+ *   seq        0 .. n - 1, as test1
+ *   clustered  runs of 64 to 1024 keys, 1 to 3 apart, at random places
+ *   random     uniform, as test2
+ *   cmap       Unicode code points of the blocks a CJK CMap covers
+ *   lzw        the dictionary LZW builds on text, prefix code << 8 | byte
+ *
+ * Maps: the trie of each order 1 to 5 (RADIX_TRIE_AUTO), the trie of
+ * full nodes of order 4, the layout of pat.C, radix_trie<> of
+ * radix-trie.hpp, std::map, std::unordered_map, and a sorted vector,
+ * built by one sort, whose deletes are not timed.
+ *
+ *   bench12 [number of keys [distribution]]
+ */
+
+#define LOOKUPS (1 << 20)
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+static size_t
+heap(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    return mallinfo2().uordblks;
+#else
+    return (size_t)mallinfo().uordblks;
+#endif
+}
+
+/* kB of "VmRSS" or of "VmHWM", the peak */
+static long
+rss(const char *field)
+{
+    char line[128];
+    long kb = 0;
+    FILE *f = fopen("/proc/self/status", "r");
+
+    if (!f)
+    {
+        struct rusage ru;
+
+        getrusage(RUSAGE_SELF, &ru);
+        return ru.ru_maxrss;
+    }
+    while (fgets(line, sizeof(line), f))
+        if (strncmp(line, field, strlen(field)) == 0)
+            kb = atol(line + strlen(field) + 1);
+    fclose(f);
+    return kb;
+}
+
+/* the peak starts again from the RSS now, the free memory given back */
+static void
+reset_peak(void)
+{
+    FILE *f = fopen("/proc/self/clear_refs", "w");
+
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif
+    if (f)
+    {
+        fputs("5", f);
+        fclose(f);
+    }
+}
+
+
+/* the blocks of a CJK CMap: ASCII, Latin, Greek, Cyrillic, CJK symbols, kana, ideographs, Hangul, ... */
+static const uint32_t cmap_blocks[][2] =
+{
+    { 0x0020, 0x007e }, { 0x00a0, 0x017f }, { 0x0370, 0x03ff }, { 0x0400, 0x04ff },
+    { 0x2000, 0x206f }, { 0x2100, 0x22ff }, { 0x2460, 0x24ff }, { 0x2500, 0x257f },
+    { 0x3000, 0x30ff }, { 0x3200, 0x33ff }, { 0x4e00, 0x9fff }, { 0xac00, 0xd7a3 },
+    { 0xf900, 0xfaff }, { 0xff00, 0xffef }, { 0x20000, 0x2a6df }, { 0x2a700, 0x2b73f },
+};
+
+/* the keys of a distribution, distinct, in the order they are inserted */
+static std::vector<uint32_t>
+make_keys(const char *kind, size_t n, unsigned seed)
+{
+    std::vector<uint32_t> keys;
+    size_t i, j;
+
+    keys.reserve(n);
+    if (strcmp(kind, "seq") == 0)
+    {
+        for (i = 0; i < n; i++)
+            keys.push_back((uint32_t)i);
+        return keys;
+    }
+
+    if (strcmp(kind, "cmap") == 0)
+    {
+        for (i = 0; i < sizeof(cmap_blocks) / sizeof(cmap_blocks[0]) && keys.size() < n; i++)
+            for (j = cmap_blocks[i][0]; j <= cmap_blocks[i][1] && keys.size() < n; j++)
+                keys.push_back((uint32_t)j);
+        return keys;
+    }
+
+    if (strcmp(kind, "lzw") == 0)
+    {
+        // LZW on text of a few hundred words, the dictionary never reset
+        std::unordered_map<uint32_t, uint32_t> dict;
+        std::vector<std::vector<char> > words;
+        uint32_t code = 256, w = 0;
+        bool start = true;
+
+        for (i = 0; i < 400; i++)
+        {
+            std::vector<char> word(2 + rnd(&seed) % 8);
+
+            // the first letters, the most frequent in English, come most often
+            for (j = 0; j < word.size(); j++)
+                word[j] = "etaoinshrdlucmfwypvbgkqjxz"[std::min(rnd(&seed) % 26, rnd(&seed) % 26)];
+            words.push_back(word);
+        }
+        while (keys.size() < n)
+        {
+            const std::vector<char> &word = words[rnd(&seed) % words.size()];
+
+            for (j = 0; j <= word.size() && keys.size() < n; j++)
+            {
+                uint32_t c = j < word.size() ? (unsigned char)word[j] : ' ';
+                uint32_t k = w << 8 | c;
+
+                if (start)
+                {
+                    w = c;
+                    start = false;
+                    continue;
+                }
+                std::unordered_map<uint32_t, uint32_t>::iterator x = dict.find(k);
+                if (x != dict.end())
+                {
+                    w = x->second;
+                    continue;
+                }
+                dict[k] = code++;
+                keys.push_back(k);
+                w = c;
+            }
+        }
+        return keys;
+    }
+
+    // clustered or random, the duplicates taken out in the order they came
+    std::vector<std::pair<uint32_t, size_t> > all;
+
+    while (all.size() < n + n / 4)
+    {
+        if (strcmp(kind, "clustered") == 0)
+        {
+            uint32_t base = rnd(&seed), run = 64 + rnd(&seed) % 961, step = 1 + rnd(&seed) % 3;
+
+            for (i = 0; i < run; i++)
+                all.push_back(std::make_pair(base + (uint32_t)i * step, all.size()));
+        }
+        else
+        {
+            all.push_back(std::make_pair(rnd(&seed), all.size()));
+        }
+    }
+    std::sort(all.begin(), all.end());
+    for (i = j = 0; i < all.size(); i++)
+        if (i == 0 || all[i].first != all[i - 1].first)
+            all[j++] = all[i];
+    all.resize(j);
+    std::sort(all.begin(), all.end(), [](const std::pair<uint32_t, size_t> &a, const std::pair<uint32_t, size_t> &b)
+              { return a.second < b.second; });
+    for (i = 0; i < all.size() && i < n; i++)
+        keys.push_back(all[i].first);
+    return keys;
+}
+
+
+/* the maps, with one interface, erases tells if deletes are timed */
+
+struct trie_map
+{
+    enum { erases = 1 };
+    nod *t;
+
+    explicit trie_map(int flags) : t(radix_trie_create(flags)) {}
+    ~trie_map() { radix_trie_delete_all(t); }
+
+    void insert(uint32_t k, uint32_t v) { radix_trie_insert(t, k, 32, (void*)(uintptr_t)v); }
+    bool find(uint32_t k, uint32_t *v)
+    {
+        void *x;
+
+        if (!radix_trie_find(t, k, 32, &x))
+            return false;
+        *v = (uint32_t)(uintptr_t)x;
+        return true;
+    }
+    void erase(uint32_t k) { radix_trie_delete(t, k, 32); }
+
+    static uint64_t sum;
+    static void add(uint32_t key, int bit, void *v) { sum += (uintptr_t)v; }
+    uint64_t walk() { sum = 0; radix_trie_walk(t, add); return sum; }
+};
+
+uint64_t trie_map::sum;
+
+struct cxx_map
+{
+    enum { erases = 1 };
+    radix_trie<uint32_t, uint32_t, 4> t;
+
+    void insert(uint32_t k, uint32_t v) { t.insert_or_assign(k, v); }
+    bool find(uint32_t k, uint32_t *v)
+    {
+        const uint32_t *x = t.find(k);
+
+        if (!x)
+            return false;
+        *v = *x;
+        return true;
+    }
+    void erase(uint32_t k) { t.erase(k); }
+    uint64_t walk()
+    {
+        uint64_t sum = 0;
+
+        for (radix_trie<uint32_t, uint32_t, 4>::iterator i = t.begin(); i != t.end(); ++i)
+            sum += i.value();
+        return sum;
+    }
+};
+
+template <class M>
+struct std_map
+{
+    enum { erases = 1 };
+    M t;
+
+    void insert(uint32_t k, uint32_t v) { t[k] = v; }
+    bool find(uint32_t k, uint32_t *v)
+    {
+        typename M::const_iterator x = t.find(k);
+
+        if (x == t.end())
+            return false;
+        *v = x->second;
+        return true;
+    }
+    void erase(uint32_t k) { t.erase(k); }
+    uint64_t walk()
+    {
+        uint64_t sum = 0;
+
+        for (typename M::const_iterator i = t.begin(); i != t.end(); ++i)
+            sum += i->second;
+        return sum;
+    }
+};
+
+/* keys go in unsorted, and are sorted once before the first find */
+struct sorted_vector
+{
+    enum { erases = 0 };
+    std::vector<std::pair<uint32_t, uint32_t> > t;
+
+    void insert(uint32_t k, uint32_t v) { t.push_back(std::make_pair(k, v)); }
+    void done() { std::sort(t.begin(), t.end()); }
+    void erase(uint32_t k) {}
+    bool find(uint32_t k, uint32_t *v)
+    {
+        std::vector<std::pair<uint32_t, uint32_t> >::const_iterator x =
+            std::lower_bound(t.begin(), t.end(), std::make_pair(k, (uint32_t)0));
+
+        if (x == t.end() || x->first != k)
+            return false;
+        *v = x->second;
+        return true;
+    }
+    uint64_t walk()
+    {
+        uint64_t sum = 0;
+
+        for (size_t i = 0; i < t.size(); i++)
+            sum += t[i].second;
+        return sum;
+    }
+};
+
+template <class M> static void done(M &m) {}
+static void done(sorted_vector &m) { m.done(); }
+
+
+struct result
+{
+    double ns[5];       /* insert, find hit, find miss, walk, delete */
+    double bytes;
+    long   rss;
+};
+
+template <class M>
+static void
+run(M *m, const std::vector<uint32_t> &keys, const std::vector<uint32_t> &hits,
+    const std::vector<uint32_t> &misses, const std::vector<uint32_t> &dels, result *r)
+{
+    size_t n = keys.size(), i, h = heap();
+    long kb;
+    uint64_t sum = 0, walked;
+    uint32_t v;
+    double t0;
+
+    reset_peak();
+    kb = rss("VmRSS");
+
+    t0 = now();
+    for (i = 0; i < n; i++)
+        m->insert(keys[i], (uint32_t)i + 1);
+    done(*m);
+    r->ns[0] = (now() - t0) / n * 1e9;
+    r->bytes = (double)(heap() - h) / n;
+
+    t0 = now();
+    for (i = 0; i < hits.size(); i++)
+        if (m->find(hits[i], &v))
+            sum += v;
+    r->ns[1] = (now() - t0) / hits.size() * 1e9;
+
+    t0 = now();
+    for (i = 0; i < misses.size(); i++)
+        if (m->find(misses[i], &v))
+            sum += v;
+    r->ns[2] = (now() - t0) / misses.size() * 1e9;
+
+    t0 = now();
+    walked = m->walk();
+    r->ns[3] = (now() - t0) / n * 1e9;
+
+    r->ns[4] = 0;
+    if (M::erases)
+    {
+        t0 = now();
+        for (i = 0; i < n; i++)
+            m->erase(dels[i]);
+        r->ns[4] = (now() - t0) / n * 1e9;
+    }
+    r->rss = rss("VmHWM") - kb;
+
+    if (walked != (uint64_t)n * (n + 1) / 2)
+        fprintf(stderr, "walk of %zu keys is wrong\n", n);
+    if (sum == 0)
+        fprintf(stderr, "nothing found\n");
+}
+
+static const char *const maps[] =
+{
+    "trie-o1", "trie-o2", "trie-o3", "trie-o4", "trie-o5", "trie-full-o4",
+    "radix_trie<>-o4", "std::map", "std::unordered_map", "sorted-vector",
+};
+
+/* map j on the keys, in this process */
+static void
+run_map(int j, const std::vector<uint32_t> &keys, const std::vector<uint32_t> &hits,
+        const std::vector<uint32_t> &misses, const std::vector<uint32_t> &dels, result *r)
+{
+    switch (j)
+    {
+        case 0: case 1: case 2: case 3: case 4:
+            {
+                trie_map *m = new trie_map(RADIX_TRIE_AUTO | RADIX_TRIE_ORDER(j + 1));
+                run(m, keys, hits, misses, dels, r);
+                delete m;
+            }
+            break;
+        case 5:
+            {
+                trie_map *m = new trie_map(RADIX_TRIE_FULL | RADIX_TRIE_ORDER(4));
+                run(m, keys, hits, misses, dels, r);
+                delete m;
+            }
+            break;
+        case 6:
+            {
+                cxx_map *m = new cxx_map;
+                run(m, keys, hits, misses, dels, r);
+                delete m;
+            }
+            break;
+        case 7:
+            {
+                std_map<std::map<uint32_t, uint32_t> > *m = new std_map<std::map<uint32_t, uint32_t> >;
+                run(m, keys, hits, misses, dels, r);
+                delete m;
+            }
+            break;
+        case 8:
+            {
+                std_map<std::unordered_map<uint32_t, uint32_t> > *m = new std_map<std::unordered_map<uint32_t, uint32_t> >;
+                run(m, keys, hits, misses, dels, r);
+                delete m;
+            }
+            break;
+        default:
+            {
+                sorted_vector *m = new sorted_vector;
+                run(m, keys, hits, misses, dels, r);
+                delete m;
+            }
+            break;
+    }
+}
+
+static void
+row(const char *kind, const char *map, size_t n, const result *r)
+{
+    int i;
+
+    printf("%s,%s,%zu", kind, map, n);
+    for (i = 0; i < 5; i++)
+    {
+        if (r->ns[i] > 0)
+            printf(",%.1f", r->ns[i]);
+        else
+            printf(",");
+    }
+    for (i = 0; i < 5; i++)
+    {
+        if (r->ns[i] > 0)
+            printf(",%.0f", 1e9 / r->ns[i]);
+        else
+            printf(",");
+    }
+    printf(",%.1f,%ld\n", r->bytes, r->rss);
+    fflush(stdout);
+}
+
+int
+main(int argc, char **argv)
+{
+    static const char *const kinds[] = { "seq", "clustered", "random", "cmap", "lzw" };
+    size_t n = argc > 1 ? (size_t)atol(argv[1]) : 1 << 18;
+    size_t k, j;
+
+    printf("distribution,map,keys,"
+           "insert_ns,find_hit_ns,find_miss_ns,walk_ns,delete_ns,"
+           "insert_ops_s,find_hit_ops_s,find_miss_ops_s,walk_ops_s,delete_ops_s,"
+           "bytes_per_key,peak_rss_kb\n");
+    fflush(stdout);
+
+    for (k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++)
+    {
+        if (argc > 2 && strcmp(argv[2], kinds[k]) != 0)
+            continue;
+
+        for (j = 0; j < sizeof(maps) / sizeof(maps[0]); j++)
+        {
+            int fd[2], status;
+            pid_t pid;
+            result r;
+
+            // each map in a process of its own, for its peak RSS
+            if (pipe(fd) != 0 || (pid = fork()) < 0)
+                return 1;
+            if (pid == 0)
+            {
+                std::vector<uint32_t> keys = make_keys(kinds[k], n, 1), hits, misses, dels, sorted;
+                unsigned seed = 7;
+                size_t i;
+
+                sorted = keys;
+                std::sort(sorted.begin(), sorted.end());
+                for (i = 0; i < LOOKUPS; i++)
+                    hits.push_back(keys[rnd(&seed) % keys.size()]);
+                while (misses.size() < LOOKUPS)
+                {
+                    // near the keys when there is room, else anywhere, not among them
+                    uint32_t x = keys[rnd(&seed) % keys.size()] + 1 + rnd(&seed) % 4;
+
+                    while (std::binary_search(sorted.begin(), sorted.end(), x))
+                        x = rnd(&seed);
+                    misses.push_back(x);
+                }
+                sorted.clear();
+                sorted.shrink_to_fit();
+
+                // deletes in an order of their own
+                dels = keys;
+                for (i = dels.size() - 1; i > 0; i--)
+                    std::swap(dels[i], dels[rnd(&seed) % (i + 1)]);
+
+                memset(&r, 0, sizeof(r));
+                run_map((int)j, keys, hits, misses, dels, &r);
+                if (write(fd[1], &r, sizeof(r)) != sizeof(r))
+                    _exit(1);
+                n = keys.size();
+                if (write(fd[1], &n, sizeof(n)) != sizeof(n))
+                    _exit(1);
+                _exit(0);
+            }
+            close(fd[1]);
+            size_t got = 0;
+            if (read(fd[0], &r, sizeof(r)) == sizeof(r) && read(fd[0], &got, sizeof(got)) == sizeof(got))
+                row(kinds[k], maps[j], got, &r);
+            close(fd[0]);
+            waitpid(pid, &status, 0);
+        }
+    }
+
+    return 0;
+}
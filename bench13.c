@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "radix-trie.h"
+
+/*
+ * parallel bulk load: radix_trie_build_parallel on 1, 2, 4 and 8
+ * threads against an insert loop, on random keys in no order.
+ *
+ *   bench13 [number of keys]
+ */
+
+#define ROUNDS 3
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+run(int flags, uint32_t *keys, void **vals, int size)
+{
+    double t0, t1, insert = 1e9, build[4] = { 1e9, 1e9, 1e9, 1e9 };
+    nod *trie;
+    int i, r, n;
+
+    for (r = 0; r < ROUNDS; r++)
+    {
+        trie = radix_trie_create(flags);
+        t0 = now();
+        for (i = 0; i < size; i++)
+            trie = radix_trie_insert(trie, keys[i], 32, vals[i]);
+        t1 = now();
+        radix_trie_delete_all(trie);
+        if (t1 - t0 < insert)
+            insert = t1 - t0;
+
+        for (n = 0; n < 4; n++)
+        {
+            trie = radix_trie_create(flags);
+            t0 = now();
+            trie = radix_trie_build_parallel(trie, keys, 0, vals, size, 1 << n);
+            t1 = now();
+            radix_trie_delete_all(trie);
+            if (t1 - t0 < build[n])
+                build[n] = t1 - t0;
+        }
+    }
+
+    printf("%-14s %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+           flags & RADIX_TRIE_ARENA ? "auto, arena" : "auto",
+           insert * 1e3, build[0] * 1e3, build[1] * 1e3, build[2] * 1e3, build[3] * 1e3);
+}
+
+int
+main(int argc, char **argv)
+{
+    int i, size = argc > 1 ? atoi(argv[1]) : 1000000;
+    uint32_t *keys = (uint32_t*)malloc(size * sizeof(uint32_t));
+    void **vals = (void**)malloc(size * sizeof(void*));
+
+    printf("%d keys, best of %d, ms\n", size, ROUNDS);
+    printf("%-14s %10s %10s %10s %10s %10s\n", "layout", "insert", "1 thread", "2", "4", "8");
+
+    srand(1);
+    for (i = 0; i < size; i++)
+    {
+        keys[i] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+        vals[i] = (void*)(long)(i + 1);
+    }
+    run(RADIX_TRIE_AUTO, keys, vals, size);
+    run(RADIX_TRIE_AUTO | RADIX_TRIE_ARENA, keys, vals, size);
+
+    free(keys);
+    free(vals);
+    return 0;
+}
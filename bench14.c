@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "radix-trie.h"
+
+/*
+ * parallel walk and teardown: radix_trie_walk_parallel, in no order
+ * and ordered, and radix_trie_delete_all_parallel on 1, 2, 4 and 8
+ * threads, against radix_trie_walk and radix_trie_delete_all, on
+ * random keys.
+ *
+ *   bench14 [number of keys]
+ */
+
+#define ROUNDS 3
+
+static long walked[8 * 16];
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+count(uint32_t key, int bit, void *v)
+{
+    walked[0]++;
+}
+
+/* a cache line a thread */
+static void
+count_on(uint32_t key, int bit, void *v, int thread, void *arg)
+{
+    walked[thread * 16]++;
+}
+
+static nod*
+build(uint32_t *keys, void **vals, int size)
+{
+    return radix_trie_build_parallel(radix_trie_create(RADIX_TRIE_AUTO), keys, 0, vals, size, 1);
+}
+
+int
+main(int argc, char **argv)
+{
+    int i, n, r, size = argc > 1 ? atoi(argv[1]) : 1000000;
+    uint32_t *keys = (uint32_t*)malloc(size * sizeof(uint32_t));
+    void **vals = (void**)malloc(size * sizeof(void*));
+    double t0, best[3][5];
+    nod *trie;
+
+    srand(1);
+    for (i = 0; i < size; i++)
+    {
+        keys[i] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+        vals[i] = (void*)(long)(i + 1);
+    }
+    for (i = 0; i < 3; i++)
+        for (n = 0; n < 5; n++)
+            best[i][n] = 1e9;
+
+    trie = build(keys, vals, size);
+    for (r = 0; r < ROUNDS; r++)
+    {
+        t0 = now();
+        radix_trie_walk(trie, count);
+        if (now() - t0 < best[0][0])
+            best[0][0] = now() - t0;
+        for (n = 0; n < 4; n++)
+        {
+            t0 = now();
+            radix_trie_walk_parallel(trie, count_on, 0, 1 << n, 0);
+            if (now() - t0 < best[0][n + 1])
+                best[0][n + 1] = now() - t0;
+            t0 = now();
+            radix_trie_walk_parallel(trie, count_on, 0, 1 << n, RADIX_TRIE_WALK_ORDERED);
+            if (now() - t0 < best[1][n + 1])
+                best[1][n + 1] = now() - t0;
+        }
+    }
+    radix_trie_delete_all(trie);
+
+    for (r = 0; r < ROUNDS; r++)
+    {
+        for (n = 0; n < 5; n++)
+        {
+            trie = build(keys, vals, size);
+            t0 = now();
+            if (n == 0)
+                radix_trie_delete_all(trie);
+            else
+                radix_trie_delete_all_parallel(trie, 1 << (n - 1));
+            if (now() - t0 < best[2][n])
+                best[2][n] = now() - t0;
+        }
+    }
+
+    printf("%d keys, best of %d, ms\n", size, ROUNDS);
+    printf("%-14s %10s %10s %10s %10s %10s\n", "", "serial", "1 thread", "2", "4", "8");
+    printf("%-14s %10.1f %10.1f %10.1f %10.1f %10.1f\n", "walk", best[0][0] * 1e3,
+           best[0][1] * 1e3, best[0][2] * 1e3, best[0][3] * 1e3, best[0][4] * 1e3);
+    printf("%-14s %10s %10.1f %10.1f %10.1f %10.1f\n", "walk, ordered", "",
+           best[1][1] * 1e3, best[1][2] * 1e3, best[1][3] * 1e3, best[1][4] * 1e3);
+    printf("%-14s %10.1f %10.1f %10.1f %10.1f %10.1f\n", "delete_all", best[2][0] * 1e3,
+           best[2][1] * 1e3, best[2][2] * 1e3, best[2][3] * 1e3, best[2][4] * 1e3);
+
+    free(keys);
+    free(vals);
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "radix-trie-int.h"
+
+/*
+ * batched lookups: radix_trie_find_batch against a loop of
+ * radix_trie_find, on tries of random 32 bit keys from L1 size to
+ * well beyond the last level cache. Keys are looked up in random
+ * order, in batches of BATCH keys. The batches are timed with the
+ * root slots decoded by plain C and by the widest version the cpu runs.
+ *
+ *   bench2 [largest number of keys]
+ */
+
+#define ROUNDS 3
+#define BATCH 64
+#define LOOKUPS (1 << 22)
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t
+rnd(void)
+{
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+int
+main(int argc, char **argv)
+{
+    int max = argc > 1 ? atoi(argv[1]) : 1 << 24;
+    uint32_t *keys = (uint32_t*)malloc(max * sizeof(uint32_t));
+    uint32_t *q = (uint32_t*)malloc(LOOKUPS * sizeof(uint32_t));
+    void *vals[BATCH];
+    int found[BATCH];
+    int size, i, r, wide = radix_trie_slots_kernel(RT_SLOTS_AVX2) ? RT_SLOTS_AVX2 : RT_SLOTS_SSE2;
+
+    printf("random 32 bit keys, RADIX_TRIE_AUTO, batches of %d, best of %d\n", BATCH, ROUNDS);
+    printf("%10s %12s %12s %12s %8s\n", "keys", "find Mops", "batch, C", wide == RT_SLOTS_AVX2 ? "batch, avx2" : "batch, sse2",
+           "speedup");
+
+    srand(1);
+    for (i = 0; i < max; i++)
+        keys[i] = rnd();
+
+    for (size = 1 << 8; size <= max; size <<= 2)
+    {
+        nod *trie = radix_trie_create(RADIX_TRIE_AUTO);
+        double best[3] = { 1e9, 1e9, 1e9 };
+        long hits[3] = { 0, 0, 0 };
+
+        for (i = 0; i < size; i++)
+            trie = radix_trie_insert(trie, keys[i], 32, (void*)(long)(i + 1));
+        for (i = 0; i < LOOKUPS; i++)
+            q[i] = keys[rnd() % size];
+
+        for (r = 0; r < ROUNDS; r++)
+        {
+            double t0, t1, t2, t3;
+            void *val;
+
+            hits[0] = hits[1] = hits[2] = 0;
+
+            t0 = now();
+            for (i = 0; i < LOOKUPS; i++)
+                hits[0] += radix_trie_find(trie, q[i], 32, &val);
+            radix_trie_slots_use(RT_SLOTS_SCALAR);
+            t1 = now();
+            for (i = 0; i < LOOKUPS; i += BATCH)
+                hits[1] += radix_trie_find_batch(trie, q + i, 0, BATCH, vals, found);
+            t2 = now();
+            radix_trie_slots_use(wide);
+            for (i = 0; i < LOOKUPS; i += BATCH)
+                hits[2] += radix_trie_find_batch(trie, q + i, 0, BATCH, vals, found);
+            t3 = now();
+
+            if (t1 - t0 < best[0]) best[0] = t1 - t0;
+            if (t2 - t1 < best[1]) best[1] = t2 - t1;
+            if (t3 - t2 < best[2]) best[2] = t3 - t2;
+        }
+
+        printf("%10d %12.2f %12.2f %12.2f %7.2fx %s\n", size,
+               LOOKUPS / best[0] * 1e-6, LOOKUPS / best[1] * 1e-6, LOOKUPS / best[2] * 1e-6, best[0] / best[2],
+               hits[0] == LOOKUPS && hits[1] == LOOKUPS && hits[2] == LOOKUPS ? "" : "(keys missing)");
+
+        radix_trie_delete_all(trie);
+    }
+
+    free(keys);
+    free(q);
+    return 0;
+}
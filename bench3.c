@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "radix-trie.h"
+
+/*
+ * longest prefix match: radix_trie_lpm against probing the lengths
+ * from 32 down with radix_trie_find, on a routing table of /8 to /32
+ * prefixes, mostly /24.
+ *
+ *   bench3 [number of prefixes]
+ */
+
+#define ROUNDS 3
+#define LOOKUPS (1 << 21)
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t
+rnd(void)
+{
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+int
+main(int argc, char **argv)
+{
+    static const int plen[] = { 8, 12, 16, 20, 22, 24, 24, 24, 28, 32 };
+    int size = argc > 1 ? atoi(argv[1]) : 500000;
+    uint32_t *q = (uint32_t*)malloc(LOOKUPS * sizeof(uint32_t));
+    nod *trie = radix_trie_create(RADIX_TRIE_AUTO);
+    double best[2] = { 1e9, 1e9 };
+    long hits[2];
+    void *val;
+    int i, r, l, len;
+
+    srand(1);
+    for (i = 0; i < size; i++)
+    {
+        l = plen[rand() % 10];
+        trie = radix_trie_insert(trie, rnd() >> (32 - l), l, (void*)(long)(i + 1));
+    }
+    for (i = 0; i < LOOKUPS; i++)
+        q[i] = rnd();
+
+    for (r = 0; r < ROUNDS; r++)
+    {
+        double t0, t1, t2;
+
+        hits[0] = hits[1] = 0;
+
+        t0 = now();
+        for (i = 0; i < LOOKUPS; i++)
+        {
+            for (l = 32; l > 0; l--)
+            {
+                if (radix_trie_find(trie, q[i] >> (32 - l), l, &val))
+                {
+                    hits[0]++;
+                    break;
+                }
+            }
+        }
+        t1 = now();
+        for (i = 0; i < LOOKUPS; i++)
+            hits[1] += radix_trie_lpm(trie, q[i], &len, &val);
+        t2 = now();
+
+        if (t1 - t0 < best[0]) best[0] = t1 - t0;
+        if (t2 - t1 < best[1]) best[1] = t2 - t1;
+    }
+
+    printf("%d prefixes, %d random addresses, %ld matched, best of %d\n", size, LOOKUPS, hits[1], ROUNDS);
+    printf("%-16s %10s\n", "", "Mlookup/s");
+    printf("%-16s %10.2f\n", "find, 32 probes", LOOKUPS / best[0] * 1e-6);
+    printf("%-16s %10.2f %s\n", "lpm", LOOKUPS / best[1] * 1e-6, hits[0] == hits[1] ? "" : "(results differ)");
+
+    radix_trie_delete_all(trie);
+    free(q);
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "radix-trie.h"
+
+/*
+ * range scans: the CJK unified ideographs, 4E00..9FFF, out of a map of
+ * every code point upto 10FFFF, with a cursor against filtering
+ * radix_trie_walk.
+ *
+ *   bench4
+ */
+
+#define ROUNDS 5
+#define LO 0x4e00
+#define HI 0x9fff
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static long sum;
+static int count;
+
+static void
+in_range(uint32_t key, int bit, void *v)
+{
+    if (key >= LO && key <= HI)
+    {
+        sum += (long)v;
+        count++;
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    nod *trie = radix_trie_create(RADIX_TRIE_AUTO);
+    radix_trie_cursor c;
+    double best[2] = { 1e9, 1e9 };
+    int i, r, ok, counts[2];
+
+    for (i = 0; i <= 0x10ffff; i++)
+        trie = radix_trie_insert(trie, i, 32, (void*)(long)(i + 1));
+
+    for (r = 0; r < ROUNDS; r++)
+    {
+        double t0, t1, t2;
+
+        t0 = now();
+        sum = count = 0;
+        radix_trie_walk(trie, in_range);
+        counts[0] = count;
+        t1 = now();
+        sum = count = 0;
+        for (ok = radix_trie_lower_bound(&c, trie, LO, 32); ok && (c.key >> 32) <= HI; ok = radix_trie_next(&c))
+        {
+            sum += (long)c.value;
+            count++;
+        }
+        counts[1] = count;
+        t2 = now();
+
+        if (t1 - t0 < best[0]) best[0] = t1 - t0;
+        if (t2 - t1 < best[1]) best[1] = t2 - t1;
+    }
+
+    printf("%X..%X of %d code points, best of %d\n", LO, HI, 0x110000, ROUNDS);
+    printf("%-8s %8s %10s\n", "", "entries", "ms");
+    printf("%-8s %8d %10.3f\n", "walk", counts[0], best[0] * 1e3);
+    printf("%-8s %8d %10.3f\n", "cursor", counts[1], best[1] * 1e3);
+
+    radix_trie_delete_all(trie);
+    return 0;
+}
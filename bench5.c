@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include "radix-trie.h"
+
+/*
+ * readers of a shared trie: lookups per second of 1 to max reader
+ * threads, while a writer thread inserts and deletes keys, for a
+ * RADIX_TRIE_SHARED trie with radix_trie_read_begin/end around every
+ * group of GROUP lookups, against a plain trie with a pthread rwlock
+ * taken around each of them.
+ *
+ *   bench5 [max readers] [number of keys]
+ */
+
+#define SECONDS 0.5
+#define GROUP 16
+
+static nod *trie;
+static uint32_t *keys;
+static int size;
+static int done;
+static pthread_rwlock_t lock = PTHREAD_RWLOCK_INITIALIZER;
+static int shared;
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+static void*
+reader(void *arg)
+{
+    radix_trie_reader *rd = shared ? radix_trie_reader_new(trie) : 0;
+    unsigned seed = (unsigned)(long)arg;
+    long count = 0;
+    void *val;
+    int i;
+
+    while (!__atomic_load_n(&done, __ATOMIC_RELAXED))
+    {
+        if (shared)
+        {
+            radix_trie_read_begin(rd);
+            for (i = 0; i < GROUP; i++)
+                radix_trie_find(trie, keys[rnd(&seed) % size], 32, &val);
+            radix_trie_read_end(rd);
+        }
+        else
+        {
+            for (i = 0; i < GROUP; i++)
+            {
+                pthread_rwlock_rdlock(&lock);
+                radix_trie_find(trie, keys[rnd(&seed) % size], 32, &val);
+                pthread_rwlock_unlock(&lock);
+            }
+        }
+        count += GROUP;
+    }
+
+    radix_trie_reader_free(rd);
+    return (void*)count;
+}
+
+/* a key of the second half in or out, as long as the readers read */
+static void*
+writer(void *arg)
+{
+    unsigned seed = 7;
+    long count = 0;
+
+    while (!__atomic_load_n(&done, __ATOMIC_RELAXED))
+    {
+        int i = size / 2 + rnd(&seed) % (size - size / 2);
+
+        if (!shared)
+            pthread_rwlock_wrlock(&lock);
+        if (!radix_trie_delete(trie, keys[i], 32))
+            radix_trie_insert(trie, keys[i], 32, (void*)(long)(i + 1));
+        if (!shared)
+            pthread_rwlock_unlock(&lock);
+        count++;
+    }
+    return (void*)count;
+}
+
+static void
+run(int threads, double *reads, double *writes)
+{
+    pthread_t t[64], w;
+    double t0;
+    void *r;
+    int i;
+
+    trie = radix_trie_create(RADIX_TRIE_AUTO | (shared ? RADIX_TRIE_SHARED : 0));
+    for (i = 0; i < size; i++)
+        radix_trie_insert(trie, keys[i], 32, (void*)(long)(i + 1));
+
+    done = 0;
+    for (i = 0; i < threads; i++)
+        pthread_create(&t[i], 0, reader, (void*)(long)(i + 1));
+    pthread_create(&w, 0, writer, 0);
+
+    t0 = now();
+    while (now() - t0 < SECONDS)
+    {
+        struct timespec ts = { 0, 10000000 };
+
+        nanosleep(&ts, 0);
+    }
+    __atomic_store_n(&done, 1, __ATOMIC_RELAXED);
+
+    *reads = 0;
+    for (i = 0; i < threads; i++)
+    {
+        pthread_join(t[i], &r);
+        *reads += (long)r;
+    }
+    pthread_join(w, &r);
+    *writes = (long)r;
+
+    t0 = now() - t0;
+    *reads /= t0;
+    *writes /= t0;
+
+    radix_trie_delete_all(trie);
+}
+
+int
+main(int argc, char **argv)
+{
+    int max = argc > 1 ? atoi(argv[1]) : 8;
+    unsigned seed = 1;
+    int n, i;
+
+    size = argc > 2 ? atoi(argv[2]) : 1 << 20;
+    if (max > 64)
+        max = 64;
+    keys = (uint32_t*)malloc(size * sizeof(uint32_t));
+    for (i = 0; i < size; i++)
+        keys[i] = rnd(&seed);
+
+    printf("%d random 32 bit keys, one writer, %.1f s a run\n", size, SECONDS);
+    printf("%8s %14s %14s %14s %14s\n", "readers", "shared Mops", "writes Kops", "rwlock Mops", "writes Kops");
+
+    for (n = 1; n <= max; n *= 2)
+    {
+        double r[2], w[2];
+
+        shared = 1;
+        run(n, &r[0], &w[0]);
+        shared = 0;
+        run(n, &r[1], &w[1]);
+
+        printf("%8d %14.2f %14.1f %14.2f %14.1f\n", n, r[0] * 1e-6, w[0] * 1e-3, r[1] * 1e-6, w[1] * 1e-3);
+    }
+
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include "radix-trie.h"
+
+/*
+ * concurrent inserts: 1 to 64 threads fill a trie, each with keys of a
+ * range of its own, into a RADIX_TRIE_CONCURRENT trie, against a plain
+ * trie behind one mutex.
+ *
+ *   bench6 [max threads] [number of keys]
+ */
+
+static nod *trie;
+static uint32_t *keys;
+static int size, threads, concurrent;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+static void*
+writer(void *arg)
+{
+    int t = (int)(long)arg;
+    int from = (int)((long)size * t / threads), to = (int)((long)size * (t + 1) / threads);
+    radix_trie_reader *rd = concurrent ? radix_trie_reader_new(trie) : 0;
+    int i;
+
+    for (i = from; i < to; i++)
+    {
+        if (concurrent)
+        {
+            radix_trie_read_begin(rd);
+            radix_trie_insert(trie, keys[i], 32, (void*)(long)(i + 1));
+            radix_trie_read_end(rd);
+        }
+        else
+        {
+            pthread_mutex_lock(&lock);
+            radix_trie_insert(trie, keys[i], 32, (void*)(long)(i + 1));
+            pthread_mutex_unlock(&lock);
+        }
+    }
+
+    radix_trie_reader_free(rd);
+    return 0;
+}
+
+static double
+run(void)
+{
+    pthread_t t[64];
+    double t0;
+    int i;
+
+    trie = radix_trie_create(RADIX_TRIE_AUTO | (concurrent ? RADIX_TRIE_CONCURRENT : 0));
+
+    t0 = now();
+    for (i = 0; i < threads; i++)
+        pthread_create(&t[i], 0, writer, (void*)(long)i);
+    for (i = 0; i < threads; i++)
+        pthread_join(t[i], 0);
+    t0 = now() - t0;
+
+    radix_trie_delete_all(trie);
+    return size / t0;
+}
+
+int
+main(int argc, char **argv)
+{
+    int max = argc > 1 ? atoi(argv[1]) : 64;
+    unsigned seed = 1;
+    int i;
+
+    size = argc > 2 ? atoi(argv[2]) : 1 << 20;
+    if (max > 64)
+        max = 64;
+
+    // thread t of n takes the t-th range of keys, one key in each step
+    keys = (uint32_t*)malloc(size * sizeof(uint32_t));
+    for (i = 0; i < size; i++)
+        keys[i] = (uint32_t)((uint64_t)i * 0x100000000ULL / size) + rnd(&seed) % (0x100000000ULL / size);
+
+    printf("%d 32 bit keys, a range per thread\n", size);
+    printf("%8s %14s %14s\n", "threads", "olc Mops", "mutex Mops");
+
+    for (threads = 1; threads <= max; threads *= 2)
+    {
+        double r[2];
+
+        concurrent = 1;
+        r[0] = run();
+        concurrent = 0;
+        r[1] = run();
+
+        printf("%8d %14.2f %14.2f\n", threads, r[0] * 1e-6, r[1] * 1e-6);
+    }
+
+    free(keys);
+    return 0;
+}
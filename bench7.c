@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "radix-trie.h"
+
+/*
+ * snapshots: the time radix_trie_snapshot takes, against the size of
+ * the trie, and the cost of random inserts into a trie that a snapshot
+ * holds, the first ones copying their path, against a trie held by
+ * none.
+ *
+ *   bench7 [max number of keys]
+ */
+
+#define UPDATES 100000
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+/* UPDATES random keys into t, in Mops */
+static double
+updates(nod *t, unsigned seed)
+{
+    double t0 = now();
+    int i;
+
+    for (i = 0; i < UPDATES; i++)
+        radix_trie_insert(t, rnd(&seed), 32, (void*)(long)(i + 1));
+    return UPDATES / (now() - t0) * 1e-6;
+}
+
+int
+main(int argc, char **argv)
+{
+    int max = argc > 1 ? atoi(argv[1]) : 1 << 22;
+    int size, i;
+
+    printf("%10s %14s %14s %14s\n", "keys", "snapshot us", "held Mops", "alone Mops");
+
+    for (size = 1 << 12; size <= max; size *= 4)
+    {
+        nod *t = radix_trie_create(RADIX_TRIE_AUTO), *s;
+        unsigned seed = 1;
+        double t0, snap, r[2];
+
+        for (i = 0; i < size; i++)
+            radix_trie_insert(t, rnd(&seed), 32, (void*)(long)(i + 1));
+
+        t0 = now();
+        s = radix_trie_snapshot(t);
+        snap = now() - t0;
+
+        r[0] = updates(t, 7);
+        radix_trie_delete_all(s);
+        r[1] = updates(t, 11);
+
+        printf("%10d %14.2f %14.2f %14.2f\n", size, snap * 1e6, r[0], r[1]);
+        radix_trie_delete_all(t);
+    }
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "radix-trie.h"
+
+/*
+ * images: start up by inserting every key against mapping a saved
+ * image, then lookups of random keys in the trie and in the mapping.
+ *
+ *   bench8 [number of keys]
+ */
+
+#define IMAGE "bench8.img"
+#define LOOKUPS 1000000
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+/* LOOKUPS random keys of the trie, in Mfind/s */
+static double
+lookups(nod *t, const uint32_t *keys, int size)
+{
+    unsigned seed = 3;
+    double t0 = now();
+    long sum = 0;
+    void *v;
+    int i;
+
+    for (i = 0; i < LOOKUPS; i++)
+    {
+        if (radix_trie_find(t, keys[rnd(&seed) % size], 32, &v))
+            sum += (long)v;
+    }
+    t0 = now() - t0;
+    if (sum == 0)
+        printf("nothing found\n");
+    return LOOKUPS / t0 * 1e-6;
+}
+
+int
+main(int argc, char **argv)
+{
+    int size = argc > 1 ? atoi(argv[1]) : 4 << 20;
+    uint32_t *keys = (uint32_t*)malloc(size * sizeof(uint32_t));
+    unsigned seed = 1;
+    double t0, built, saved, mapped, r[2];
+    nod *t, *img;
+    int i;
+
+    for (i = 0; i < size; i++)
+        keys[i] = rnd(&seed);
+
+    t0 = now();
+    t = radix_trie_create(RADIX_TRIE_AUTO);
+    for (i = 0; i < size; i++)
+        radix_trie_insert(t, keys[i], 32, (void*)(long)(i + 1));
+    built = now() - t0;
+
+    t0 = now();
+    radix_trie_save(t, IMAGE);
+    saved = now() - t0;
+
+    t0 = now();
+    img = radix_trie_map(IMAGE);
+    mapped = now() - t0;
+    if (!img)
+    {
+        printf("no image\n");
+        return 1;
+    }
+
+    r[0] = lookups(t, keys, size);
+    r[1] = lookups(img, keys, size);
+
+    printf("%d random 32 bit keys\n", size);
+    printf("%-10s %12s %12s\n", "", "start ms", "Mfind/s");
+    printf("%-10s %12.3f %12.2f\n", "insert", built * 1e3, r[0]);
+    printf("%-10s %12.3f %12.2f\n", "map", mapped * 1e3, r[1]);
+    printf("save %.1f ms\n", saved * 1e3);
+
+    radix_trie_unmap(img);
+    radix_trie_delete_all(t);
+    unlink(IMAGE);
+    free(keys);
+    return 0;
+}
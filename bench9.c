@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <malloc.h>
+#include "radix-trie.h"
+
+/*
+ * frozen tries: bytes a key and lookups per second of the trie and of
+ * its frozen copy, for sequential keys (as test1) and random keys (as
+ * test2), with values the index of each key. The bytes of the trie
+ * are those malloc gave out while it was built.
+ *
+ *   bench9 [number of keys]
+ */
+
+#define LOOKUPS 2000000
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+static size_t
+heap(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    return mallinfo2().uordblks;
+#else
+    return (size_t)mallinfo().uordblks;
+#endif
+}
+
+int
+main(int argc, char **argv)
+{
+    int size = argc > 1 ? atoi(argv[1]) : 1 << 20;
+    uint32_t *keys = (uint32_t*)malloc(size * sizeof(uint32_t));
+    int kind, i;
+
+    printf("%d keys\n", size);
+    printf("%-8s %14s %14s %14s %14s\n", "keys", "trie B/key", "frozen B/key", "trie Mfind/s", "frozen Mfind/s");
+
+    for (kind = 0; kind < 2; kind++)
+    {
+        unsigned seed = 1;
+        radix_trie_frozen *f;
+        size_t h;
+        double t0, t1, t2;
+        long sum = 0;
+        void *v;
+        nod *t;
+
+        for (i = 0; i < size; i++)
+            keys[i] = kind ? rnd(&seed) : (uint32_t)i;
+
+        h = heap();
+        t = radix_trie_create(RADIX_TRIE_AUTO);
+        for (i = 0; i < size; i++)
+            radix_trie_insert(t, keys[i], 32, (void*)(long)i);
+        h = heap() - h;
+
+        f = radix_trie_freeze(t);
+
+        seed = 5;
+        t0 = now();
+        for (i = 0; i < LOOKUPS; i++)
+            if (radix_trie_find(t, keys[rnd(&seed) % size], 32, &v))
+                sum += (long)v;
+        seed = 5;
+        t1 = now();
+        for (i = 0; i < LOOKUPS; i++)
+            if (radix_trie_frozen_find(f, keys[rnd(&seed) % size], 32, &v))
+                sum -= (long)v;
+        t2 = now();
+        if (sum != 0)
+            printf("lookups differ\n");
+
+        printf("%-8s %14.1f %14.1f %14.2f %14.2f\n", kind ? "random" : "seq",
+               (double)h / size, (double)radix_trie_frozen_size(f) / size,
+               LOOKUPS / (t1 - t0) * 1e-6, LOOKUPS / (t2 - t1) * 1e-6);
+
+        radix_trie_frozen_free(f);
+        radix_trie_delete_all(t);
+    }
+
+    free(keys);
+    return 0;
+}
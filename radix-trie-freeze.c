@@ -0,0 +1,329 @@
+/*
+Copyright (c) 2014 Dakai Liu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "radix-trie-int.h"
+
+
+/*
+  Frozen tries.
+
+  The nodes of the trie, in level order, each with its slot bitmaps and
+  no slots: tag tells the slots holding a value (external or composite
+  ones), tag1 those with a node below. The nodes below a node come one
+  after the other, so the node of slot i is the first of them plus the
+  number of tag1 bits before i, and likewise for the values, kept in
+  one array. Each node keeps where its children and its values start.
+
+  Values are packed to the width the largest of them needs, 1, 2, 4 or
+  8 bytes. crit_bit and order are kept in the high bits of the child
+  and value indexes, so a node takes 24 bytes with the default order.
+ */
+
+#define RT_FCHILD_BITS  26
+#define RT_FVALUE_BITS  29
+
+struct radix_trie_fnode
+{
+    uint64_t key;           /* the bits before crit_bit, the rest 0 */
+    tag_t tag;              /* slots with a value */
+    tag_t tag1;             /* slots with a node below */
+    uint32_t child;         /* the node of the first tag1 slot, and crit_bit */
+    uint32_t value;         /* the value of the first tag slot, and order */
+};
+
+#define RT_FCHILD(n)    ((n)->child & ((1u << RT_FCHILD_BITS) - 1))
+#define RT_FVALUE(n)    ((n)->value & ((1u << RT_FVALUE_BITS) - 1))
+#define RT_FCRIT(n)     ((int)((n)->child >> RT_FCHILD_BITS))
+#define RT_FORDER(n)    ((int)((n)->value >> RT_FVALUE_BITS))
+
+struct radix_trie_frozen
+{
+    size_t count;           /* nodes */
+    size_t values;
+    int    width;           /* bytes of a value */
+    struct radix_trie_fnode *node;
+    unsigned char *value;
+};
+
+
+/* the value of slot i of n, RT_VALUE for a composite one */
+static INLINE
+void*
+radix_trie_freeze_value(nod *n, int i)
+{
+    if (radix_trie_get_nodetype(n, i) == n_external)
+        return RT_SLOT(n, i);
+    return RT_VALUE(n, i);
+}
+
+static INLINE
+void*
+radix_trie_fvalue(const struct radix_trie_frozen *f, size_t i)
+{
+    switch (f->width)
+    {
+        case 1:
+            return (void*)(uintptr_t)f->value[i];
+        case 2:
+            return (void*)(uintptr_t)((const uint16_t*)f->value)[i];
+        case 4:
+            return (void*)(uintptr_t)((const uint32_t*)f->value)[i];
+        default:
+            return (void*)(uintptr_t)((const uint64_t*)f->value)[i];
+    }
+}
+
+/*
+ * radix_trie_freeze:
+ *  a frozen copy of a trie of integer keys, the trie itself stays as
+ *  it is.
+ * return:
+ *  NULL for a string trie, a set, one with ranges, one too large, or
+ *  out of memory
+ */
+radix_trie_frozen*
+radix_trie_freeze(nod *root)
+{
+    struct radix_trie_frozen *f;
+    nod **q, *n;
+    size_t size = 64, count = 1, values = 0, j;
+    uintptr_t most = 0;
+    int  i, k;
+
+    if (radix_trie_ctx(root)->flags & RADIX_TRIE_SET)
+    {
+        WARNING("%s\n", "sets are not frozen");
+        return 0;
+    }
+    if (radix_trie_ctx(root)->ranges)
+    {
+        WARNING("%s\n", "the ranges of a trie are not frozen");
+        return 0;
+    }
+    root = radix_trie_top(root);
+    if (root && (root->flags & RT_SKEY))
+    {
+        WARNING("%s\n", "string tries are not frozen");
+        return 0;
+    }
+
+    // the nodes in level order, and the largest value
+    q = (nod**)malloc(size * sizeof(nod*));
+    if (!q)
+        return 0;
+    q[0] = root;
+    for (j = 0; j < count && root; j++)
+    {
+        n = q[j];
+        for (i = 0; i < (1 << n->order); i++)
+        {
+            if (radix_trie_get_tag(n, i))
+            {
+                uintptr_t v = (uintptr_t)radix_trie_freeze_value(n, i);
+
+                most |= v;
+                values++;
+            }
+            if (radix_trie_get_tag1(n, i))
+            {
+                if (count == size)
+                {
+                    nod **x = (nod**)realloc(q, 2 * size * sizeof(nod*));
+
+                    if (!x)
+                    {
+                        free(q);
+                        return 0;
+                    }
+                    q = x;
+                    size *= 2;
+                }
+                q[count++] = RT_CHILD(n, i);
+            }
+        }
+    }
+    if (!root)
+        count = 0;
+
+    if (count >= (size_t)1 << RT_FCHILD_BITS || values >= (size_t)1 << RT_FVALUE_BITS)
+    {
+        WARNING("%s\n", "too large to freeze");
+        free(q);
+        return 0;
+    }
+
+    for (k = 1; k < 8 && most >> (8 * k); k *= 2)
+        ;
+
+    f = (struct radix_trie_frozen*)malloc(sizeof(*f) + count * sizeof(struct radix_trie_fnode) + values * k);
+    if (!f)
+    {
+        free(q);
+        return 0;
+    }
+    f->count = count;
+    f->values = values;
+    f->width = k;
+    f->node = (struct radix_trie_fnode*)(f + 1);
+    f->value = (unsigned char*)(f->node + count);
+
+    // the children of node j follow those of the nodes before it
+    size = 1;
+    values = 0;
+    for (j = 0; j < count; j++)
+    {
+        struct radix_trie_fnode *x = &f->node[j];
+
+        n = q[j];
+        x->key = n->key & radix_trie_prefix_mask(n->crit_bit);
+        x->tag = n->tag;
+        x->tag1 = n->tag1;
+        x->child = (uint32_t)size | (uint32_t)n->crit_bit << RT_FCHILD_BITS;
+        x->value = (uint32_t)values | (uint32_t)n->order << RT_FVALUE_BITS;
+
+        size += radix_trie_popcount(n->tag1);
+        for (i = 0; i < (1 << n->order); i++)
+        {
+            uintptr_t v;
+
+            if (!radix_trie_get_tag(n, i))
+                continue;
+
+            v = (uintptr_t)radix_trie_freeze_value(n, i);
+            switch (k)
+            {
+                case 1:
+                    f->value[values] = (unsigned char)v;
+                    break;
+                case 2:
+                    ((uint16_t*)f->value)[values] = (uint16_t)v;
+                    break;
+                case 4:
+                    ((uint32_t*)f->value)[values] = (uint32_t)v;
+                    break;
+                default:
+                    ((uint64_t*)f->value)[values] = (uint64_t)v;
+                    break;
+            }
+            values++;
+        }
+    }
+
+    free(q);
+    return f;
+}
+
+void
+radix_trie_frozen_free(radix_trie_frozen *f)
+{
+    free(f);
+}
+
+/* bytes taken by f */
+size_t
+radix_trie_frozen_size(const radix_trie_frozen *f)
+{
+    return sizeof(*f) + f->count * sizeof(struct radix_trie_fnode) + f->values * f->width;
+}
+
+
+static INLINE
+int
+radix_trie_frozen_find_k(const radix_trie_frozen *f, uint64_t k, int len, void **val)
+{
+    const struct radix_trie_fnode *n = f->node;
+
+    if (!f->count)
+        return 0;
+
+    for (;;)
+    {
+        int crit_bit = RT_FCRIT(n), order = RT_FORDER(n);
+        int end = crit_bit + order;
+        tag_t bit;
+
+        if (len < end)
+            return 0;
+
+        bit = (tag_t)1 << radix_trie_find_slot(k, order, crit_bit);
+        if (len == end)
+        {
+            /* slots only index the key, the skipped bits are checked here */
+            if (((k & radix_trie_prefix_mask(crit_bit)) ^ n->key) || !(n->tag & bit))
+                return 0;
+
+            *val = radix_trie_fvalue(f, RT_FVALUE(n) + radix_trie_popcount(n->tag & (bit - 1)));
+            return 1;
+        }
+
+        if (!(n->tag1 & bit))
+            return 0;
+        n = f->node + RT_FCHILD(n) + radix_trie_popcount(n->tag1 & (bit - 1));
+    }
+}
+
+int
+radix_trie_frozen_find(const radix_trie_frozen *f, uint32_t key, int len, void **val)
+{
+    if (len <= 0 || len > 32)
+        return 0;
+
+    return radix_trie_frozen_find_k(f, radix_trie_key(key, len), len, val);
+}
+
+int
+radix_trie_frozen_find64(const radix_trie_frozen *f, uint64_t key, int len, void **val)
+{
+    if (len <= 0 || len > KEYSIZE_MAX)
+        return 0;
+
+    return radix_trie_frozen_find_k(f, radix_trie_key(key, len), len, val);
+}
+
+
+static
+void
+radix_trie_frozen_walk_r(const radix_trie_frozen *f, const struct radix_trie_fnode *n,
+                         void (*fn)(uint64_t key, int bit, void *v))
+{
+    int end = RT_FCRIT(n) + RT_FORDER(n);
+    uint32_t c = RT_FCHILD(n), v = RT_FVALUE(n);
+    int i;
+
+    for (i = 0; i < (1 << RT_FORDER(n)); i++)
+    {
+        tag_t bit = (tag_t)1 << i;
+
+        if (n->tag & bit)
+            fn(n->key + ((uint64_t)i << (KEYSIZE_MAX - end)), end, radix_trie_fvalue(f, v++));
+        if (n->tag1 & bit)
+            radix_trie_frozen_walk_r(f, f->node + c++, fn);
+    }
+}
+
+/* radix_trie_walk64 of the trie frozen */
+void
+radix_trie_frozen_walk64(const radix_trie_frozen *f, void (*fn)(uint64_t key, int bit, void *v))
+{
+    if (f->count)
+        radix_trie_frozen_walk_r(f, f->node, fn);
+}
@@ -0,0 +1,292 @@
+/*
+Copyright (c) 2014 Dakai Liu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "radix-trie-int.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+/*
+  Trie images.
+
+  An image is a file of nodes as they are in memory, in the RT_COMPACT
+  layout, flagged RT_IMAGE. A slot of a child node holds the offset
+  of the child from the node holding it instead of its address, so the
+  file is read where it is mapped, and by any number of processes at
+  once. The other slots and the node values hold the values as they
+  were saved, their bits and nothing they point to.
+
+  Children are written before their node, the root last, followed by
+  the trailer below. The lookups, walks and cursors of radix-trie.c go
+  down an image as they go down a trie, see RT_CHILD.
+ */
+
+#define RT_IMAGE_MAGIC "rtimage"
+
+struct radix_trie_image
+{
+    char     magic[8];
+    uint32_t endian;    /* 0x01020304 as written */
+    uint16_t order;     /* RADIX_ORDER_MAX, the width of the bitmaps */
+    uint16_t node;      /* sizeof(nod) */
+    uint64_t size;      /* of the file */
+    uint64_t root;      /* offset of the root */
+};
+
+
+/* write n and the nodes below it from offset *at on, returns the offset of n */
+static
+long
+radix_trie_save_r(FILE *f, nod *n, long *at)
+{
+    union
+    {
+        nod  n;
+        char b[NODE_SIZE(MAP_SIZE)];
+    } x;
+    long sub[MAP_SIZE];
+    long me;
+    int  i, k = 0;
+
+    for (i = 0; i < (1 << n->order); i++)
+    {
+        if (radix_trie_get_tag1(n, i))
+        {
+            sub[i] = radix_trie_save_r(f, RT_CHILD(n, i), at);
+            if (sub[i] < 0)
+                return -1;
+        }
+    }
+
+    memset(&x, 0, sizeof(x));
+    x.n.key = n->key;
+    x.n.tag = n->tag;
+    x.n.tag1 = n->tag1;
+    x.n.crit_bit = n->crit_bit;
+    x.n.order = n->order;
+    x.n.kind = RT_COMPACT;
+    x.n.flags = RT_IMAGE;
+    x.n.value = n->value;
+
+    me = *at;
+    for (i = 0; i < (1 << n->order); i++)
+    {
+        if (radix_trie_get_tag1(n, i))
+            x.n.fan[k++] = (nod*)(intptr_t)(sub[i] - me);
+        else if (radix_trie_get_tag(n, i))
+            x.n.fan[k++] = *radix_trie_slot(n, i);
+    }
+    x.n.cap = k;
+
+    if (fwrite(&x, NODE_SIZE(k), 1, f) != 1)
+        return -1;
+    *at += NODE_SIZE(k);
+    return me;
+}
+
+/*
+ * radix_trie_save:
+ *  write the trie to an image at path, through a file next to it
+ *  that takes its place once whole.
+ * return:
+ *  0 for saved
+ *  -1 for an error, errno tells which
+ */
+int
+radix_trie_save(nod *root, const char *path)
+{
+    struct radix_trie_image t;
+    char *tmp;
+    FILE *f;
+    long at = 0, r;
+
+    if (radix_trie_ctx(root)->flags & RADIX_TRIE_SET)
+    {
+        WARNING("%s\n", "the leaves of a set are not saved");
+        return -1;
+    }
+    if (radix_trie_ctx(root)->ranges)
+    {
+        WARNING("%s\n", "the ranges of a trie are not saved");
+        return -1;
+    }
+    root = radix_trie_top(root);
+    if (!root || (root->flags & RT_SKEY))
+    {
+        WARNING("%s\n", "images are of integer keys");
+        return -1;
+    }
+
+    tmp = (char*)malloc(strlen(path) + 5);
+    sprintf(tmp, "%s.tmp", path);
+    f = fopen(tmp, "wb");
+    if (!f)
+    {
+        free(tmp);
+        return -1;
+    }
+
+    r = radix_trie_save_r(f, root, &at);
+
+    memset(&t, 0, sizeof(t));
+    memcpy(t.magic, RT_IMAGE_MAGIC, sizeof(t.magic));
+    t.endian = 0x01020304;
+    t.order = RADIX_ORDER_MAX;
+    t.node = sizeof(nod);
+    t.size = at + sizeof(t);
+    t.root = r;
+
+    if (r < 0 || fwrite(&t, sizeof(t), 1, f) != 1)
+        r = -1;
+    if (fclose(f) != 0)
+        r = -1;
+    if (r >= 0)
+        r = rename(tmp, path);
+    if (r < 0)
+        unlink(tmp);
+    free(tmp);
+    return r < 0 ? -1 : 0;
+}
+
+
+/*
+ * every node of the image at base, "size" bytes of nodes, must be one
+ * radix_trie_save writes: in the file, of an order and bits the build
+ * can look up, and each child a node before it, as children come
+ * first, that starts past the bits of its parent. The root, which ends
+ * the nodes, must be one of them.
+ */
+#define RT_WORD(o) ((o) / sizeof(void*))
+
+static
+int
+radix_trie_image_check(const char *base, size_t size, size_t root)
+{
+    unsigned char *start = (unsigned char*)calloc(RT_WORD(size) / 8 + 1, 1);   /* a bit per node start */
+    size_t at = 0;
+    int  ok = start != 0;
+
+    while (ok && at < size)
+    {
+        nod *n = (nod*)(base + at);
+        int  i, k = 0, end;
+
+        if (size - at < sizeof(nod))
+        {
+            ok = 0;
+            break;
+        }
+        end = n->crit_bit + n->order;
+        if (n->flags != RT_IMAGE || n->kind != RT_COMPACT ||
+            n->order < 1 || n->order > RADIX_ORDER_MAX || end > KEYSIZE_MAX ||
+            (n->order < RADIX_ORDER_MAX && (n->tag | n->tag1) >> (1 << n->order)) ||
+            n->cap != radix_trie_popcount(n->tag | n->tag1) || size - at < NODE_SIZE(n->cap))
+        {
+            ok = 0;
+            break;
+        }
+
+        for (i = 0; i < (1 << n->order) && ok; i++)
+        {
+            if (radix_trie_get_tag1(n, i))
+            {
+                intptr_t c = (intptr_t)n->fan[k];
+                size_t o = at + c;
+
+                ok = c < 0 && (size_t)-c <= at && c % (intptr_t)sizeof(void*) == 0 &&
+                     (start[RT_WORD(o) / 8] & 1 << RT_WORD(o) % 8) && ((nod*)(base + o))->crit_bit >= end;
+            }
+            if (radix_trie_get_tag(n, i) || radix_trie_get_tag1(n, i))
+                k++;
+        }
+
+        start[RT_WORD(at) / 8] |= 1 << RT_WORD(at) % 8;
+        at += NODE_SIZE(n->cap);
+    }
+    ok = ok && at == size && (start[RT_WORD(root) / 8] & 1 << RT_WORD(root) % 8);
+    free(start);
+    return ok;
+}
+
+/*
+ * radix_trie_map:
+ *  map the image at path read only, the root returned is that of the
+ *  trie saved, for lookups, walks and cursors, until radix_trie_unmap.
+ *  Each node is checked once, in one pass over the file.
+ * return:
+ *  NULL for an error or a file that is not an image of this build
+ */
+nod*
+radix_trie_map(const char *path)
+{
+    struct radix_trie_image *t;
+    struct stat st;
+    char *base;
+    nod  *root;
+    int   fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)(sizeof(*t) + sizeof(nod)) || st.st_size % sizeof(void*))
+    {
+        close(fd);
+        return 0;
+    }
+
+    base = (char*)mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return 0;
+
+    /* the root ends where the trailer starts */
+    t = (struct radix_trie_image*)(base + st.st_size - sizeof(*t));
+    root = (nod*)(base + t->root);
+    if (memcmp(t->magic, RT_IMAGE_MAGIC, sizeof(t->magic)) != 0 || t->endian != 0x01020304 ||
+        t->order != RADIX_ORDER_MAX || t->node != sizeof(nod) || t->size != (uint64_t)st.st_size ||
+        t->root > t->size - sizeof(*t) - sizeof(nod) || t->root % sizeof(void*) ||
+        (char*)root + NODE_SIZE(root->cap) != (char*)t ||
+        !radix_trie_image_check(base, st.st_size - sizeof(*t), t->root))
+    {
+        WARNING("%s is not an image\n", path);
+        munmap(base, st.st_size);
+        return 0;
+    }
+
+    return root;
+}
+
+void
+radix_trie_unmap(nod *root)
+{
+    struct radix_trie_image *t;
+
+    if (!root || !(root->flags & RT_IMAGE))
+        return;
+
+    t = (struct radix_trie_image*)((char*)root + NODE_SIZE(root->cap));
+    munmap((char*)t + sizeof(*t) - t->size, t->size);
+}
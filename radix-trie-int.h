@@ -0,0 +1,548 @@
+/*
+Copyright (c) 2014 Dakai Liu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*
+ * radix-trie-int.h:
+ *  node layout and slot helpers, shared by the modules of the library,
+ *  not to be included by users of radix-trie.h.
+ */
+
+#ifndef RADIX_TRIE_INT_H
+#define RADIX_TRIE_INT_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "radix-trie.h"
+
+#define KEYSIZE_MAX 64
+#ifndef RADIX_ORDER
+#define RADIX_ORDER 4
+#endif
+
+/*
+ * the largest order a trie can be created with, RADIX_TRIE_ORDER(), it
+ * sets the width of the slot bitmaps. RADIX_ORDER is the order tries
+ * get by default.
+ */
+#ifndef RADIX_ORDER_MAX
+#if RADIX_ORDER > 5
+#define RADIX_ORDER_MAX 6
+#else
+#define RADIX_ORDER_MAX 5
+#endif
+#endif
+#define MAP_SIZE (1<<RADIX_ORDER_MAX)
+
+/* the tag bit of a slot, and its tag1 bit shifted by one */
+typedef enum
+{
+    n_empty = 0,
+    n_external = 1,
+    n_internal = 2,
+    n_composite = 3
+} nodetype;
+
+#if RADIX_ORDER_MAX > 6
+#error Maximum fan factor is 64
+#endif
+#if RADIX_ORDER > RADIX_ORDER_MAX || RADIX_ORDER < 1
+#error RADIX_ORDER is 1 to RADIX_ORDER_MAX
+#endif
+
+/* slot bitmaps, one bit per slot */
+#if RADIX_ORDER_MAX > 5
+typedef uint64_t tag_t;
+#else
+typedef uint32_t tag_t;
+#endif
+
+
+#ifdef DEBUG
+#define WARNING(...) fprintf(stderr, __VA_ARGS__)
+#else
+#define WARNING(...)
+#endif
+
+
+
+/* tag and tag1 bit */
+/*
+  tag      tag1
+   0        0      empty
+   1        0      external
+   0        1      internal
+   1        1      internal + external
+ */
+
+
+/* node kind, how fan[] is laid out */
+#define RT_FULL      0   /* fan[i] is slot i, 1 << order entries */
+#define RT_COMPACT   1   /* fan[] holds occupied slots only, cap entries */
+#define RT_INDEXED   2   /* cap entries in fan[], followed by a byte index of slots */
+
+/*
+ * node classes used by RADIX_TRIE_AUTO, by the number of slots they
+ * hold, any class not smaller than the 1 << order slots of the trie
+ * is a full node. Classes from RT_INDEXED_MIN on use a byte index
+ * instead of the popcount, so adding a slot does not move the others.
+ */
+#define RT_CLASSES     4
+#ifndef RT_INDEXED_MIN
+#define RT_INDEXED_MIN 48
+#endif
+
+/* node flags */
+#define RT_HEAD      1   /* root made by radix_trie_create(), preceded by its ctx */
+#define RT_SKEY      2   /* node of a byte string trie, key holds its path segment */
+#define RT_SCRATCH   4   /* full node on the path of radix_trie_build_sorted() */
+#define RT_IMAGE     8   /* node of a mapped image, its slots hold offsets, see radix-trie-image.c */
+
+/*
+ * node lock words, of RADIX_TRIE_CONCURRENT writers: 30 bits of version
+ * over the two below. A version comes back after 2^30 changes of one
+ * node, a writer would have to stall that long between reading it and
+ * locking the node to be fooled.
+ */
+typedef uint32_t word_t;
+
+#define RT_LOCKED        1
+#define RT_OBSOLETE      2   /* retired, locked for good */
+#define RT_VERSION_STEP  4
+
+
+/* node are internal ONLY */
+struct node
+{
+    uint64_t key;
+    tag_t tag; /* bitfield, 0 for internal node, 1 for external data */
+    tag_t tag1; /* bitfield, 0 is undefined, 1 for internal + external(value) */
+    unsigned short crit_bit;
+    unsigned char order;    /* Normally the order of the trie, less for the root when 64 % order != 0, and for a node cut in two */
+    unsigned char kind;     /* RT_FULL, RT_COMPACT or RT_INDEXED */
+    unsigned char cap;      /* number of entries in fan[] */
+    unsigned char flags;
+    unsigned short share;   /* the snapshots sharing it, see radix_trie_unshare */
+    word_t word;            /* lock word of a RADIX_TRIE_CONCURRENT writer, see radix_trie_lock */
+    void *value;
+    struct node *fan[];
+};
+
+#define NODE_SIZE(n) (sizeof(nod) + (n) * sizeof(nod*))
+
+/* the slot index of an RT_INDEXED node, position in fan[] of each slot */
+#define RT_INDEX(n) ((unsigned char*)((n)->fan + (n)->cap))
+
+/* the path segment of a byte string trie node, see radix-trie-str.c */
+#define RT_SEG(n) ((unsigned char*)(uintptr_t)(n)->key)
+
+/* bytes of the segment of bits [skip, crit_bit) */
+#define RT_SEG_SIZE(skip, crit_bit) ((size_t)(((crit_bit) + 7) >> 3) - ((skip) >> 3))
+
+
+/* a node about to be visited */
+#if defined(__GNUC__)
+#define RT_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define RT_PREFETCH(p) ((void)(p))
+#endif
+
+/*
+ * a pointer published to, and read by, readers of a shared trie, what
+ * was written before the store is seen after the load
+ */
+#if defined(__GNUC__)
+#define RT_LOAD(p)      __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define RT_STORE(p, v)  __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define RT_FENCE()      __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define RT_CAS(p, o, v) __atomic_compare_exchange_n(p, o, v, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#define RT_THREAD       __thread
+#else
+#define RT_LOAD(p)      (*(p))
+#define RT_STORE(p, v)  (*(p) = (v))
+#define RT_FENCE()      ((void)0)
+#define RT_CAS(p, o, v) (*(p) = (v), 1)
+#define RT_THREAD
+#endif
+
+/*
+ * operation counters, built in with -DRADIX_TRIE_COUNTERS: kept in the
+ * ctx of a trie, see struct radix_trie_counters, and added to with
+ * relaxed atomics, no thread waits on another for them. Without it
+ * they are not there, and RT_COUNT is nothing.
+ */
+#ifdef RADIX_TRIE_COUNTERS
+#if defined(__GNUC__)
+#define RT_COUNT(ctx, c, n) __atomic_fetch_add(&(ctx)->counters.c, (n), __ATOMIC_RELAXED)
+#else
+#define RT_COUNT(ctx, c, n) ((ctx)->counters.c += (n))
+#endif
+#else
+#define RT_COUNT(ctx, c, n) ((void)(ctx), (void)(n))
+#endif
+
+/*
+ * USDT probes, for bpftrace and SystemTap, where <sys/sdt.h> is there,
+ * unless built with -DRADIX_TRIE_NO_PROBES. A probe is a nop until a
+ * tracer attaches to it.
+ */
+#if !defined(RADIX_TRIE_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define RT_PROBES 1
+#endif
+#endif
+
+#ifdef RT_PROBES
+#define RT_PROBE3(name, a, b, c)    DTRACE_PROBE3(radix_trie, name, a, b, c)
+#define RT_PROBE4(name, a, b, c, d) DTRACE_PROBE4(radix_trie, name, a, b, c, d)
+#else
+#define RT_PROBE3(name, a, b, c)    ((void)0)
+#define RT_PROBE4(name, a, b, c, d) ((void)0)
+#endif
+
+
+/*
+ * per trie settings, they sit right in front of the root node returned
+ * by radix_trie_create(), tries grown from a NULL root use the defaults.
+ */
+struct radix_trie_ctx
+{
+    int flags;
+    int order;                        /* of the nodes, RADIX_TRIE_ORDER() */
+    struct radix_trie_arena *arena;   /* RADIX_TRIE_ARENA, NULL otherwise */
+    struct radix_trie_build *build;   /* radix_trie_build_sorted() at work */
+    struct radix_trie_shared *shared; /* RADIX_TRIE_SHARED, NULL otherwise */
+    nod *top;                         /* RADIX_TRIE_SHARED, the root readers start from */
+    word_t word;                      /* RADIX_TRIE_CONCURRENT lock word of top */
+    int snapshots;                    /* radix_trie_snapshot() taken and not freed */
+    struct radix_trie_ctx *origin;    /* of a snapshot, the trie it was taken of */
+    uint64_t compact;                 /* radix_trie_compact() goes on from this key */
+    uint64_t *set_short;              /* RADIX_TRIE_SET, keys of upto RT_SET_BITS bits */
+    nod **ranges;                     /* radix_trie_insert_range(), a trie of blocks per key length */
+#ifdef RADIX_TRIE_COUNTERS
+    struct radix_trie_counters counters;
+#endif
+};
+
+/*
+ * a bulk load, see radix_trie_build_sorted(). Its nodes are made as
+ * full RT_SCRATCH nodes, but for those starting after "bound", made in
+ * the layout of the trie being built.
+ */
+struct radix_trie_build
+{
+    struct radix_trie_ctx *ctx;   /* of the trie being built */
+    int bound;
+    nod *spare;                   /* scratch nodes to reuse */
+};
+
+/*
+ * RADIX_TRIE_SET: the last RT_SET_BITS bits of a key are a bit of a
+ * leaf bitmap, the value of the key of the bits before them, see
+ * radix-trie-set.c. Keys of upto RT_SET_BITS bits have the bits of
+ * set_short, a key of len bits from bit (1 << len) - 2 on.
+ */
+#define RT_SET_BITS   8
+#define RT_SET_WORDS  ((1 << RT_SET_BITS) / 64)
+#define RT_SET_LEAF   (RT_SET_WORDS * sizeof(uint64_t))
+#define RT_SET_SHORT  (2 * RT_SET_LEAF)
+
+#define CTX_SIZE ((sizeof(struct radix_trie_ctx) + sizeof(void*) - 1) / sizeof(void*) * sizeof(void*))
+
+extern struct radix_trie_ctx radix_trie_default_ctx;
+
+
+static INLINE
+struct radix_trie_ctx*
+radix_trie_ctx(nod *r)
+{
+    if (r && (r->flags & RT_HEAD))
+        return (struct radix_trie_ctx*)((char*)r - CTX_SIZE);
+    return &radix_trie_default_ctx;
+}
+
+/*
+ * a shared trie can't change the root made by radix_trie_create() in
+ * place, its copies are kept in ctx->top, which lookups start from
+ */
+static INLINE
+nod*
+radix_trie_top(nod *r)
+{
+    if (r && (r->flags & RT_HEAD) && radix_trie_ctx(r)->shared)
+        return RT_LOAD(&radix_trie_ctx(r)->top);
+    return r;
+}
+
+/* snapshots and mapped images are not changed */
+static INLINE
+int
+radix_trie_readonly(nod *r)
+{
+    return r && ((r->flags & RT_IMAGE) || radix_trie_ctx(r)->origin);
+}
+
+
+/*
+ * key: are 64 bit integer
+ * crit_bit: the last bit of common prefix
+ * order: the exponent over 2 on span
+ */
+static INLINE
+int
+radix_trie_find_slot(uint64_t key, int order, int crit_bit)
+{
+    int n_crit_bit = crit_bit + order;
+
+    uint64_t msk = ~(uint64_t)0 >> (KEYSIZE_MAX - order);
+
+    return (int)((key >> (KEYSIZE_MAX - n_crit_bit)) & msk);
+}
+
+
+/*
+ * the bit where the node holding a branch at bit "prefix" starts,
+ * nodes are aligned on the order of the trie from the end of the key,
+ * of "length" bits, so the first node may be shorter. The result may
+ * be negative.
+ */
+static INLINE
+int
+radix_trie_align(int prefix, int length, int order)
+{
+    int crit_bit = length - prefix;
+
+    crit_bit = (crit_bit + order - 1) / order * order;
+
+    return length - crit_bit;
+}
+
+
+/* the leading "bits" bits of a key */
+static INLINE
+uint64_t
+radix_trie_prefix_mask(int bits)
+{
+    if (bits <= 0)
+        return 0;
+    if (bits >= KEYSIZE_MAX)
+        return ~(uint64_t)0;
+    return ~(uint64_t)0 << (KEYSIZE_MAX - bits);
+}
+
+/* a key of "len" bits, aligned on the most significant bit */
+static INLINE
+uint64_t
+radix_trie_key(uint64_t key, int len)
+{
+    if (len < KEYSIZE_MAX)
+        return key << (KEYSIZE_MAX - len);
+    return key;
+}
+
+
+static INLINE
+int
+radix_trie_popcount(uint64_t x)
+{
+#if defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+
+
+static INLINE
+void
+radix_trie_set_tag(nod *node, int offset)
+{
+
+    node->tag |= ((tag_t)1<<offset);
+
+}
+
+static INLINE
+int
+radix_trie_get_tag(nod *n, int offset)
+{
+    return (n->tag & ((tag_t)1<<offset)) != 0;
+}
+
+
+static INLINE
+void
+radix_trie_clear_tag(nod *node, int offset)
+{
+
+    node->tag &= (~((tag_t)1<<offset));
+
+}
+
+static INLINE
+void
+radix_trie_clear_tag1(nod *node, int offset)
+{
+
+    node->tag1 &= (~((tag_t)1<<offset));
+
+}
+
+static INLINE
+void
+radix_trie_set_tag1(nod *node, int offset)
+{
+
+    node->tag1 |= ((tag_t)1<<offset);
+
+}
+
+static INLINE
+int
+radix_trie_get_tag1(nod *n, int offset)
+{
+    return (n->tag1 & ((tag_t)1<<offset)) != 0;
+}
+
+static INLINE
+nodetype
+radix_trie_get_nodetype(nod *n, int offset)
+{
+    /* tag is the low bit of the type, tag1 the high one */
+    return (nodetype)(((n->tag >> offset) & 1) | (((n->tag1 >> offset) & 1) << 1));
+}
+
+static INLINE
+void
+radix_trie_set_nodetype(nod *n, nodetype nt, int offset)
+{
+
+    if (!n)
+        return;
+
+    radix_trie_clear_tag(n, offset);
+    radix_trie_clear_tag1(n, offset);
+
+    switch (nt)
+    {
+        case n_internal:
+            radix_trie_set_tag1(n, offset);
+            break;
+
+        case n_external:
+            radix_trie_set_tag(n, offset);
+            break;
+
+        case n_composite:
+            radix_trie_set_tag(n, offset);
+            radix_trie_set_tag1(n, offset);
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/* number of occupied slots */
+static INLINE
+int
+radix_trie_count(nod *n)
+{
+    return radix_trie_popcount(n->tag | n->tag1);
+}
+
+/*
+ * radix_trie_slot:
+ *  address of slot "offset" in fan[], for a compact node it is the
+ *  rank of the slot among the occupied ones.
+ */
+static INLINE
+nod**
+radix_trie_slot(nod *n, int offset)
+{
+    if (n->kind == RT_FULL)
+        return &n->fan[offset];
+
+    if (n->kind == RT_INDEXED)
+        return &n->fan[RT_INDEX(n)[offset]];
+
+    return &n->fan[radix_trie_popcount((n->tag | n->tag1) & (((tag_t)1 << offset) - 1))];
+}
+
+/* what a slot holds, and the value of a composite one, for readers */
+#define RT_SLOT(n, i)   RT_LOAD(radix_trie_slot(n, i))
+#define RT_VALUE(n, i)  RT_LOAD(&RT_CHILD(n, i)->value)
+
+/* the node below slot i, a node of an image keeps it at an offset from itself */
+#define RT_CHILD(n, i)  radix_trie_child(n, RT_SLOT(n, i))
+
+static INLINE
+nod*
+radix_trie_child(nod *n, nod *c)
+{
+    if (n->flags & RT_IMAGE)
+        return (nod*)((char*)n + (intptr_t)c);
+    return c;
+}
+
+
+static INLINE
+int
+radix_trie_is_empty(nod* n)
+{
+    return (n->tag == 0 &&
+            n->tag1 == 0);
+}
+
+
+/* radix-trie.c */
+void* radix_trie_mem_alloc(struct radix_trie_ctx *ctx, size_t size);
+void radix_trie_mem_free(struct radix_trie_ctx *ctx, void *p, size_t size);
+struct radix_trie_arena* radix_trie_arena_new(void);
+void radix_trie_arena_adopt(struct radix_trie_arena *a, struct radix_trie_arena *b);
+nod* radix_trie_alloc(struct radix_trie_ctx *ctx, int kind, int cap);
+void radix_trie_free_node(struct radix_trie_ctx *ctx, nod *n);
+nod* radix_trie_new(struct radix_trie_ctx *ctx, uint64_t key, int crit_bit, int order, int count);
+nod* radix_trie_resize(struct radix_trie_ctx *ctx, nod *n, int kind, int cap);
+void radix_trie_slot_add(struct radix_trie_ctx *ctx, nod **ref, nod *n, int offset, nodetype nt, void *p);
+void radix_trie_slot_set(struct radix_trie_ctx *ctx, nod **ref, nod *n, int offset, nodetype nt, void *p);
+void radix_trie_slot_remove(struct radix_trie_ctx *ctx, nod **ref, nod *n, int offset);
+nod* radix_trie_split_order(struct radix_trie_ctx *ctx, nod **ref, int length);
+void radix_trie_insert_r(struct radix_trie_ctx *ctx, nod **ref, int parent, uint64_t _key, int length, void *value);
+
+/* the slots of a batch of keys in the root, see radix_trie_find_batch */
+typedef void (*radix_trie_slots_fn)(nod *r, const uint64_t *k, int n, int *slot, int *nt);
+
+#define RT_SLOTS_SCALAR 0
+#define RT_SLOTS_SSE2   1
+#define RT_SLOTS_AVX2   2
+
+radix_trie_slots_fn radix_trie_slots_kernel(int which);
+int radix_trie_slots_use(int which);
+
+#endif
@@ -0,0 +1,1138 @@
+/*
+Copyright (c) 2014 Dakai Liu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <pthread.h>
+#include <unistd.h>
+#include "radix-trie-int.h"
+
+
+/*
+  Parallel bulk load.
+
+  The upper levels of the trie are planned from a sorted sample of the
+  keys: a slot of a node of the plan that would hold more than its
+  share of the keys gets a node of its own below it, one level down,
+  the other slots are buckets. The keys are counted into the buckets,
+  and scattered into them, by chunks of the input in threads of their
+  own; keys no longer than the node of the plan they end in are kept
+  apart. The threads then take the buckets, largest first, and insert
+  the keys of each into a subtree of its own, hung below the slot of
+  its bucket, as radix_trie_insert would below that node. The plan is
+  made into nodes last, each node leading to one node only is left
+  out, as radix_trie_insert would skip it, and the keys kept apart are
+  inserted one by one.
+ */
+
+#define RT_SAMPLE       65536
+#define RT_PAR_MIN      4096    /* fewer keys are inserted one by one */
+
+/* a node of the plan */
+struct radix_trie_part
+{
+    uint64_t key;
+    int crit_bit;
+    int order;
+    int child[MAP_SIZE];        /* > 0 a node of the plan below, <= 0 bucket -child */
+};
+
+struct radix_trie_sample
+{
+    uint64_t key;
+    int len;
+};
+
+struct radix_trie_bucket
+{
+    size_t size;
+    int bucket;
+};
+
+struct radix_trie_par
+{
+    struct radix_trie_ctx *ctx;
+    const uint32_t *keys;
+    const uint64_t *keys64;
+    const int *lens;
+    void **values;
+    size_t count;
+    int width;
+
+    struct radix_trie_part *parts;
+    int nparts, parts_size;
+    int *parent;                /* of each bucket, the bit its subtree hangs below */
+    int nbuckets, buckets_size;
+    int nomem;                  /* the plan ran out of memory */
+
+    int threads;
+    int phase;
+    int next;                   /* the next chunk, or bucket, a thread takes */
+    size_t *counts;             /* [chunk][bucket], then where the chunk scatters to */
+    size_t *start;              /* [bucket], where its keys are in idx, then one past the last */
+    size_t *idx;
+    struct radix_trie_bucket *by_size;   /* the buckets, largest first */
+    nod **sub;                  /* the subtree of each bucket */
+    struct radix_trie_ctx *wctx;   /* of each thread, with an arena of its own */
+};
+
+#define RT_PAR_COUNT    0
+#define RT_PAR_SCATTER  1
+#define RT_PAR_BUILD    2
+
+
+/* fn(arg, thread) on nthreads threads, thread 0 the caller's */
+struct radix_trie_worker
+{
+    void (*fn)(void *arg, int thread);
+    void *arg;
+    int thread;
+};
+
+static
+void*
+radix_trie_worker_main(void *p)
+{
+    struct radix_trie_worker *w = (struct radix_trie_worker*)p;
+
+    w->fn(w->arg, w->thread);
+    return 0;
+}
+
+/*
+ * the work is taken by the threads as they go, what a thread that did
+ * not start would have done the others do
+ */
+static
+void
+radix_trie_pool_run(int nthreads, void (*fn)(void *arg, int thread), void *arg)
+{
+    pthread_t *th = (pthread_t*)malloc(nthreads * sizeof(pthread_t));
+    struct radix_trie_worker *w = (struct radix_trie_worker*)malloc(nthreads * sizeof(*w));
+    char *started = (char*)calloc(nthreads, 1);
+    int t;
+
+    for (t = 1; th && w && started && t < nthreads; t++)
+    {
+        w[t].fn = fn;
+        w[t].arg = arg;
+        w[t].thread = t;
+        started[t] = pthread_create(&th[t], 0, radix_trie_worker_main, &w[t]) == 0;
+    }
+    fn(arg, 0);
+    for (t = 1; th && w && started && t < nthreads; t++)
+    {
+        if (started[t])
+            pthread_join(th[t], 0);
+    }
+    free(started);
+    free(w);
+    free(th);
+}
+
+static
+int
+radix_trie_threads(int nthreads)
+{
+    long n;
+
+    if (nthreads > 0)
+        return nthreads;
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+
+static INLINE
+uint64_t
+radix_trie_par_key(const struct radix_trie_par *pb, size_t j, int *len)
+{
+    *len = pb->lens ? pb->lens[j] : pb->width;
+    if (*len <= 0 || *len > pb->width)
+        return 0;
+    return radix_trie_key(pb->keys ? pb->keys[j] : pb->keys64[j], *len);
+}
+
+/* the bucket of a key, 0 for one kept apart */
+static INLINE
+int
+radix_trie_par_route(const struct radix_trie_par *pb, uint64_t k, int len)
+{
+    const struct radix_trie_part *p = pb->parts;
+
+    for (;;)
+    {
+        int c;
+
+        if (len <= p->crit_bit + p->order)
+            return 0;
+        c = p->child[radix_trie_find_slot(k, p->order, p->crit_bit)];
+        if (c <= 0)
+            return -c;
+        p = pb->parts + c;
+    }
+}
+
+static
+int
+radix_trie_sample_cmp(const void *a, const void *b)
+{
+    const struct radix_trie_sample *x = (const struct radix_trie_sample*)a;
+    const struct radix_trie_sample *y = (const struct radix_trie_sample*)b;
+
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    return x->len - y->len;
+}
+
+static
+int
+radix_trie_bucket_cmp(const void *a, const void *b)
+{
+    const struct radix_trie_bucket *x = (const struct radix_trie_bucket*)a;
+    const struct radix_trie_bucket *y = (const struct radix_trie_bucket*)b;
+
+    if (x->size != y->size)
+        return x->size > y->size ? -1 : 1;
+    return x->bucket - y->bucket;
+}
+
+static
+int
+radix_trie_bucket_new(struct radix_trie_par *pb, int parent)
+{
+    if (pb->nbuckets == pb->buckets_size)
+    {
+        int *p = (int*)realloc(pb->parent, 2 * pb->buckets_size * sizeof(int));
+
+        if (!p)
+        {
+            pb->nomem = 1;
+            return 0;
+        }
+        pb->parent = p;
+        pb->buckets_size *= 2;
+    }
+    pb->parent[pb->nbuckets] = parent;
+    return pb->nbuckets++;
+}
+
+/*
+ * radix_trie_plan:
+ *  a node of the plan for the sample keys s[a .. b), which share the
+ *  bits before crit_bit. A slot of more than "most" of them, each
+ *  longer than the node below it would end, gets that node. Nodes end
+ *  where inserts of keys of the full width would end them, see
+ *  radix_trie_align.
+ */
+static
+int
+radix_trie_plan(struct radix_trie_par *pb, uint64_t key, int crit_bit, int order,
+                const struct radix_trie_sample *s, size_t a, size_t b, size_t most)
+{
+    int end = crit_bit + order;
+    int next = radix_trie_align(end, pb->width, pb->ctx->order) + pb->ctx->order - end;
+    int p = pb->nparts;
+    int i;
+
+    if (pb->nparts == pb->parts_size)
+    {
+        struct radix_trie_part *x = (struct radix_trie_part*)realloc(pb->parts, 2 * pb->parts_size * sizeof(*x));
+
+        if (!x)
+        {
+            pb->nomem = 1;
+            return 0;
+        }
+        pb->parts = x;
+        pb->parts_size *= 2;
+    }
+    pb->nparts++;
+    pb->parts[p].key = key;
+    pb->parts[p].crit_bit = crit_bit;
+    pb->parts[p].order = order;
+
+    for (i = 0; i < (1 << order); i++)
+    {
+        size_t from = a, n = 0;
+        int shortest = KEYSIZE_MAX + 1, c;
+
+        /* the keys of a slot follow each other */
+        for (; a < b && radix_trie_find_slot(s[a].key, order, crit_bit) == i; a++)
+        {
+            if (s[a].len <= end)
+                continue;
+            n++;
+            if (s[a].len < shortest)
+                shortest = s[a].len;
+        }
+
+        if (n > most && shortest > end + next)
+            c = radix_trie_plan(pb, key | (uint64_t)i << (KEYSIZE_MAX - end), end, next, s, from, a, most);
+        else
+            c = -radix_trie_bucket_new(pb, end);
+        pb->parts[p].child[i] = c;
+    }
+    return p;
+}
+
+static
+void
+radix_trie_par_work(void *arg, int thread)
+{
+    struct radix_trie_par *pb = (struct radix_trie_par*)arg;
+    int nb = pb->nbuckets;
+    int c;
+
+    while ((c = __atomic_fetch_add(&pb->next, 1, __ATOMIC_RELAXED)) < (pb->phase == RT_PAR_BUILD ? nb : pb->threads))
+    {
+        size_t j, from, to;
+        uint64_t k;
+        int len;
+
+        if (pb->phase == RT_PAR_BUILD)
+        {
+            struct radix_trie_ctx *ctx = pb->wctx ? &pb->wctx[thread] : pb->ctx;
+            int b = pb->by_size[c].bucket;
+
+            /* keys kept apart go in last */
+            if (b == 0)
+                continue;
+            from = pb->start[b - 1];
+            for (j = from; j < pb->start[b]; j++)
+            {
+                size_t x = pb->idx[j];
+
+                k = radix_trie_par_key(pb, x, &len);
+                radix_trie_insert_r(ctx, &pb->sub[b], pb->parent[b], k, len, pb->values[x]);
+            }
+            RT_COUNT(ctx, inserts, pb->start[b] - from);
+            continue;
+        }
+
+        from = pb->count / pb->threads * c;
+        to = c == pb->threads - 1 ? pb->count : from + pb->count / pb->threads;
+        for (j = from; j < to; j++)
+        {
+            size_t *n;
+
+            k = radix_trie_par_key(pb, j, &len);
+            if (len <= 0 || len > pb->width)
+                continue;
+            n = &pb->counts[(size_t)c * nb + radix_trie_par_route(pb, k, len)];
+            if (pb->phase == RT_PAR_COUNT)
+                (*n)++;
+            else
+                pb->idx[(*n)++] = j;
+        }
+    }
+}
+
+/*
+ * radix_trie_par_stitch:
+ *  the nodes of the plan below node p of it, the head of the trie for
+ *  p == 0, NULL when no key went below it.
+ */
+static
+nod*
+radix_trie_par_stitch(struct radix_trie_par *pb, int p, nod *head)
+{
+    nod *below[MAP_SIZE];
+    nod *n = head;
+    int count = 0, last = 0, i;
+
+    for (i = 0; i < (1 << pb->parts[p].order); i++)
+    {
+        int c = pb->parts[p].child[i];
+
+        below[i] = c > 0 ? radix_trie_par_stitch(pb, c, 0) : pb->sub[-c];
+        if (below[i])
+        {
+            count++;
+            last = i;
+        }
+    }
+
+    if (p != 0)
+    {
+        /* the node below skips the bits of this one */
+        if (count <= 1)
+            return count ? below[last] : 0;
+        n = radix_trie_new(pb->ctx, pb->parts[p].key, pb->parts[p].crit_bit, pb->parts[p].order, count);
+    }
+    for (i = 0; i < (1 << pb->parts[p].order); i++)
+    {
+        if (below[i])
+            radix_trie_slot_add(pb->ctx, 0, n, i, n_internal, below[i]);
+    }
+    return n;
+}
+
+/* keys from..to in the order given, or those of idx[from..to) */
+static
+nod*
+radix_trie_par_insert(nod *r, const struct radix_trie_par *pb, const size_t *idx, size_t from, size_t to)
+{
+    size_t j;
+
+    for (j = from; j < to; j++)
+    {
+        size_t x = idx ? idx[j] : j;
+        int len = pb->lens ? pb->lens[x] : pb->width;
+
+        if (pb->keys)
+            r = radix_trie_insert(r, pb->keys[x], len, pb->values[x]);
+        else
+            r = radix_trie_insert64(r, pb->keys64[x], len, pb->values[x]);
+    }
+    return r;
+}
+
+static
+void
+radix_trie_par_free(struct radix_trie_par *pb)
+{
+    free(pb->parts);
+    free(pb->parent);
+    free(pb->counts);
+    free(pb->start);
+    free(pb->idx);
+    free(pb->by_size);
+    free(pb->sub);
+    free(pb->wctx);
+}
+
+static
+nod*
+radix_trie_build_parallel_k(nod *r, const uint32_t *keys, const uint64_t *keys64, const int *lens,
+                            void **values, size_t count, int nthreads, int width)
+{
+    struct radix_trie_ctx *ctx;
+    struct radix_trie_par pb;
+    struct radix_trie_sample *s;
+    size_t ns = 0, j, at;
+    int b, c, t;
+
+    memset(&pb, 0, sizeof(pb));
+    pb.keys = keys;
+    pb.keys64 = keys64;
+    pb.lens = lens;
+    pb.values = values;
+    pb.count = count;
+    pb.width = width;
+
+    if (!r)
+        r = radix_trie_create(RADIX_TRIE_AUTO);
+    ctx = radix_trie_ctx(r);
+    pb.ctx = ctx;
+    pb.threads = nthreads = radix_trie_threads(nthreads);
+
+    /* only an empty trie of its own is built on threads, keys are added to others */
+    if (!(r->flags & RT_HEAD) || !radix_trie_is_empty(r) || radix_trie_readonly(r) ||
+        ctx->shared || ctx->ranges || (ctx->flags & RADIX_TRIE_SET) || count < RT_PAR_MIN)
+        return radix_trie_par_insert(r, &pb, 0, 0, count);
+
+    /* the plan, from a sorted sample, bucket 0 for the keys kept apart */
+    s = (struct radix_trie_sample*)malloc(RT_SAMPLE * sizeof(*s));
+    pb.parts_size = 16;
+    pb.parts = (struct radix_trie_part*)malloc(pb.parts_size * sizeof(struct radix_trie_part));
+    pb.buckets_size = 256;
+    pb.parent = (int*)malloc(pb.buckets_size * sizeof(int));
+    if (!s || !pb.parts || !pb.parent)
+    {
+        free(s);
+        radix_trie_par_free(&pb);
+        return radix_trie_par_insert(r, &pb, 0, 0, count);
+    }
+    for (j = 0; j < RT_SAMPLE && j < count; j++)
+    {
+        size_t x = count <= RT_SAMPLE ? j : (size_t)((double)j * count / RT_SAMPLE);
+        int len;
+
+        s[ns].key = radix_trie_par_key(&pb, x, &len);
+        s[ns].len = len;
+        if (len > 0 && len <= width)
+            ns++;
+    }
+    qsort(s, ns, sizeof(*s), radix_trie_sample_cmp);
+    radix_trie_bucket_new(&pb, 0);
+    radix_trie_plan(&pb, 0, 0, r->order, s, 0, ns, ns / (16 * (size_t)nthreads) + 1);
+    free(s);
+    if (pb.nomem)
+    {
+        radix_trie_par_free(&pb);
+        return radix_trie_par_insert(r, &pb, 0, 0, count);
+    }
+
+    pb.counts = (size_t*)calloc((size_t)nthreads * pb.nbuckets, sizeof(size_t));
+    pb.start = (size_t*)malloc(pb.nbuckets * sizeof(size_t));
+    pb.idx = (size_t*)malloc(count * sizeof(size_t));
+    pb.by_size = (struct radix_trie_bucket*)malloc(pb.nbuckets * sizeof(struct radix_trie_bucket));
+    pb.sub = (nod**)calloc(pb.nbuckets, sizeof(nod*));
+    if (ctx->arena)
+        pb.wctx = (struct radix_trie_ctx*)malloc(nthreads * sizeof(struct radix_trie_ctx));
+    if (!pb.counts || !pb.start || !pb.idx || !pb.by_size || !pb.sub || (ctx->arena && !pb.wctx))
+    {
+        radix_trie_par_free(&pb);
+        return radix_trie_par_insert(r, &pb, 0, 0, count);
+    }
+
+    /* the keys of each chunk in each bucket */
+    pb.phase = RT_PAR_COUNT;
+    radix_trie_pool_run(nthreads, radix_trie_par_work, &pb);
+
+    /* the buckets in turn, the chunks in the order of the keys in each */
+    at = 0;
+    for (b = 0; b < pb.nbuckets; b++)
+    {
+        size_t first = at;
+
+        for (c = 0; c < nthreads; c++)
+        {
+            size_t n = pb.counts[(size_t)c * pb.nbuckets + b];
+
+            pb.counts[(size_t)c * pb.nbuckets + b] = at;
+            at += n;
+        }
+        pb.start[b] = at;
+        pb.by_size[b].size = at - first;
+        pb.by_size[b].bucket = b;
+    }
+
+    pb.phase = RT_PAR_SCATTER;
+    pb.next = 0;
+    radix_trie_pool_run(nthreads, radix_trie_par_work, &pb);
+
+    /* the largest buckets first, so no thread is left with one at the end */
+    qsort(pb.by_size, pb.nbuckets, sizeof(struct radix_trie_bucket), radix_trie_bucket_cmp);
+
+    /* threads take nodes from arenas of their own, which the trie's takes over */
+    for (t = 0; pb.wctx && t < nthreads; t++)
+    {
+        pb.wctx[t] = *ctx;
+        pb.wctx[t].arena = radix_trie_arena_new();
+#ifdef RADIX_TRIE_COUNTERS
+        memset(&pb.wctx[t].counters, 0, sizeof(pb.wctx[t].counters));
+#endif
+    }
+    pb.phase = RT_PAR_BUILD;
+    pb.next = 0;
+    radix_trie_pool_run(nthreads, radix_trie_par_work, &pb);
+    for (t = 0; pb.wctx && t < nthreads; t++)
+    {
+#ifdef RADIX_TRIE_COUNTERS
+        ctx->counters.inserts += pb.wctx[t].counters.inserts;
+        ctx->counters.splits += pb.wctx[t].counters.splits;
+        ctx->counters.composites += pb.wctx[t].counters.composites;
+#endif
+        radix_trie_arena_adopt(ctx->arena, pb.wctx[t].arena);
+    }
+
+    radix_trie_par_stitch(&pb, 0, r);
+    r = radix_trie_par_insert(r, &pb, pb.idx, 0, pb.start[0]);
+
+    radix_trie_par_free(&pb);
+    return r;
+}
+
+/*
+ * radix_trie_build_parallel:
+ *  insert n keys, of length lens[i] (32 for all when lens is NULL), in
+ *  any order, into a trie that is NULL or empty, on nthreads threads
+ *  (as many as there are cpus for 0). Keys for a trie that is not
+ *  empty, or of its own kind, are inserted one by one.
+ */
+nod*
+radix_trie_build_parallel(nod *r, const uint32_t *keys, const int *lens, void **values, size_t n, int nthreads)
+{
+    return radix_trie_build_parallel_k(r, keys, 0, lens, values, n, nthreads, 32);
+}
+
+nod*
+radix_trie_build_parallel64(nod *r, const uint64_t *keys, const int *lens, void **values, size_t n, int nthreads)
+{
+    return radix_trie_build_parallel_k(r, 0, keys, lens, values, n, nthreads, KEYSIZE_MAX);
+}
+
+
+/*
+  Parallel walk and teardown.
+
+  The upper levels of the trie are opened level by level, on the
+  caller's thread, until there are a few subtrees for each thread, which
+  go on a shared stack. Each thread takes a subtree from it and goes
+  down depth first, from a stack of its own. A thread out of work says
+  so, and the next thread to open a node hands it the bottom half of
+  its stack, the subtrees nearest the root, through the shared one.
+  Teardown frees each node once its slots are read.
+
+  An ordered walk keeps the upper levels as a list of subtrees and
+  entries in key order instead, which the threads take in turn. The
+  entries of a subtree are kept until those of all before it went to
+  fn; the thread of the subtree next in turn calls fn directly.
+ */
+
+struct radix_trie_entry
+{
+    uint64_t key;
+    int bit;
+    void *value;
+};
+
+/* of an ordered walk, a subtree or, n NULL, an entry of the upper levels */
+struct radix_trie_job
+{
+    nod *n;
+    struct radix_trie_entry e;
+    struct radix_trie_entry *kept;
+    size_t nkept, kept_size;
+    int direct;                 /* its entries go to fn as they come */
+    int done;
+};
+
+struct radix_trie_stack
+{
+    nod **n;
+    size_t count, size;
+};
+
+struct radix_trie_pwalk
+{
+    void (*fn)(uint32_t key, int bit, void *v, int thread, void *arg);
+    void (*fn64)(uint64_t key, int bit, void *v, int thread, void *arg);
+    void *arg;
+    struct radix_trie_ctx *ctx;
+    nod *head;                  /* of a teardown, freed by radix_trie_delete_all */
+    int teardown;
+    int threads;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct radix_trie_stack pool;
+    int busy;                   /* threads with a stack that is not empty */
+    int hungry;                 /* threads waiting for work */
+
+    struct radix_trie_job *jobs;
+    int njobs;
+    int next;                   /* the next job a thread takes */
+    int emit;                   /* the job whose entries go to fn next */
+};
+
+#define RT_PW_JOBS      16      /* subtrees a thread, of an ordered walk */
+#define RT_PW_POOL      4       /* subtrees a thread, to start with */
+
+static
+int
+radix_trie_push(struct radix_trie_stack *st, nod *n)
+{
+    if (st->count == st->size)
+    {
+        size_t size = st->size ? 2 * st->size : 64;
+        nod **p = (nod**)realloc(st->n, size * sizeof(nod*));
+
+        if (!p)
+            return -1;
+        st->n = p;
+        st->size = size;
+    }
+    st->n[st->count++] = n;
+    return 0;
+}
+
+static
+void
+radix_trie_pw_call(struct radix_trie_pwalk *pw, int thread, uint64_t k, int bit, void *v)
+{
+    if (pw->fn64)
+        pw->fn64(k, bit, v, thread, pw->arg);
+    else
+        pw->fn((uint32_t)(k >> 32), bit, v, thread, pw->arg);
+}
+
+/* the entries a job kept, to fn */
+static
+void
+radix_trie_pw_flush(struct radix_trie_pwalk *pw, int thread, struct radix_trie_job *job)
+{
+    size_t i;
+
+    for (i = 0; i < job->nkept; i++)
+        radix_trie_pw_call(pw, thread, job->kept[i].key, job->kept[i].bit, job->kept[i].value);
+    free(job->kept);
+    job->kept = 0;
+    job->nkept = job->kept_size = 0;
+}
+
+static
+void
+radix_trie_pw_emit(struct radix_trie_pwalk *pw, int thread, struct radix_trie_job *job,
+                   uint64_t k, int bit, void *v)
+{
+    if (!pw->fn && !pw->fn64)
+        return;
+
+    if (job && !job->direct)
+    {
+        int j = (int)(job - pw->jobs);
+
+        /* all before it went to fn, no one else calls it until this job is done */
+        if (__atomic_load_n(&pw->emit, __ATOMIC_ACQUIRE) == j)
+        {
+            radix_trie_pw_flush(pw, thread, job);
+            job->direct = 1;
+        }
+        else
+        {
+            if (job->nkept == job->kept_size)
+            {
+                size_t size = job->kept_size ? 2 * job->kept_size : 64;
+                struct radix_trie_entry *p = (struct radix_trie_entry*)realloc(job->kept, size * sizeof(*p));
+
+                if (!p)
+                {
+                    /* out of memory, wait for its turn */
+                    pthread_mutex_lock(&pw->lock);
+                    while (pw->emit != j)
+                        pthread_cond_wait(&pw->cond, &pw->lock);
+                    pthread_mutex_unlock(&pw->lock);
+                    radix_trie_pw_emit(pw, thread, job, k, bit, v);
+                    return;
+                }
+                job->kept = p;
+                job->kept_size = size;
+            }
+            job->kept[job->nkept].key = k;
+            job->kept[job->nkept].bit = bit;
+            job->kept[job->nkept++].value = v;
+            return;
+        }
+    }
+    radix_trie_pw_call(pw, thread, k, bit, v);
+}
+
+/* the key of slot i of n, past the bits of a key for the nodes of string tries */
+static INLINE
+uint64_t
+radix_trie_pw_key(nod *n, int i)
+{
+    int end = n->crit_bit + n->order;
+    uint64_t k = n->key & radix_trie_prefix_mask(n->crit_bit);
+
+    return end <= KEYSIZE_MAX ? k | (uint64_t)i << (KEYSIZE_MAX - end) : k;
+}
+
+/*
+ * radix_trie_pw_open:
+ *  the entries of node n to fn, the nodes below it on st, or gone
+ *  through at once without st, in key order then. A teardown frees the
+ *  leaves of a set and the node.
+ */
+static
+void
+radix_trie_pw_open(struct radix_trie_pwalk *pw, int thread, struct radix_trie_job *job, nod *n,
+                   struct radix_trie_stack *st)
+{
+    int i;
+
+    for (i = 0; i < (1 << n->order); i++)
+    {
+        nodetype nt = radix_trie_get_nodetype(n, i);
+        nod *c = 0;
+
+        if (nt == n_empty)
+            continue;
+        if (nt != n_external)
+            c = RT_CHILD(n, i);
+        if (nt != n_internal)
+        {
+            void *v = nt == n_external ? RT_SLOT(n, i) : RT_VALUE(n, i);
+
+            if (n->flags & RT_SKEY)
+                radix_trie_pw_emit(pw, thread, job, 0, 0, v);
+            else
+                radix_trie_pw_emit(pw, thread, job, radix_trie_pw_key(n, i), n->crit_bit + n->order, v);
+            if (pw->teardown && (pw->ctx->flags & RADIX_TRIE_SET))
+                radix_trie_mem_free(pw->ctx, v, RT_SET_LEAF);
+        }
+        if (c && (!st || radix_trie_push(st, c) != 0))
+            radix_trie_pw_open(pw, thread, job, c, st);
+    }
+
+    if (pw->teardown && n != pw->head)
+    {
+        if (n->flags & RT_SKEY)
+            free(RT_SEG(n));
+        radix_trie_free_node(pw->ctx, n);
+    }
+}
+
+/* a subtree from the shared stack, 0 once all threads are out of work */
+static
+int
+radix_trie_pw_take(struct radix_trie_pwalk *pw, nod **n, int *busy)
+{
+    int got = 0;
+
+    pthread_mutex_lock(&pw->lock);
+    if (*busy)
+        pw->busy--;
+    __atomic_add_fetch(&pw->hungry, 1, __ATOMIC_RELAXED);
+    while (!pw->pool.count && pw->busy)
+        pthread_cond_wait(&pw->cond, &pw->lock);
+    __atomic_sub_fetch(&pw->hungry, 1, __ATOMIC_RELAXED);
+    if (pw->pool.count)
+    {
+        *n = pw->pool.n[--pw->pool.count];
+        pw->busy++;
+        got = 1;
+    }
+    else
+    {
+        pthread_cond_broadcast(&pw->cond);
+    }
+    pthread_mutex_unlock(&pw->lock);
+    *busy = got;
+    return got;
+}
+
+/* the bottom half of st, to the threads out of work */
+static
+void
+radix_trie_pw_give(struct radix_trie_pwalk *pw, struct radix_trie_stack *st)
+{
+    size_t half = st->count / 2, i;
+
+    pthread_mutex_lock(&pw->lock);
+    for (i = 0; i < half; i++)
+    {
+        if (radix_trie_push(&pw->pool, st->n[i]) != 0)
+            break;
+    }
+    memmove(st->n, st->n + i, (st->count - i) * sizeof(nod*));
+    st->count -= i;
+    pthread_cond_broadcast(&pw->cond);
+    pthread_mutex_unlock(&pw->lock);
+}
+
+/* jobs done go to fn in turn */
+static
+void
+radix_trie_pw_done(struct radix_trie_pwalk *pw, int thread, struct radix_trie_job *job)
+{
+    pthread_mutex_lock(&pw->lock);
+    job->done = 1;
+    while (pw->emit < pw->njobs && pw->jobs[pw->emit].done)
+    {
+        radix_trie_pw_flush(pw, thread, &pw->jobs[pw->emit]);
+        __atomic_store_n(&pw->emit, pw->emit + 1, __ATOMIC_RELEASE);
+    }
+    pthread_cond_broadcast(&pw->cond);
+    pthread_mutex_unlock(&pw->lock);
+}
+
+static
+void
+radix_trie_pw_work(void *arg, int thread)
+{
+    struct radix_trie_pwalk *pw = (struct radix_trie_pwalk*)arg;
+    struct radix_trie_stack st = { 0, 0, 0 };
+    int busy = 0, j;
+    nod *n;
+
+    if (pw->jobs)
+    {
+        while ((j = __atomic_fetch_add(&pw->next, 1, __ATOMIC_RELAXED)) < pw->njobs)
+        {
+            struct radix_trie_job *job = &pw->jobs[j];
+
+            if (job->n)
+                radix_trie_pw_open(pw, thread, job, job->n, 0);
+            else
+                radix_trie_pw_emit(pw, thread, job, job->e.key, job->e.bit, job->e.value);
+            radix_trie_pw_done(pw, thread, job);
+        }
+        return;
+    }
+
+    for (;;)
+    {
+        if (st.count)
+            n = st.n[--st.count];
+        else if (!radix_trie_pw_take(pw, &n, &busy))
+            break;
+        if (st.count > 1 && __atomic_load_n(&pw->hungry, __ATOMIC_RELAXED))
+            radix_trie_pw_give(pw, &st);
+        radix_trie_pw_open(pw, thread, 0, n, &st);
+    }
+    free(st.n);
+}
+
+static
+struct radix_trie_job*
+radix_trie_pw_job(struct radix_trie_job **jobs, int *njobs, int *size)
+{
+    if (*njobs == *size)
+    {
+        int n = *size ? 2 * *size : 64;
+        struct radix_trie_job *p = (struct radix_trie_job*)realloc(*jobs, n * sizeof(*p));
+
+        if (!p)
+            return 0;
+        *jobs = p;
+        *size = n;
+    }
+    memset(&(*jobs)[*njobs], 0, sizeof(**jobs));
+    return &(*jobs)[(*njobs)++];
+}
+
+/*
+ * radix_trie_pw_split:
+ *  the jobs of an ordered walk, a level further down: the subtrees are
+ *  opened, each slot giving its entry and then the subtree below it.
+ *  Returns the subtrees there are now, -1 when out of memory.
+ */
+static
+int
+radix_trie_pw_split(struct radix_trie_pwalk *pw)
+{
+    struct radix_trie_job *jobs = 0, *x;
+    int njobs = 0, size = 0, subtrees = 0, j, i;
+
+    for (j = 0; j < pw->njobs && subtrees >= 0; j++)
+    {
+        nod *n = pw->jobs[j].n;
+
+        if (!n)
+        {
+            if ((x = radix_trie_pw_job(&jobs, &njobs, &size)))
+                *x = pw->jobs[j];
+            else
+                subtrees = -1;
+            continue;
+        }
+
+        for (i = 0; i < (1 << n->order) && subtrees >= 0; i++)
+        {
+            nodetype nt = radix_trie_get_nodetype(n, i);
+
+            if (nt == n_empty)
+                continue;
+            if (nt != n_internal)
+            {
+                if (!(x = radix_trie_pw_job(&jobs, &njobs, &size)))
+                {
+                    subtrees = -1;
+                    break;
+                }
+                x->e.key = radix_trie_pw_key(n, i);
+                x->e.bit = n->crit_bit + n->order;
+                x->e.value = nt == n_external ? RT_SLOT(n, i) : RT_VALUE(n, i);
+            }
+            if (nt != n_external)
+            {
+                if (!(x = radix_trie_pw_job(&jobs, &njobs, &size)))
+                {
+                    subtrees = -1;
+                    break;
+                }
+                x->n = RT_CHILD(n, i);
+                subtrees++;
+            }
+        }
+    }
+
+    if (subtrees < 0)
+    {
+        free(jobs);
+        return -1;
+    }
+    free(pw->jobs);
+    pw->jobs = jobs;
+    pw->njobs = njobs;
+    return subtrees;
+}
+
+/*
+ * radix_trie_pw_run:
+ *  the walk, or teardown, of the nodes from top down, in key order for
+ *  an ordered walk. What there is no memory to share out is gone
+ *  through on the caller's thread.
+ */
+static
+void
+radix_trie_pw_run(struct radix_trie_pwalk *pw, nod *top, int ordered)
+{
+    int most = pw->threads * (ordered ? RT_PW_JOBS : RT_PW_POOL);
+
+    pthread_mutex_init(&pw->lock, 0);
+    pthread_cond_init(&pw->cond, 0);
+
+    if (ordered)
+    {
+        int subtrees = 1;
+
+        pw->jobs = (struct radix_trie_job*)calloc(1, sizeof(struct radix_trie_job));
+        if (pw->jobs)
+        {
+            pw->jobs[0].n = top;
+            pw->njobs = 1;
+            while (subtrees > 0 && subtrees < most)
+                subtrees = radix_trie_pw_split(pw);
+            radix_trie_pool_run(pw->threads, radix_trie_pw_work, pw);
+            free(pw->jobs);
+        }
+        else
+        {
+            radix_trie_pw_open(pw, 0, 0, top, 0);
+        }
+    }
+    else if (radix_trie_push(&pw->pool, top) == 0)
+    {
+        /* the upper levels a level at a time, their entries go to thread 0 */
+        while (pw->pool.count && pw->pool.count < (size_t)most)
+        {
+            struct radix_trie_stack level = pw->pool;
+            size_t i;
+
+            memset(&pw->pool, 0, sizeof(pw->pool));
+            for (i = 0; i < level.count; i++)
+                radix_trie_pw_open(pw, 0, 0, level.n[i], &pw->pool);
+            free(level.n);
+        }
+        if (pw->pool.count)
+            radix_trie_pool_run(pw->threads, radix_trie_pw_work, pw);
+        free(pw->pool.n);
+    }
+    else
+    {
+        radix_trie_pw_open(pw, 0, 0, top, 0);
+    }
+
+    pthread_cond_destroy(&pw->cond);
+    pthread_mutex_destroy(&pw->lock);
+}
+
+static
+void
+radix_trie_walk_parallel_k(nod *root, void (*fn)(uint32_t key, int bit, void *v, int thread, void *arg),
+                           void (*fn64)(uint64_t key, int bit, void *v, int thread, void *arg),
+                           void *arg, int nthreads, int flags)
+{
+    struct radix_trie_pwalk pw;
+
+    if (!root)
+        return;
+
+    memset(&pw, 0, sizeof(pw));
+    pw.fn = fn;
+    pw.fn64 = fn64;
+    pw.arg = arg;
+    pw.threads = radix_trie_threads(nthreads);
+    radix_trie_pw_run(&pw, radix_trie_top(root), flags & RADIX_TRIE_WALK_ORDERED);
+}
+
+/* string tries have no integer keys to walk */
+static
+int
+radix_trie_pw_strings(nod *root)
+{
+    if (!root || !(root->flags & RT_SKEY))
+        return 0;
+    WARNING("%s\n", "string keys are walked by radix_trie_walk_str");
+    return 1;
+}
+
+/*
+ * radix_trie_walk_parallel:
+ *  fn for each entry, as radix_trie_walk, on nthreads threads (as many
+ *  as there are cpus for 0), with the thread it runs on and arg. The
+ *  entries come in no set order, on all threads at once; with
+ *  RADIX_TRIE_WALK_ORDERED they come in the order of radix_trie_walk,
+ *  one call at a time.
+ */
+void
+radix_trie_walk_parallel(nod *root, void (*fn)(uint32_t key, int bit, void *v, int thread, void *arg),
+                         void *arg, int nthreads, int flags)
+{
+    if (!radix_trie_pw_strings(root))
+        radix_trie_walk_parallel_k(root, fn, 0, arg, nthreads, flags);
+}
+
+void
+radix_trie_walk_parallel64(nod *root, void (*fn)(uint64_t key, int bit, void *v, int thread, void *arg),
+                           void *arg, int nthreads, int flags)
+{
+    if (!radix_trie_pw_strings(root))
+        radix_trie_walk_parallel_k(root, 0, fn, arg, nthreads, flags);
+}
+
+/*
+ * radix_trie_destroy_parallel:
+ *  fn for each entry, in no set order, as radix_trie_walk_parallel,
+ *  and the trie is freed on the same threads as it goes. Snapshots,
+ *  tries with snapshots left, shared tries and tries of an arena are
+ *  walked on threads and then freed by radix_trie_delete_all.
+ */
+void
+radix_trie_destroy_parallel(nod *r, void (*fn)(uint32_t key, int bit, void *v, int thread, void *arg),
+                            void *arg, int nthreads)
+{
+    struct radix_trie_pwalk pw;
+    struct radix_trie_ctx *ctx;
+    int i;
+
+    if (!r)
+        return;
+
+    ctx = (r->flags & RT_IMAGE) ? 0 : radix_trie_ctx(r);
+    if (!ctx || ctx->origin || ctx->snapshots || ctx->shared || ctx->arena)
+    {
+        if (fn)
+            radix_trie_walk_parallel_k(r, fn, 0, arg, nthreads, 0);
+        radix_trie_delete_all(r);
+        return;
+    }
+
+    memset(&pw, 0, sizeof(pw));
+    pw.fn = fn;
+    pw.arg = arg;
+    pw.ctx = ctx;
+    pw.teardown = 1;
+    pw.threads = radix_trie_threads(nthreads);
+    pw.head = (r->flags & RT_HEAD) ? r : 0;
+    radix_trie_pw_run(&pw, r, 0);
+
+    /* the head goes with its ctx, its slots are gone already */
+    if (pw.head)
+    {
+        for (i = 0; i < (1 << r->order); i++)
+        {
+            if (radix_trie_get_nodetype(r, i) != n_empty)
+                radix_trie_slot_remove(ctx, 0, r, i);
+        }
+        radix_trie_delete_all(r);
+    }
+}
+
+void
+radix_trie_delete_all_parallel(nod *root, int nthreads)
+{
+    radix_trie_destroy_parallel(root, 0, 0, nthreads);
+}
@@ -0,0 +1,351 @@
+/*
+Copyright (c) 2014 Dakai Liu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "radix-trie-int.h"
+
+
+/*
+  Sets.
+
+  A set is a trie of the keys less their last RT_SET_BITS bits, the
+  value of each is a leaf bitmap of 1 << RT_SET_BITS bits, one for each
+  key starting with it. Keys of 1 to RT_SET_BITS bits have no such
+  prefix, they are bits of a bitmap of the ctx, set_short. A lookup is
+  that of the prefix, then a bit test of its leaf; a leaf left with no
+  bit set goes. The leaves come from the allocator of the trie, and go
+  with radix_trie_delete_all.
+ */
+
+static INLINE
+int
+radix_trie_is_set(nod *r)
+{
+    if (r && (r->flags & RT_HEAD) && (radix_trie_ctx(r)->flags & RADIX_TRIE_SET))
+        return 1;
+    WARNING("%s\n", "not a trie made with RADIX_TRIE_SET");
+    return 0;
+}
+
+/* the leaf of a key, and the bit of it, NULL if there is none */
+static INLINE
+uint64_t*
+radix_trie_set_leaf(nod *r, uint64_t key, int len, int *bit)
+{
+    struct radix_trie_ctx *ctx = radix_trie_ctx(r);
+    void *v;
+
+    if (len <= RT_SET_BITS)
+    {
+        *bit = (1 << len) - 2 + (int)(key & ((1 << len) - 1));
+        return ctx->set_short;
+    }
+
+    *bit = (int)(key & ((1 << RT_SET_BITS) - 1));
+    if (!radix_trie_find64(r, key >> RT_SET_BITS, len - RT_SET_BITS, &v))
+        return 0;
+    return (uint64_t*)v;
+}
+
+static INLINE
+int
+radix_trie_set_empty(const uint64_t *l)
+{
+    uint64_t x = 0;
+    int i;
+
+    for (i = 0; i < RT_SET_WORDS; i++)
+        x |= l[i];
+    return x == 0;
+}
+
+static
+uint64_t*
+radix_trie_set_new(struct radix_trie_ctx *ctx, size_t size)
+{
+    uint64_t *l = (uint64_t*)radix_trie_mem_alloc(ctx, size);
+
+    if (l)
+        memset(l, 0, size);
+    return l;
+}
+
+/* returns 1 when the key was not in the set */
+int
+radix_trie_set_add(nod *r, uint64_t key, int len)
+{
+    struct radix_trie_ctx *ctx;
+    uint64_t *l;
+    int  bit;
+
+    if (len <= 0 || len > KEYSIZE_MAX || !radix_trie_is_set(r))
+        return 0;
+
+    ctx = radix_trie_ctx(r);
+    l = radix_trie_set_leaf(r, key, len, &bit);
+    if (!l)
+    {
+        l = radix_trie_set_new(ctx, len <= RT_SET_BITS ? RT_SET_SHORT : RT_SET_LEAF);
+        if (!l)
+            return 0;
+        if (len <= RT_SET_BITS)
+            ctx->set_short = l;
+        else
+            radix_trie_insert64(r, key >> RT_SET_BITS, len - RT_SET_BITS, l);
+    }
+
+    if (l[bit >> 6] & (uint64_t)1 << (bit & 63))
+        return 0;
+    l[bit >> 6] |= (uint64_t)1 << (bit & 63);
+    return 1;
+}
+
+int
+radix_trie_set_has(nod *root, uint64_t key, int len)
+{
+    uint64_t *l;
+    int  bit;
+
+    if (len <= 0 || len > KEYSIZE_MAX || !radix_trie_is_set(root))
+        return 0;
+
+    l = radix_trie_set_leaf(root, key, len, &bit);
+    return l && (l[bit >> 6] >> (bit & 63) & 1);
+}
+
+/* returns 1 when the key was in the set */
+int
+radix_trie_set_remove(nod *r, uint64_t key, int len)
+{
+    uint64_t *l;
+    int  bit;
+
+    if (len <= 0 || len > KEYSIZE_MAX || !radix_trie_is_set(r))
+        return 0;
+
+    l = radix_trie_set_leaf(r, key, len, &bit);
+    if (!l || !(l[bit >> 6] >> (bit & 63) & 1))
+        return 0;
+
+    l[bit >> 6] &= ~((uint64_t)1 << (bit & 63));
+    if (len > RT_SET_BITS && radix_trie_set_empty(l))
+    {
+        radix_trie_delete64(r, key >> RT_SET_BITS, len - RT_SET_BITS);
+        radix_trie_mem_free(radix_trie_ctx(r), l, RT_SET_LEAF);
+    }
+    return 1;
+}
+
+size_t
+radix_trie_set_count(nod *root)
+{
+    struct radix_trie_ctx *ctx;
+    radix_trie_cursor c;
+    size_t n = 0;
+    int  i, ok;
+
+    if (!radix_trie_is_set(root))
+        return 0;
+
+    ctx = radix_trie_ctx(root);
+    for (i = 0; ctx->set_short && i < 2 * RT_SET_WORDS; i++)
+        n += radix_trie_popcount(ctx->set_short[i]);
+
+    for (ok = radix_trie_first(&c, root); ok; ok = radix_trie_next(&c))
+    {
+        const uint64_t *l = (const uint64_t*)c.value;
+
+        for (i = 0; i < RT_SET_WORDS; i++)
+            n += radix_trie_popcount(l[i]);
+    }
+    return n;
+}
+
+void
+radix_trie_set_walk(nod *root, void (*fn)(uint64_t key, int bit, void *v))
+{
+    struct radix_trie_ctx *ctx;
+    radix_trie_cursor c;
+    int  len, b, ok;
+
+    if (!radix_trie_is_set(root))
+        return;
+
+    ctx = radix_trie_ctx(root);
+    for (len = 1; ctx->set_short && len <= RT_SET_BITS; len++)
+    {
+        for (b = 0; b < 1 << len; b++)
+        {
+            int bit = (1 << len) - 2 + b;
+
+            if (ctx->set_short[bit >> 6] >> (bit & 63) & 1)
+                fn((uint64_t)b << (KEYSIZE_MAX - len), len, 0);
+        }
+    }
+
+    for (ok = radix_trie_first(&c, root); ok; ok = radix_trie_next(&c))
+    {
+        const uint64_t *l = (const uint64_t*)c.value;
+        int shift = KEYSIZE_MAX - c.len - RT_SET_BITS;
+
+        for (b = 0; b < RT_SET_WORDS; b++)
+        {
+            uint64_t w = l[b];
+
+            /* the set bits of a word, lowest first */
+            while (w)
+            {
+                int i = radix_trie_popcount((w & -w) - 1);
+
+                fn(c.key | (uint64_t)(b * 64 + i) << shift, c.len + RT_SET_BITS, 0);
+                w &= w - 1;
+            }
+        }
+    }
+}
+
+
+/* the three set operations, a leaf of a with that of b */
+enum { RT_SET_OR, RT_SET_AND, RT_SET_ANDNOT };
+
+static INLINE
+void
+radix_trie_set_op(uint64_t *a, const uint64_t *b, int words, int op)
+{
+    int i;
+
+    switch (op)
+    {
+        case RT_SET_OR:
+            for (i = 0; i < words; i++)
+                a[i] |= b[i];
+            break;
+        case RT_SET_AND:
+            for (i = 0; i < words; i++)
+                a[i] &= b[i];
+            break;
+        default:
+            for (i = 0; i < words; i++)
+                a[i] &= ~b[i];
+            break;
+    }
+}
+
+/*
+ * the leaves of a changed by those of b. A union goes over the leaves
+ * of b, adding those a lacks, the others over those of a, deleting
+ * those left empty, after which the cursor starts again from the next.
+ */
+static
+int
+radix_trie_set_ops(nod *a, nod *b, int op)
+{
+    struct radix_trie_ctx *ca, *cb;
+    radix_trie_cursor c;
+    int  ok;
+
+    if (!radix_trie_is_set(a) || !radix_trie_is_set(b))
+        return -1;
+
+    ca = radix_trie_ctx(a);
+    cb = radix_trie_ctx(b);
+
+    /* the keys of upto RT_SET_BITS bits */
+    if (cb->set_short)
+    {
+        if (!ca->set_short && op == RT_SET_OR)
+        {
+            ca->set_short = radix_trie_set_new(ca, RT_SET_SHORT);
+            if (!ca->set_short)
+                return -1;
+        }
+        if (ca->set_short)
+            radix_trie_set_op(ca->set_short, cb->set_short, 2 * RT_SET_WORDS, op);
+    }
+    else if (ca->set_short && op == RT_SET_AND)
+    {
+        memset(ca->set_short, 0, RT_SET_SHORT);
+    }
+
+    if (op == RT_SET_OR)
+    {
+        for (ok = radix_trie_first(&c, b); ok; ok = radix_trie_next(&c))
+        {
+            uint64_t k = c.key >> (KEYSIZE_MAX - c.len);
+            uint64_t *l;
+            void *v;
+
+            if (radix_trie_find64(a, k, c.len, &v))
+            {
+                radix_trie_set_op((uint64_t*)v, (const uint64_t*)c.value, RT_SET_WORDS, op);
+                continue;
+            }
+            l = radix_trie_set_new(ca, RT_SET_LEAF);
+            if (!l)
+                return -1;
+            memcpy(l, c.value, RT_SET_LEAF);
+            radix_trie_insert64(a, k, c.len, l);
+        }
+        return 0;
+    }
+
+    ok = radix_trie_first(&c, a);
+    while (ok)
+    {
+        uint64_t k = c.key >> (KEYSIZE_MAX - c.len);
+        uint64_t *l = (uint64_t*)c.value;
+        int  len = c.len;
+        void *v;
+
+        if (radix_trie_find64(b, k, len, &v))
+            radix_trie_set_op(l, (const uint64_t*)v, RT_SET_WORDS, op);
+        else if (op == RT_SET_AND)
+            memset(l, 0, RT_SET_LEAF);
+
+        if (!radix_trie_set_empty(l))
+        {
+            ok = radix_trie_next(&c);
+            continue;
+        }
+        radix_trie_delete64(a, k, len);
+        radix_trie_mem_free(ca, l, RT_SET_LEAF);
+        ok = radix_trie_lower_bound64(&c, a, k, len);
+    }
+    return 0;
+}
+
+int
+radix_trie_set_union(nod *a, nod *b)
+{
+    return radix_trie_set_ops(a, b, RT_SET_OR);
+}
+
+int
+radix_trie_set_intersect(nod *a, nod *b)
+{
+    return radix_trie_set_ops(a, b, RT_SET_AND);
+}
+
+int
+radix_trie_set_subtract(nod *a, nod *b)
+{
+    return radix_trie_set_ops(a, b, RT_SET_ANDNOT);
+}
@@ -0,0 +1,638 @@
+/*
+Copyright (c) 2014 Dakai Liu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "radix-trie-int.h"
+
+
+/*
+  Byte string keys.
+
+  The nodes, slots and layouts are those of the integer trie, a key
+  of "len" bytes is a key of 8 * len bits, the first bit is the most
+  significant bit of the first byte. What differs is the key kept in a
+  node: a string can not be held in an uint64_t, so the node keeps the
+  bits it skips, from the end of the node above it (its "parent" bit)
+  up to its crit_bit, as a path segment in a small buffer of its own,
+  RT_SEG(n). Nodes without skipped bits have no segment.
+
+  The segment holds the bytes of the key covering bits
+  [parent, crit_bit), byte parent >> 3 being its first byte. The bits
+  before parent in that byte are unused.
+
+  A lookup checks the segment of each node on its way down, and takes
+  a slot of "order" bits, so a key of len bytes is found in at most
+  8 * len / order node visits, plus the compares of the skipped
+  bytes. Nodes are aligned on the order of the trie from the first bit, with the
+  default order of 4 every byte ends on a node boundary.
+
+  Entries are walked in the byte order of their keys, a key comes
+  before the keys it is a prefix of.
+ */
+
+
+/* the "order" bits of k from bit "pos", k holds the bytes from byte "base" on */
+static INLINE
+int
+radix_trie_sbits(const unsigned char *k, int base, int pos, int order)
+{
+    int b = (pos >> 3) - base;
+    unsigned v = (unsigned)k[b] << 8;
+
+    if ((pos & 7) + order > 8)
+        v |= k[b + 1];
+
+    return (int)(v >> (16 - (pos & 7) - order)) & ((1 << order) - 1);
+}
+
+/* set the "order" bits of buf from bit "pos" to v */
+static INLINE
+void
+radix_trie_sput(unsigned char *buf, int pos, int order, int v)
+{
+    int b = pos >> 3;
+    unsigned x = ((unsigned)buf[b] << 8) | ((pos & 7) + order > 8 ? buf[b + 1] : 0);
+    unsigned m = ((1U << order) - 1) << (16 - (pos & 7) - order);
+
+    x = (x & ~m) | (((unsigned)v << (16 - (pos & 7) - order)) & m);
+    buf[b] = (unsigned char)(x >> 8);
+    if ((pos & 7) + order > 8)
+        buf[b + 1] = (unsigned char)x;
+}
+
+/* index of the first set bit of a non zero byte */
+static INLINE
+int
+radix_trie_clz8(unsigned x)
+{
+#if defined(__GNUC__)
+    return __builtin_clz(x) - (int)(sizeof(unsigned) * 8 - 8);
+#else
+    int i = 0;
+
+    while (!(x & 0x80))
+    {
+        x <<= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+
+/*
+ * radix_trie_seg:
+ *  a path segment of bits [skip, crit_bit) of k, k holds the bytes from
+ *  byte "base" on. NULL if there is nothing to skip.
+ */
+static
+unsigned char*
+radix_trie_seg(struct radix_trie_ctx *ctx, const unsigned char *k, int base, int skip, int crit_bit)
+{
+    unsigned char *s;
+    int from = skip >> 3;
+    int to = (crit_bit + 7) >> 3;
+
+    if (crit_bit <= skip)
+        return 0;
+
+    s = (unsigned char*)radix_trie_mem_alloc(ctx, to - from);
+    memcpy(s, k + from - base, to - from);
+
+    return s;
+}
+
+/*
+ * radix_trie_seg_match:
+ *  the first bit in [from, to) where the key of "bits" bits differs from
+ *  the segment starting at bit "from". When there is none, "to", or
+ *  "bits" if the key ends first.
+ */
+static
+int
+radix_trie_seg_match(const unsigned char *k, int bits, const unsigned char *seg, int from, int to)
+{
+    int end = to < bits ? to : bits;
+    int base = from >> 3;
+    int i, pos;
+
+    for (pos = from; pos < end; pos = (i + 1) << 3)
+    {
+        unsigned x;
+
+        i = pos >> 3;
+        x = (k[i] ^ seg[i - base]) & (0xff >> (pos & 7));
+        if (x)
+        {
+            pos = (i << 3) + radix_trie_clz8(x);
+            return pos < end ? pos : end;
+        }
+    }
+
+    return end;
+}
+
+
+/* a node of a string trie, skipping bits [skip, crit_bit) of k */
+static
+nod*
+radix_trie_snew(struct radix_trie_ctx *ctx, const unsigned char *k, int base, int skip,
+                int crit_bit, int order, int count)
+{
+    nod *n = radix_trie_new(ctx, 0, crit_bit, order, count);
+
+    n->flags = RT_SKEY;
+    n->key = (uintptr_t)radix_trie_seg(ctx, k, base, skip, crit_bit);
+
+    return n;
+}
+
+/* n is below the node ending at bit "parent" */
+static
+void
+radix_trie_sfree(struct radix_trie_ctx *ctx, nod *n, int parent)
+{
+    if (n->crit_bit > parent)
+        radix_trie_mem_free(ctx, RT_SEG(n), RT_SEG_SIZE(parent, n->crit_bit));
+    radix_trie_free_node(ctx, n);
+}
+
+
+/*
+ * radix_trie_sleaf:
+ *  as radix_trie_leaf, a node holding the key alone, below the node
+ *  ending at bit "parent".
+ */
+static
+nod*
+radix_trie_sleaf(struct radix_trie_ctx *ctx, const unsigned char *k, int length, int parent, void *value)
+{
+    nod *n;
+    int crit_bit = length - ctx->order;
+
+    if (crit_bit < parent)
+        crit_bit = parent;
+
+    n = radix_trie_snew(ctx, k, 0, parent, crit_bit, length - crit_bit, 1);
+    radix_trie_slot_add(ctx, 0, n, radix_trie_sbits(k, 0, crit_bit, n->order), n_external, value);
+
+    return n;
+}
+
+
+/*
+ * radix_trie_ssplit:
+ *  as radix_trie_split, the key leaves the path of n at bit "prefix",
+ *  inside the segment of n. The new node takes the head of the
+ *  segment, n keeps the rest.
+ */
+static
+nod*
+radix_trie_ssplit(struct radix_trie_ctx *ctx, nod *n, const unsigned char *k, int length,
+                  int prefix, int parent, void *value)
+{
+    nod *n_nod;
+    unsigned char *seg = RT_SEG(n);
+    int  crit_bit, end, i, slot_old;
+
+    if (prefix >= length)
+    {
+        crit_bit = length - ctx->order;
+        end = length;
+    }
+    else
+    {
+        crit_bit = prefix / ctx->order * ctx->order;
+        end = crit_bit + ctx->order;
+        if (end > n->crit_bit)
+            end = n->crit_bit;
+        if (end > length)
+            end = length;
+    }
+    if (crit_bit < parent)
+        crit_bit = parent;
+
+    n_nod = radix_trie_snew(ctx, k, 0, parent, crit_bit, end - crit_bit, 2);
+    n_nod->value = n->value;
+
+    /* bits [crit_bit, end) of n are in its segment */
+    slot_old = radix_trie_sbits(seg, parent >> 3, crit_bit, n_nod->order);
+    i = radix_trie_sbits(k, 0, crit_bit, n_nod->order);
+
+    n->key = (uintptr_t)radix_trie_seg(ctx, seg, parent >> 3, end, n->crit_bit);
+    radix_trie_mem_free(ctx, seg, RT_SEG_SIZE(parent, n->crit_bit));
+
+    if (prefix >= length)
+    {
+        n->value = value;
+        radix_trie_slot_add(ctx, 0, n_nod, slot_old, n_composite, n);
+    }
+    else
+    {
+        radix_trie_slot_add(ctx, 0, n_nod, slot_old, n_internal, n);
+
+        if (length == end)
+        {
+            radix_trie_slot_add(ctx, 0, n_nod, i, n_external, value);
+        }
+        else
+        {
+            nod *n_child = radix_trie_sleaf(ctx, k, length, end, value);
+            radix_trie_slot_add(ctx, 0, n_nod, i, n_internal, n_child);
+        }
+    }
+
+    return n_nod;
+}
+
+
+/*
+ * radix_trie_insert_str:
+ *  insert a key of "len" bytes, 1 to RADIX_TRIE_STR_MAX. The trie only
+ *  holds string keys, it is either NULL or made by radix_trie_create().
+ */
+nod*
+radix_trie_insert_str(nod *r, const void *key, size_t len, void *value)
+{
+    struct radix_trie_ctx *ctx = radix_trie_ctx(r);
+    const unsigned char *k = (const unsigned char*)key;
+    nod **ref = &r;
+    int  length = (int)len * 8;
+    int  parent = 0;
+
+    if (len == 0 || len > RADIX_TRIE_STR_MAX)
+    {
+        WARNING("bad key length %lu\n", (unsigned long)len);
+        return r;
+    }
+
+    if (radix_trie_readonly(r))
+        return r;
+
+    if (r)
+        r->flags |= RT_SKEY;
+
+    while (*ref)
+    {
+        nod *n = *ref;
+        int  end = n->crit_bit + n->order;
+        int  prefix, i;
+        nodetype nt;
+        nod **s;
+
+        prefix = radix_trie_seg_match(k, length, RT_SEG(n), parent, n->crit_bit);
+
+        if (prefix < n->crit_bit || length == n->crit_bit)
+        {
+            *ref = radix_trie_ssplit(ctx, n, k, length, prefix, parent, value);
+            return r;
+        }
+
+        if (length < end)
+        {
+            n = radix_trie_split_order(ctx, ref, length);
+            end = length;
+        }
+
+        i = radix_trie_sbits(k, 0, n->crit_bit, n->order);
+        nt = radix_trie_get_nodetype(n, i);
+        s = radix_trie_slot(n, i);
+
+        if (length == end)
+        {
+            switch (nt)
+            {
+                case n_empty:
+                    radix_trie_slot_add(ctx, ref, n, i, n_external, value);
+                    break;
+                case n_external:
+                    *s = value;
+                    break;
+                case n_internal:
+                    (*s)->value = value;
+                    radix_trie_set_nodetype(n, n_composite, i);
+                    break;
+                case n_composite:
+                    (*s)->value = value;
+                    break;
+            }
+            return r;
+        }
+
+        switch (nt)
+        {
+            case n_empty:
+                radix_trie_slot_add(ctx, ref, n, i, n_internal,
+                                    radix_trie_sleaf(ctx, k, length, end, value));
+                return r;
+
+            case n_external:
+                {
+                    nod *n_child = radix_trie_sleaf(ctx, k, length, end, value);
+
+                    n_child->value = *s;
+                    radix_trie_set_nodetype(n, n_composite, i);
+                    *s = n_child;
+                }
+                return r;
+
+            default:
+                parent = end;
+                ref = s;
+                break;
+        }
+    }
+
+    *ref = radix_trie_sleaf(ctx, k, length, parent, value);
+
+    return r;
+}
+
+
+/*
+ * return:
+ *  0 for not found
+ *  1 for found, value stored in val
+ */
+int
+radix_trie_find_str(nod *r, const void *key, size_t len, void **val)
+{
+    const unsigned char *k = (const unsigned char*)key;
+    int  length = (int)len * 8;
+    int  parent = 0;
+    int  i;
+    nodetype nt;
+
+    if (len == 0 || len > RADIX_TRIE_STR_MAX)
+        return 0;
+
+    while (r)
+    {
+        int end = r->crit_bit + r->order;
+
+        if (length < end)
+            return 0;
+
+        if (r->crit_bit > parent &&
+            radix_trie_seg_match(k, length, RT_SEG(r), parent, r->crit_bit) < r->crit_bit)
+            return 0;
+
+        i = radix_trie_sbits(k, 0, r->crit_bit, r->order);
+        nt = radix_trie_get_nodetype(r, i);
+
+        if (length == end)
+        {
+            switch (nt)
+            {
+                case n_composite:
+                    *val = (*radix_trie_slot(r, i))->value;
+                    return 1;
+                case n_external:
+                    *val = *radix_trie_slot(r, i);
+                    return 1;
+                default:
+                    return 0;
+            }
+        }
+
+        if (nt != n_internal && nt != n_composite)
+            return 0;
+
+        parent = end;
+        r = *radix_trie_slot(r, i);
+    }
+
+    return 0;
+}
+
+
+static
+int
+radix_trie_delete_sr(struct radix_trie_ctx *ctx, nod **ref, nod *n, const unsigned char *k,
+                     int length, int parent)
+{
+    int  r = 0;
+    int  i;
+    nodetype nt;
+    nod **s;
+
+    if (length < n->crit_bit + n->order)
+        return 0;
+
+    if (n->crit_bit > parent &&
+        radix_trie_seg_match(k, length, RT_SEG(n), parent, n->crit_bit) < n->crit_bit)
+        return 0;
+
+    i = radix_trie_sbits(k, 0, n->crit_bit, n->order);
+    nt = radix_trie_get_nodetype(n, i);
+    s = radix_trie_slot(n, i);
+
+    if (length == n->crit_bit + n->order)
+    {
+        switch (nt)
+        {
+            case n_composite:
+                radix_trie_set_nodetype(n, n_internal, i);
+                r = 1;
+                break;
+            case n_external:
+                radix_trie_slot_remove(ctx, ref, n, i);
+                r = 1;
+                break;
+            default:
+                break;
+        }
+        return r;
+    }
+
+    switch (nt)
+    {
+        case n_internal:
+            r = radix_trie_delete_sr(ctx, s, *s, k, length, n->crit_bit + n->order);
+            if (r && radix_trie_is_empty(*s))
+            {
+                radix_trie_sfree(ctx, *s, n->crit_bit + n->order);
+                radix_trie_slot_remove(ctx, ref, n, i);
+            }
+            break;
+        case n_composite:
+            r = radix_trie_delete_sr(ctx, s, *s, k, length, n->crit_bit + n->order);
+            if (r && radix_trie_is_empty(*s))
+            {
+                void *x = (*s)->value;
+                radix_trie_sfree(ctx, *s, n->crit_bit + n->order);
+                radix_trie_set_nodetype(n, n_external, i);
+                *s = x;
+            }
+            break;
+        default:
+            break;
+    }
+    return r;
+}
+
+/*
+ * radix_trie_delete_str:
+ *  as radix_trie_delete, the root stays in place.
+ */
+int
+radix_trie_delete_str(nod *n, const void *key, size_t len)
+{
+    if (!n || len == 0 || len > RADIX_TRIE_STR_MAX || radix_trie_readonly(n))
+        return 0;
+
+    return radix_trie_delete_sr(radix_trie_ctx(n), 0, n, (const unsigned char*)key, (int)len * 8, 0);
+}
+
+
+struct radix_trie_swalk
+{
+    unsigned char *buf;
+    size_t size;
+    void (*fn)(const void *key, size_t len, void *v);
+    int  nomem;                 /* the buffer could not grow, the walk stops */
+};
+
+/* walk slots [from, to) of n, the key upto bit "parent" is in w->buf */
+static
+void
+radix_trie_walk_sr(struct radix_trie_swalk *w, nod *n, int parent, int from, int to)
+{
+    int end = n->crit_bit + n->order;
+    int i, b;
+
+    if ((size_t)(end + 7) >> 3 > w->size)
+    {
+        size_t size = ((end + 7) >> 3) * 2;
+        unsigned char *p = (unsigned char*)realloc(w->buf, size);
+
+        if (!p)
+        {
+            w->nomem = 1;
+            return;
+        }
+        w->buf = p;
+        w->size = size;
+    }
+
+    /* the skipped bits */
+    for (b = parent >> 3; n->crit_bit > parent && b < (n->crit_bit + 7) >> 3; b++)
+    {
+        unsigned m = 0xff;
+
+        if (b == parent >> 3)
+            m &= 0xff >> (parent & 7);
+        if (b == (n->crit_bit - 1) >> 3 && (n->crit_bit & 7))
+            m &= 0xff << (8 - (n->crit_bit & 7));
+
+        w->buf[b] = (unsigned char)((w->buf[b] & ~m) | (RT_SEG(n)[b - (parent >> 3)] & m));
+    }
+
+    for (i = from; i < to && !w->nomem; i++)
+    {
+        nodetype nt = radix_trie_get_nodetype(n, i);
+
+        if (nt == n_empty)
+            continue;
+
+        radix_trie_sput(w->buf, n->crit_bit, n->order, i);
+
+        if (nt == n_external)
+            w->fn(w->buf, end >> 3, *radix_trie_slot(n, i));
+        else if (nt == n_composite)
+            w->fn(w->buf, end >> 3, (*radix_trie_slot(n, i))->value);
+
+        if (nt != n_external)
+            radix_trie_walk_sr(w, *radix_trie_slot(n, i), end, 0, 1 << (*radix_trie_slot(n, i))->order);
+    }
+}
+
+/*
+ * radix_trie_walk_str:
+ *  call fn on each entry whose key starts with the "len" bytes of
+ *  prefix, all of them when len is 0, in the byte order of the keys.
+ *  The key given to fn is only valid during the call. Out of memory
+ *  for a longer key, the walk stops there.
+ */
+void
+radix_trie_walk_str(nod *root, const void *prefix, size_t len,
+                    void (*fn)(const void *key, size_t len, void *v))
+{
+    const unsigned char *k = (const unsigned char*)prefix;
+    struct radix_trie_swalk w;
+    int  length = (int)len * 8;
+    int  parent = 0;
+    nod *n = root;
+
+    if (!root || len > RADIX_TRIE_STR_MAX)
+        return;
+
+    w.size = len + 16;
+    w.buf = (unsigned char*)malloc(w.size);
+    w.fn = fn;
+    w.nomem = 0;
+    if (!w.buf)
+        return;
+    if (len)
+        memcpy(w.buf, k, len);
+
+    /* the subtree below prefix */
+    while (n)
+    {
+        int end = n->crit_bit + n->order;
+        int lo, h, i;
+        nodetype nt;
+
+        if (radix_trie_seg_match(k, length, RT_SEG(n), parent, n->crit_bit) <
+            (length < n->crit_bit ? length : n->crit_bit))
+            break;
+
+        if (length <= n->crit_bit)
+        {
+            radix_trie_walk_sr(&w, n, parent, 0, 1 << n->order);
+            break;
+        }
+
+        if (length < end)
+        {
+            lo = end - length;
+            h = radix_trie_sbits(k, 0, n->crit_bit, n->order - lo);
+            radix_trie_walk_sr(&w, n, parent, h << lo, (h + 1) << lo);
+            break;
+        }
+
+        i = radix_trie_sbits(k, 0, n->crit_bit, n->order);
+        if (length == end)
+        {
+            radix_trie_walk_sr(&w, n, parent, i, i + 1);
+            break;
+        }
+
+        nt = radix_trie_get_nodetype(n, i);
+        if (nt != n_internal && nt != n_composite)
+            break;
+
+        parent = end;
+        n = *radix_trie_slot(n, i);
+    }
+
+    free(w.buf);
+}
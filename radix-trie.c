@@ -20,10 +20,20 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 
-#include <stdio.h>
-#include <string.h>
-#include <stdlib.h>
-#include "radix-trie.h"
+#include "radix-trie-int.h"
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sched.h>
+#define RT_YIELD() sched_yield()
+#else
+#define RT_YIELD() ((void)0)
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RT_X86 1
+#include <immintrin.h>
+#endif
 
 
 /*
@@ -41,14 +51,18 @@ THE SOFTWARE.
   most of the keys are clustered, or more densely pouplated than its
   binary tree cousin.
 
-  The reason of having maximum of 32 slot is keep the implementation
-  simple, so the tag field can be hold in a single 32 bit integer field,
+  The reason of having maximum of 64 slot is keep the implementation
+  simple, so the tag field can be hold in a single integer field,
   otherwise, the tag field need to be in two integer arrays instead
-  of two 32 bit integer, like those implementation in linux-kernel.
+  of two integer, like those implementation in linux-kernel. The tag
+  fields are 32 bit wide up to RADIX_ORDER_MAX 5, and 64 bit for order 6.
 
-  Note: the integer type uint32_t is used in the structure should be
-  able to be replaced by  uint64_t for keys with length upto 64
-  bit. However, this experiement is still in the to do list.
+  Keys are kept as uint64_t, aligned on the most significant bit, for
+  keys with length upto 64 bit. The 32 bit interface passes its keys
+  through as they are, a 32 bit key of length "len" is the same number
+  as a 64 bit key of that length. Nodes are aligned on the order from
+  the end of the key being inserted, so a trie of 32 bit keys is laid
+  out exactly as before.
 
   Note: In order to avoid the confusion with the implementation of
   radix tree  in linux kernel, radix_trie is used in this
@@ -60,789 +74,3226 @@ THE SOFTWARE.
   * variable key length.
   *  keys are not NULL terminated.
   *  flexible prefix bit length for maximum space efficiency.
-  *  the macro RADIX_ORDER ranges can be configured from 1 to 5, to
-     suit different applications.
-  *  full 32 bit keys are kept in node, unlike string based
+  *  the order ranges from 1 to RADIX_ORDER_MAX, at most 6, per trie
+     with RADIX_TRIE_ORDER(), to suit different applications.
+  *  full 64 bit keys are kept in node, unlike string based
      implementation, as keeping only portions of prefix.
+
+  Compact nodes:
+
+  A full node carries all 1 << order slots in fan[], most of them
+  empty when the keys are sparse or random.  A compact node keeps
+  only the occupied slots, packed in slot order, and the position of
+  slot i in fan[] is the number of occupied slots below i, i.e. the
+  popcount of (tag | tag1) masked below bit i.  Compact nodes grow
+  and shrink as slots are added and removed, which may move the node,
+  so every modification goes through the reference held by the parent
+  (or the root pointer), see radix_trie_slot_add/radix_trie_slot_remove.
+
+  The layout is selected per trie with radix_trie_create(), or left to
+  the library (RADIX_TRIE_AUTO), in which case nodes start compact and
+  are turned into full nodes once most of their slots are taken.
  */
 
-#define KEYSIZE_MAX 32
-#define RADIX_ORDER 4
-#define MAP_SIZE (1<<RADIX_ORDER)
 
-typedef enum
-{
-    n_empty,
-    n_external,
-    n_internal,
-    n_composite
-} nodetype;
+static const int radix_trie_class[RT_CLASSES] = { 1, 4, 16, 48 };
+
+struct radix_trie_ctx radix_trie_default_ctx = { RADIX_TRIE_AUTO, RADIX_ORDER };
 
-#if RADIX_ORDER > 5
-#error Maximum fan factor is 32
-#endif
 
+/* the number of leading bits k0 and k1 have in common */
+static INLINE
+int
+radix_trie_find_prefix(uint64_t k0, uint64_t k1)
+{
+    uint64_t x = k0 ^ k1;
 
-#ifdef DEBUG
-#define WARNING(...) fprintf(stderr, __VA_ARGS__)
+    if (x == 0)
+        return KEYSIZE_MAX;
+#if defined(__GNUC__)
+    return __builtin_clzll(x);
 #else
-#define WARNING(...)
-#endif
+    {
+        uint64_t msk = (uint64_t)1 << (KEYSIZE_MAX - 1);
+        int i = 0;
 
+        while ((x & msk) == 0)
+        {
+            i++;
+            msk >>= 1;
+        }
+        return i;
+    }
+#endif
+}
 
 
-/* tag and tag1 bit */
 /*
-  tag      tag1
-   0        0      empty
-   1        0      external
-   0        1      internal
-   1        1      internal + external
+ * node layout policy:
+ *  how a node holding "count" slots should be laid out, returns the
+ *  capacity of fan[], *kind is updated.
  */
+static
+int
+radix_trie_fit(struct radix_trie_ctx *ctx, int count, int *kind)
+{
+    int i;
 
+    if (ctx->flags & RADIX_TRIE_FULL)
+    {
+        *kind = RT_FULL;
+        return 1 << ctx->order;
+    }
 
-/* node are internal ONLY */
-struct node
-{
-    uint32_t key;
-    uint32_t tag; /* bitfield, 0 for internal node, 1 for external data */
-    uint32_t tag1; /* bitfield, 0 is undefined, 1 for internal + external(value) */
-    int  crit_bit;
-    int  order;    /* Normally order == RADIX_ORDER, when 32 % RADIX_ORDER != 0, it can be less than RADIX_ORDER */
-    void *value;
-    struct node *fan[MAP_SIZE];
-};
+    if (ctx->flags & RADIX_TRIE_COMPACT)
+    {
+        *kind = RT_COMPACT;
+
+        /* a leaf holds a single slot, bigger nodes grow and shrink by 2 slots */
+        if (count > 2)
+            count = (count + 1) & ~1;
+        if (count == 0)
+            count = 1;
+        if (count > 1 << ctx->order)
+            count = 1 << ctx->order;
+        return count;
+    }
 
+    for (i = 0; i < RT_CLASSES && radix_trie_class[i] < 1 << ctx->order; i++)
+    {
+        if (count <= radix_trie_class[i])
+        {
+            *kind = radix_trie_class[i] < RT_INDEXED_MIN ? RT_COMPACT : RT_INDEXED;
+            return radix_trie_class[i];
+        }
+    }
+
+    *kind = RT_FULL;
+    return 1 << ctx->order;
+}
 
 /*
- * key: are 32 bit integer
- * crit_bit: the last bit of common prefix
- * order: the exponent over 2 on span
+ * radix_trie_shrink:
+ *  capacity a node should shrink to once it is down to "count" slots,
+ *  0 to keep it as it is. Classes are left when a quarter of the
+ *  smaller class would still be free, so a node going back and forth
+ *  across a class boundary is not copied on every insert and delete.
  */
-static INLINE
+static
 int
-radix_trie_find_slot(uint32_t key, int order, int crit_bit)
+radix_trie_shrink(struct radix_trie_ctx *ctx, nod *n, int count, int *kind)
 {
-    int len = KEYSIZE_MAX;
+    int cap = radix_trie_fit(ctx, count, kind);
+    int size = n->cap;
 
-    uint32_t n_crit_bit = crit_bit + order;
-
-    uint32_t n = 0;
+    if (cap >= size)
+        return 0;
 
-    uint32_t msk = ~0UL >> (KEYSIZE_MAX - order);
+    if (!(ctx->flags & RADIX_TRIE_COMPACT) && count > cap - cap / 4)
+        return 0;
 
-    n =  ~0UL >> (KEYSIZE_MAX - n_crit_bit);
+    return cap;
+}
 
-    n &= key >> (KEYSIZE_MAX - n_crit_bit);
 
-    n &= msk;
+/*
+ * arena:
+ *  nodes of a RADIX_TRIE_ARENA trie are carved from chunks owned by the
+ *  trie, starting at 64K and doubling upto 2M, the 2M ones aligned on 2M
+ *  so they can be backed by huge pages. Blocks are rounded to
+ *  RT_ARENA_GRAIN bytes, freed blocks go to a free list per size,
+ *  blocks bigger than the largest class (long string segments) get a
+ *  chunk of their own, kept until the trie is deleted.
+ */
+#define RT_ARENA_GRAIN      16
+#define RT_ARENA_CLASSES    64
+#define RT_ARENA_CHUNK_MIN  ((size_t)64 << 10)
+#define RT_ARENA_CHUNK_MAX  ((size_t)2 << 20)
+#define RT_CACHE_LINE       64
 
-    return (int)n;
-}
+struct radix_trie_chunk
+{
+    struct radix_trie_chunk *next;
+};
 
+/* the first block of a chunk starts on a cache line */
+#define RT_CHUNK_HEAD  RT_CACHE_LINE
 
+struct radix_trie_arena
+{
+    struct radix_trie_chunk *chunks;
+    char  *top;      /* free space of the current chunk */
+    char  *end;
+    size_t next;     /* size of the next chunk */
+    void  *free[RT_ARENA_CLASSES];
+};
 
-static INLINE
-void
-radix_trie_set_tag(nod *node, int offset)
+static
+struct radix_trie_chunk*
+radix_trie_chunk_new(struct radix_trie_arena *a, size_t size)
 {
+    struct radix_trie_chunk *c;
+    size_t align = size >= RT_ARENA_CHUNK_MAX ? RT_ARENA_CHUNK_MAX : RT_CACHE_LINE;
 
-    node->tag |= (1<<offset);
+#if defined(_MSC_VER)
+    c = (struct radix_trie_chunk*)_aligned_malloc(size, align);
+#else
+    if (posix_memalign((void**)&c, align, size))
+        c = 0;
+#endif
+    if (!c)
+        return 0;
+#if defined(MADV_HUGEPAGE)
+    if (size >= RT_ARENA_CHUNK_MAX)
+        madvise(c, size, MADV_HUGEPAGE);
+#endif
 
-}
+    c->next = a->chunks;
+    a->chunks = c;
 
-static INLINE
-int
-radix_trie_get_tag(nod *n, int offset)
-{
-    return (n->tag & (1<<offset));
+    return c;
 }
 
-
-static INLINE
-void
-radix_trie_clear_tag(nod *node, int offset)
+static
+void*
+radix_trie_arena_alloc(struct radix_trie_arena *a, size_t size)
 {
+    int cls;
+    void *p;
 
-    node->tag &= (~(1<<offset));
+    size = (size + RT_ARENA_GRAIN - 1) & ~(size_t)(RT_ARENA_GRAIN - 1);
+    cls = (int)(size / RT_ARENA_GRAIN) - 1;
 
-}
+    if (cls >= RT_ARENA_CLASSES)
+    {
+        struct radix_trie_chunk *c = radix_trie_chunk_new(a, RT_CHUNK_HEAD + size);
+        return c ? (char*)c + RT_CHUNK_HEAD : 0;
+    }
 
-static INLINE
-void
-radix_trie_clear_tag1(nod *node, int offset)
-{
+    if (a->free[cls])
+    {
+        p = a->free[cls];
+        a->free[cls] = *(void**)p;
+        return p;
+    }
 
-    node->tag1 &= (~(1<<offset));
+    if ((size_t)(a->end - a->top) < size)
+    {
+        struct radix_trie_chunk *c = radix_trie_chunk_new(a, a->next);
+
+        if (!c)
+            return 0;
+        a->top = (char*)c + RT_CHUNK_HEAD;
+        a->end = (char*)c + a->next;
+        if (a->next < RT_ARENA_CHUNK_MAX)
+            a->next *= 2;
+    }
 
+    p = a->top;
+    a->top += size;
+    return p;
 }
 
-static INLINE
+static
 void
-radix_trie_set_tag1(nod *node, int offset)
+radix_trie_arena_free(struct radix_trie_arena *a, void *p, size_t size)
 {
+    int cls;
 
-    node->tag1 |= (1<<offset);
+    size = (size + RT_ARENA_GRAIN - 1) & ~(size_t)(RT_ARENA_GRAIN - 1);
+    cls = (int)(size / RT_ARENA_GRAIN) - 1;
+
+    if (cls >= RT_ARENA_CLASSES)
+        return;
 
+    *(void**)p = a->free[cls];
+    a->free[cls] = p;
 }
 
-static INLINE
-int
-radix_trie_get_tag1(nod *n, int offset)
+struct radix_trie_arena*
+radix_trie_arena_new(void)
 {
-    return (n->tag1 & (1<<offset));
+    struct radix_trie_arena *a = (struct radix_trie_arena*)calloc(1, sizeof(struct radix_trie_arena));
+
+    if (a)
+        a->next = RT_ARENA_CHUNK_MIN;
+    return a;
 }
 
-static INLINE
-nodetype
-radix_trie_get_nodetype(nod *n, int offset)
+/* the chunks and free blocks of b go to a, b is freed */
+void
+radix_trie_arena_adopt(struct radix_trie_arena *a, struct radix_trie_arena *b)
 {
-    int a, b;
-
-    a = radix_trie_get_tag(n, offset);
-    b = radix_trie_get_tag1(n, offset);
+    struct radix_trie_chunk *c, *next;
+    int cls;
 
-    if (a == 0 && b == 0)
-    {
-        return n_empty;
-    }
-    else if (a != 0 && b == 0)
+    for (c = b->chunks; c; c = next)
     {
-        return n_external;
+        next = c->next;
+        c->next = a->chunks;
+        a->chunks = c;
     }
-    else if (a == 0 && b != 0)
+    for (cls = 0; cls < RT_ARENA_CLASSES; cls++)
     {
-        return n_internal;
+        void *p, *q;
+
+        for (p = b->free[cls]; p; p = q)
+        {
+            q = *(void**)p;
+            *(void**)p = a->free[cls];
+            a->free[cls] = p;
+        }
     }
-    else /* a != 0 && b != 0*/
+    free(b);
+}
+
+/* every chunk at once */
+static
+void
+radix_trie_arena_drop(struct radix_trie_arena *a)
+{
+    struct radix_trie_chunk *c, *next;
+
+    for (c = a->chunks; c; c = next)
     {
-        return n_composite;
+        next = c->next;
+#if defined(_MSC_VER)
+        _aligned_free(c);
+#else
+        free(c);
+#endif
     }
-    return n_empty;
+    free(a);
 }
 
-static INLINE
-void
-radix_trie_set_nodetype(nod *n, nodetype nt, int offset)
+
+void*
+radix_trie_mem_alloc(struct radix_trie_ctx *ctx, size_t size)
 {
+    if (ctx->arena)
+        return radix_trie_arena_alloc(ctx->arena, size);
+    return malloc(size);
+}
 
-    if (!n)
+/* size is the one given to radix_trie_mem_alloc */
+void
+radix_trie_mem_free(struct radix_trie_ctx *ctx, void *p, size_t size)
+{
+    if (!p)
         return;
+    if (ctx->arena)
+        radix_trie_arena_free(ctx->arena, p, size);
+    else
+        free(p);
+}
 
-    radix_trie_clear_tag(n, offset);
-    radix_trie_clear_tag1(n, offset);
 
-    switch (nt)
-    {
-        case n_internal:
-            radix_trie_set_tag1(n, offset);
-            break;
+static INLINE
+size_t
+radix_trie_node_size(struct radix_trie_ctx *ctx, int kind, int cap)
+{
+    /* the index has a byte per slot of the order of the trie */
+    if (kind == RT_INDEXED)
+        return NODE_SIZE(cap) + (1 << ctx->order);
+    return NODE_SIZE(cap);
+}
 
-        case n_external:
-            radix_trie_set_tag(n, offset);
-            break;
+/*
+ * shared tries, RADIX_TRIE_SHARED: one writer, readers without locks.
+ *
+ * A node readers may see is never changed, the writer changes a copy
+ * and publishes it with a release store in place of the old one, see
+ * radix_trie_slot_add. The old node is retired, with the epoch it was
+ * retired in. A reader announces the epoch it starts reading in, and
+ * frees the slot when done. When the writer moves to the next epoch,
+ * a node retired before the epoch of every reader reading can no
+ * longer be reached, and is freed.
+ *
+ * With RADIX_TRIE_CONCURRENT each writer is a reader as well, and keeps
+ * the nodes it retires on its reader, see radix_trie_insert_olc.
+ */
+#define RT_RECLAIM_MIN 64    /* retired nodes before the writer reclaims */
+#define RT_RECLAIM_WAIT 4096 /* yields a writer out of memory waits for readers */
 
-        case n_composite:
-            radix_trie_set_tag(n, offset);
-            radix_trie_set_tag1(n, offset);
-            break;
+struct radix_trie_retired
+{
+    nod *n;
+    unsigned long epoch;
+};
 
-        default:
-            break;
-    }
-}
+/* retired nodes, not yet freed */
+struct radix_trie_limbo
+{
+    struct radix_trie_retired *retired;
+    size_t count, size;
+    size_t next;                      /* count to reclaim at */
+};
 
+struct radix_trie_reader
+{
+    unsigned long epoch;              /* the epoch it reads in, 0 when not reading */
+    int dead;                         /* radix_trie_reader_free() was called */
+    struct radix_trie_shared *shared;
+    struct radix_trie_reader *next;
+    struct radix_trie_limbo limbo;    /* RADIX_TRIE_CONCURRENT, what it retired as a writer */
+    char pad[64];                     /* one cache line per reader */
+};
 
-static
-int
-radix_trie_find_prefix(uint32_t k0, uint32_t k1)
+struct radix_trie_shared
 {
-    uint32_t x = k0 ^ k1;
-    uint32_t msk = ~(~0UL >> 1);
+    unsigned long epoch;              /* moved on by the writers only */
+    struct radix_trie_reader *readers;
+    struct radix_trie_limbo limbo;
+};
 
-    int i = 0;
+/* the reader reading on this thread, between read_begin and read_end */
+static RT_THREAD struct radix_trie_reader *radix_trie_self;
 
-    if (x == 0)
-        return KEYSIZE_MAX;
-    while ( (x & msk) == 0)
-    {
-        i++;
-        msk >>= 1;
+/* where the nodes retired by this thread go */
+static
+struct radix_trie_limbo*
+radix_trie_limbo(struct radix_trie_ctx *ctx)
+{
+    struct radix_trie_reader *rd = radix_trie_self;
 
-    }
-    return i;
+    if ((ctx->flags & RADIX_TRIE_CONCURRENT) && rd && rd->shared == ctx->shared)
+        return &rd->limbo;
+    return &ctx->shared->limbo;
 }
 
+/*
+ * a writer of a RADIX_TRIE_CONCURRENT trie outside a read section of
+ * its own reader on the trie, with nowhere to retire nodes to: the
+ * limbo of the trie is the single writer's of a shared trie, and
+ * takes no lock. Its writes are refused.
+ */
+static
+int
+radix_trie_stray_writer(struct radix_trie_ctx *ctx)
+{
+    struct radix_trie_reader *rd = radix_trie_self;
 
+    if (!(ctx->flags & RADIX_TRIE_CONCURRENT) || (rd && rd->shared == ctx->shared))
+        return 0;
+    WARNING("%s\n", "a concurrent writer writes between read_begin and read_end of its reader");
+    return 1;
+}
 
+/*
+ * n can't be kept in limbo, no memory for it: the writer moves to the
+ * next epoch and waits for the readers reading in an earlier one to be
+ * done, all but itself, then frees n. A reader that stays (another
+ * writer waiting likewise) leaves n unfreed rather than freed under it.
+ */
 static
-nod*
-radix_trie_new(uint32_t key, int len, int prefix, void *value, int external)
+void
+radix_trie_retire_now(struct radix_trie_ctx *ctx, nod *n)
 {
-    nod *n;
-    int i;
-    uint32_t _key;
-    int crit_bit;
-    int first_order;
+    struct radix_trie_shared *sh = ctx->shared;
+    struct radix_trie_reader *rd;
+    unsigned long e = RT_LOAD(&sh->epoch), r;
+    int  tries;
 
-    if (len < KEYSIZE_MAX)
-    {
-        _key = key << (KEYSIZE_MAX - len);
-    }
-    else
+    while (!RT_CAS(&sh->epoch, &e, e + 1))
+        ;
+    RT_FENCE();
+
+    for (tries = 0; tries < RT_RECLAIM_WAIT; tries++)
     {
-        _key = key;
+        for (rd = RT_LOAD(&sh->readers); rd; rd = rd->next)
+        {
+            r = RT_LOAD(&rd->epoch);
+            if (rd != radix_trie_self && r && r <= e)
+                break;
+        }
+        if (!rd)
+        {
+            radix_trie_mem_free(ctx, n, radix_trie_node_size(ctx, n->kind, n->cap));
+            return;
+        }
+        RT_YIELD();
     }
+    WARNING("%s\n", "out of memory, a retired node is left");
+}
 
+static
+void
+radix_trie_retire(struct radix_trie_ctx *ctx, nod *n)
+{
+    struct radix_trie_limbo *l = radix_trie_limbo(ctx);
 
-    n = (nod*)malloc(sizeof(nod));
-    memset(n, 0, sizeof(nod));
-    n->key = key;
-    n->value = value;
-
-    if (external)
-    {
-        crit_bit = prefix - RADIX_ORDER;
-    }
-    else
-    {
-        crit_bit = KEYSIZE_MAX - prefix;
-        crit_bit = (crit_bit + RADIX_ORDER - 1) / RADIX_ORDER * RADIX_ORDER;
-        crit_bit = KEYSIZE_MAX - crit_bit;
-    }
+    /* the root made by radix_trie_create() goes with the trie */
+    if (n->flags & RT_HEAD)
+        return;
 
-    first_order = KEYSIZE_MAX % RADIX_ORDER;
-    if (prefix < first_order)
-    {
-        n->crit_bit = 0;
-    }
-    else
-    {
-        n->crit_bit = crit_bit;
-    }
+    /* no writer changes it any more */
+    if (ctx->flags & RADIX_TRIE_CONCURRENT)
+        RT_STORE(&n->word, RT_LOCKED | RT_OBSOLETE);
 
-    if (n->crit_bit == 0)
+    if (l->count == l->size)
     {
-        n->order = KEYSIZE_MAX % RADIX_ORDER;
-        if (n->order == 0)
-            n->order = RADIX_ORDER;
+        size_t size = l->size ? 2 * l->size : 256;
+        struct radix_trie_retired *p = (struct radix_trie_retired*)realloc(l->retired, size * sizeof(*p));
 
-        if (n->order < prefix)
+        if (!p)
         {
-            // must ajust crit_bit
-            n->crit_bit = crit_bit;
-            n->order = RADIX_ORDER;
-
+            radix_trie_retire_now(ctx, n);
+            return;
         }
+        l->retired = p;
+        l->size = size;
     }
-    else
-    {
-        n->order = RADIX_ORDER;
-    }
+    l->retired[l->count].n = n;
+
+    /* the epoch is read after n is taken out, as other writers see it */
+    if (ctx->flags & RADIX_TRIE_CONCURRENT)
+        RT_FENCE();
+    l->retired[l->count].epoch = RT_LOAD(&ctx->shared->epoch);
+    l->count++;
+}
+
+/* free the retired nodes no reader can reach any more */
+static
+void
+radix_trie_reclaim(struct radix_trie_ctx *ctx)
+{
+    struct radix_trie_shared *sh = ctx->shared;
+    struct radix_trie_limbo *l = radix_trie_limbo(ctx);
+    struct radix_trie_reader *rd;
+    unsigned long e, oldest = ~0UL;
+    size_t i, j;
+
+    if (l->count < RT_RECLAIM_MIN || l->count < l->next)
+        return;
 
-    i = radix_trie_find_slot(_key, n->order, n->crit_bit);
+    /* readers from now on start after what is retired */
+    e = RT_LOAD(&sh->epoch);
+    while (!RT_CAS(&sh->epoch, &e, e + 1))
+        ;
+    RT_FENCE();
 
-    if (external)
+    for (rd = RT_LOAD(&sh->readers); rd; rd = rd->next)
     {
-        radix_trie_set_nodetype(n, n_external, i);
+        e = RT_LOAD(&rd->epoch);
+        if (e && e < oldest)
+            oldest = e;
     }
-    n->fan[i] = value;
 
+    for (i = 0; i < l->count && l->retired[i].epoch < oldest; i++)
+    {
+        nod *n = l->retired[i].n;
 
-    return n;
+        radix_trie_mem_free(ctx, n, radix_trie_node_size(ctx, n->kind, n->cap));
+    }
+    for (j = 0; i < l->count; i++, j++)
+        l->retired[j] = l->retired[i];
+    l->count = j;
+
+    /* a reader holding on to its epoch doesn't make every write scan them */
+    l->next = 2 * j;
 }
 
-nod*
-radix_trie_insert(nod *r, uint32_t key, int length, void *value)
+static
+void
+radix_trie_limbo_free(struct radix_trie_ctx *ctx, struct radix_trie_limbo *l)
 {
-    int  match = 0;
-    int  len = length;
-    nod *_r = r;
-    nod *last_r;
-    int  i, prefix;
-    uint32_t _key;
+    size_t i;
 
-    if (length < KEYSIZE_MAX)
+    for (i = 0; i < l->count; i++)
     {
-        _key = key << (KEYSIZE_MAX - length);
-    }
-    else
-    {
-        _key = key;
-    }
+        nod *n = l->retired[i].n;
 
-    if (!r)
-    {
-        /* length of key is crit_bit */
-        r = radix_trie_new(_key, len, length, value, 1);
-        return r;
+        radix_trie_mem_free(ctx, n, radix_trie_node_size(ctx, n->kind, n->cap));
     }
+    free(l->retired);
+}
 
-    last_r = r;
+/*
+ * radix_trie_reader_new:
+ *  a reader of a shared trie, one for each thread reading it
+ */
+radix_trie_reader*
+radix_trie_reader_new(nod *root)
+{
+    struct radix_trie_ctx *ctx = radix_trie_ctx(root);
+    struct radix_trie_reader *rd;
 
-    /* trace prefix, at BIT_CHUNK a time */
+    if (!ctx->shared)
+        return 0;
 
-    while (len)
-    {
-        int crit_bit = r->crit_bit;
+    rd = (struct radix_trie_reader*)calloc(1, sizeof(struct radix_trie_reader));
+    rd->shared = ctx->shared;
+    rd->next = RT_LOAD(&ctx->shared->readers);
+    while (!RT_CAS(&ctx->shared->readers, &rd->next, rd))
+        ;
+    return rd;
+}
 
-        prefix = radix_trie_find_prefix(_key, r->key);
+/* the reader is done, it is freed with the trie */
+void
+radix_trie_reader_free(radix_trie_reader *rd)
+{
+    if (!rd)
+        return;
+    radix_trie_read_end(rd);
+    rd->dead = 1;
+}
 
-        if (prefix >= r->crit_bit)
-        {
-            // iterate down
-            int i = radix_trie_find_slot(_key, r->order, r->crit_bit);
-            nodetype nt = radix_trie_get_nodetype(r, i);
-            if (nt == n_empty || nt == n_external)
-            {
-                match = r->crit_bit;
-                break;
-            }
-            else if (nt == n_composite)
-            {
-                if (length == r->crit_bit + r->order)
-                {
-                    match = r->crit_bit;
-                    break;
-                }
-                else
-                {
-                    last_r = r;
-                    r = r->fan[i];
-                }
-            }
-            else
-            {
-                last_r = r;
-                r = r->fan[i];
-            }
-        }
-        else
-        {
-            match = KEYSIZE_MAX - prefix;
-            match = (match + RADIX_ORDER - 1) / RADIX_ORDER * RADIX_ORDER;
-            match = KEYSIZE_MAX - match;
+/*
+ * radix_trie_read_begin, radix_trie_read_end:
+ *  around the lookups of a reader, the nodes it reaches stay in place
+ *  till it is done. A plain store and a fence, no lock is taken.
+ */
+void
+radix_trie_read_begin(radix_trie_reader *rd)
+{
+    RT_STORE(&rd->epoch, RT_LOAD(&rd->shared->epoch));
+    RT_FENCE();
+    radix_trie_self = rd;
+}
+
+void
+radix_trie_read_end(radix_trie_reader *rd)
+{
+    RT_STORE(&rd->epoch, 0);
+    if (radix_trie_self == rd)
+        radix_trie_self = 0;
+}
 
-            if (match <= 0)
-                match = 0;
+/* the shared state goes, with every node retired */
+static
+void
+radix_trie_shared_free(struct radix_trie_ctx *ctx)
+{
+    struct radix_trie_shared *sh = ctx->shared;
+    struct radix_trie_reader *rd;
 
-            break;
-        }
+    radix_trie_limbo_free(ctx, &sh->limbo);
+    while ((rd = sh->readers))
+    {
+        sh->readers = rd->next;
+        radix_trie_limbo_free(ctx, &rd->limbo);
+        free(rd);
     }
+    free(sh);
+    ctx->shared = 0;
+}
 
 
-    if (match == r->crit_bit)
-    {
+/*
+ * concurrent writers, RADIX_TRIE_CONCURRENT: optimistic lock coupling
+ * on top of the copies of a shared trie. A writer goes down without a
+ * lock, noting the version of the nodes it passes, then locks the
+ * nodes it changes, and the one holding the first of them, provided
+ * their versions are still those it saw, or else starts over. A node
+ * is only changed in place for a slot pointer or a value, and gets a
+ * new version when unlocked, a retired node stays locked for good.
+ * Nodes stay in memory while a writer reads, so nothing it saw needs
+ * checking on the way down.
+ */
 
-        int i = radix_trie_find_slot(_key, r->order, r->crit_bit);
-        nodetype nt = radix_trie_get_nodetype(r, i);
+/* the version of a lock word, -1 when it is locked */
+static INLINE
+int64_t
+radix_trie_version(word_t *w)
+{
+    word_t v = RT_LOAD(w);
 
+    return v & RT_LOCKED ? -1 : (int64_t)v;
+}
+
+/* lock w if it is still at version v */
+static INLINE
+int
+radix_trie_lock(word_t *w, int64_t v)
+{
+    word_t x = (word_t)v;
+
+    return v >= 0 && RT_CAS(w, &x, (word_t)(v | RT_LOCKED));
+}
+
+/*
+ * a writer starting over, the holder of the lock it wanted may have
+ * been put off the cpu, after a few tries it lets it run
+ */
+static
+void
+radix_trie_backoff(int *tries)
+{
+    if (++*tries % 8 == 0)
+        RT_YIELD();
+}
+
+static INLINE
+void
+radix_trie_unlock(word_t *w)
+{
+    word_t v = RT_LOAD(w);
+
+    if (!(v & RT_OBSOLETE))
+        RT_STORE(w, (word_t)((v & ~RT_LOCKED) + RT_VERSION_STEP));
+}
+
+
+nod*
+radix_trie_alloc(struct radix_trie_ctx *ctx, int kind, int cap)
+{
+    nod *n;
+    size_t size;
+
+    /* a full node has the slots of the order of the trie */
+    if (kind == RT_FULL)
+        cap = 1 << ctx->order;
+
+    size = radix_trie_node_size(ctx, kind, cap);
+
+    if (ctx->build && ctx->build->spare)
+    {
+        n = ctx->build->spare;
+        ctx->build->spare = n->fan[0];
+    }
+    else
+    {
+        n = (nod*)radix_trie_mem_alloc(ctx, size);
+    }
+    memset(n, 0, size);
+    n->kind = kind;
+    n->cap = cap;
+    if (ctx->build)
+        n->flags = RT_SCRATCH;
+
+    return n;
+}
+
+void
+radix_trie_free_node(struct radix_trie_ctx *ctx, nod *n)
+{
+    if (ctx->shared)
+    {
+        radix_trie_retire(ctx, n);
+    }
+    else if (ctx->build && (n->flags & RT_SCRATCH))
+    {
+        n->fan[0] = ctx->build->spare;
+        ctx->build->spare = n;
+    }
+    else if (n->flags & RT_HEAD)
+    {
+        if (ctx->arena)
+            radix_trie_arena_drop(ctx->arena);
+        free((char*)n - CTX_SIZE);
+    }
+    else
+    {
+        radix_trie_mem_free(ctx, n, radix_trie_node_size(ctx, n->kind, n->cap));
+    }
+}
+
+
+/*
+ * radix_trie_new:
+ *  a node spanning bits [crit_bit, crit_bit + order) of key, with room
+ *  for "count" slots.
+ */
+nod*
+radix_trie_new(struct radix_trie_ctx *ctx, uint64_t key, int crit_bit, int order, int count)
+{
+    nod *n;
+    int kind = RT_COMPACT;
+    int cap;
+
+    /* no key of a bulk load goes through it after this one */
+    if (ctx->build && crit_bit > ctx->build->bound)
+        ctx = ctx->build->ctx;
+
+    cap = radix_trie_fit(ctx, count, &kind);
+    n = radix_trie_alloc(ctx, kind, cap);
+    n->key = key & radix_trie_prefix_mask(crit_bit + order);
+    n->crit_bit = crit_bit;
+    n->order = order;
+
+    return n;
+}
+
+
+/* the entries of n into x, laid out as x is */
+static
+void
+radix_trie_fill(nod *x, nod *n)
+{
+    int  i, k = 0;
+
+    x->key = n->key;
+    x->tag = n->tag;
+    x->tag1 = n->tag1;
+    x->crit_bit = n->crit_bit;
+    x->order = n->order;
+    x->flags = n->flags & ~RT_HEAD;
+    x->value = n->value;
+
+    for (i = 0; i < (1 << n->order); i++)
+    {
+        if (radix_trie_get_nodetype(n, i) == n_empty)
+            continue;
+
+        if (x->kind == RT_FULL)
+        {
+            x->fan[i] = *radix_trie_slot(n, i);
+        }
+        else
+        {
+            if (x->kind == RT_INDEXED)
+                RT_INDEX(x)[i] = k;
+            x->fan[k++] = *radix_trie_slot(n, i);
+        }
+    }
+}
+
+/* a copy of node n, in a new layout */
+static
+nod*
+radix_trie_copy(struct radix_trie_ctx *ctx, nod *n, int kind, int cap)
+{
+    nod *x = radix_trie_alloc(ctx, kind, cap);
+
+    radix_trie_fill(x, n);
+    return x;
+}
+
+/*
+ * radix_trie_resize:
+ *  move node to a new layout, the old node is freed
+ */
+nod*
+radix_trie_resize(struct radix_trie_ctx *ctx, nod *n, int kind, int cap)
+{
+    nod *x = radix_trie_copy(ctx, n, kind, cap);
+
+    radix_trie_free_node(ctx, n);
+    return x;
+}
+
+
+/*
+ * radix_trie_slot_add:
+ *  fill an empty slot, the node may be moved, in which case *ref is
+ *  updated. A NULL ref pins the node where it is, it must have room.
+ *  Readers of a shared trie never see a node change, the slot is added
+ *  to a copy, which takes its place once it is complete.
+ */
+void
+radix_trie_slot_add(struct radix_trie_ctx *ctx, nod **ref, nod *n, int offset, nodetype nt, void *p)
+{
+    int count = radix_trie_count(n);
+    nod *x = n;
+    nod **s;
+
+    if (ref && n->kind != RT_FULL && count == n->cap)
+    {
+        int kind = n->kind;
+        int cap;
+
+        /* a bulk load grows the nodes it made final in their own layout */
+        if (ctx->build && !(n->flags & RT_SCRATCH))
+            ctx = ctx->build->ctx;
+
+        cap = radix_trie_fit(ctx, count + 1, &kind);
+        x = radix_trie_copy(ctx, n, kind, cap);
+    }
+    else if (ref && ctx->shared)
+    {
+        x = radix_trie_copy(ctx, n, n->kind, n->cap);
+    }
+
+    switch (x->kind)
+    {
+        case RT_COMPACT:
+            s = radix_trie_slot(x, offset);
+            memmove(s + 1, s, (count - (s - x->fan)) * sizeof(nod*));
+            break;
+
+        case RT_INDEXED:
+            // take the first free entry
+            RT_INDEX(x)[offset] = count;
+            break;
+
+        default:
+            break;
+    }
+
+    radix_trie_set_nodetype(x, nt, offset);
+    *radix_trie_slot(x, offset) = p;
+
+    if (x != n)
+    {
+        RT_STORE(ref, x);
+        radix_trie_free_node(ctx, n);
+    }
+}
+
+/*
+ * radix_trie_slot_set:
+ *  change the type of a slot in use, and what it holds
+ */
+void
+radix_trie_slot_set(struct radix_trie_ctx *ctx, nod **ref, nod *n, int offset, nodetype nt, void *p)
+{
+    nod *x = n;
+
+    if (ref && ctx->shared)
+        x = radix_trie_copy(ctx, n, n->kind, n->cap);
+
+    radix_trie_set_nodetype(x, nt, offset);
+    *radix_trie_slot(x, offset) = p;
+
+    if (x != n)
+    {
+        RT_STORE(ref, x);
+        radix_trie_free_node(ctx, n);
+    }
+}
+
+/*
+ * radix_trie_slot_remove:
+ *  empty a slot, the node may shrink
+ */
+void
+radix_trie_slot_remove(struct radix_trie_ctx *ctx, nod **ref, nod *n, int offset)
+{
+    nod **s;
+    int  count = radix_trie_count(n);
+    int  kind = n->kind;
+    int  cap, i;
+    nod *x = n;
+
+    if (ref && ctx->shared)
+        x = radix_trie_copy(ctx, n, n->kind, n->cap);
+
+    s = radix_trie_slot(x, offset);
+    switch (x->kind)
+    {
+        case RT_FULL:
+            *s = 0;
+            break;
+
+        case RT_COMPACT:
+            memmove(s, s + 1, (count - 1 - (s - x->fan)) * sizeof(nod*));
+            break;
+
+        case RT_INDEXED:
+            // move the last entry into the hole, entries stay packed
+            for (i = 0; i < (1 << x->order); i++)
+            {
+                if (radix_trie_get_nodetype(x, i) != n_empty &&
+                    RT_INDEX(x)[i] == count - 1)
+                {
+                    *s = x->fan[count - 1];
+                    RT_INDEX(x)[i] = RT_INDEX(x)[offset];
+                    break;
+                }
+            }
+            break;
+    }
+
+    radix_trie_set_nodetype(x, n_empty, offset);
+
+    if (ref && !(x->flags & RT_HEAD))
+    {
+        cap = radix_trie_shrink(ctx, x, count - 1, &kind);
+        if (cap)
+        {
+            nod *y = radix_trie_copy(ctx, x, kind, cap);
+
+            /* a copy no reader has seen goes at once */
+            if (x != n)
+                radix_trie_mem_free(ctx, x, radix_trie_node_size(ctx, x->kind, x->cap));
+            x = y;
+        }
+    }
+
+    if (x != n)
+    {
+        RT_STORE(ref, x);
+        radix_trie_free_node(ctx, n);
+    }
+}
+
+
+/*
+ * radix_trie_unshare:
+ *  n is held by a snapshot as well, n->share counts the holders besides
+ *  the first. The trie takes a copy of its own in place of n, which
+ *  is left to the snapshots, and the nodes below get a holder more. A
+ *  change goes down the trie this way, so it copies the nodes on its
+ *  path that snapshots hold, and nothing else.
+ */
+static
+nod*
+radix_trie_unshare(struct radix_trie_ctx *ctx, nod **ref, nod *n)
+{
+    nod *x = radix_trie_copy(ctx, n, n->kind, n->cap);
+    int  i;
+
+    for (i = 0; i < (1 << x->order); i++)
+    {
+        if (radix_trie_get_tag1(x, i))
+            (*radix_trie_slot(x, i))->share++;
+    }
+    n->share--;
+    RT_STORE(ref, x);
+    return x;
+}
+
+/*
+ * radix_trie_leaf:
+ *  a new node holding nothing but the key, it ends at the last bit of
+ *  the key, and starts no earlier than "parent", the first bit not
+ *  covered by the node above it.
+ */
+static
+nod*
+radix_trie_leaf(struct radix_trie_ctx *ctx, uint64_t key, int len, int parent, void *value)
+{
+    nod *n;
+    int crit_bit = len - ctx->order;
+
+    if (crit_bit < parent)
+        crit_bit = parent;
+
+    n = radix_trie_new(ctx, key, crit_bit, len - crit_bit, 1);
+    radix_trie_slot_add(ctx, 0, n, radix_trie_find_slot(key, n->order, crit_bit), n_external, value);
+
+    return n;
+}
+
+
+/*
+ * radix_trie_split:
+ *  key (of "length" bits) leaves the path of node n at bit "prefix",
+ *  before n->crit_bit. A new node is made to hold both n and the key.
+ *  When prefix == length the key ends above n, and it sits in the same
+ *  slot as n, as a composite.
+ */
+static
+nod*
+radix_trie_split(struct radix_trie_ctx *ctx, nod *n, uint64_t key, int length, int prefix, int parent, void *value)
+{
+    nod *n_nod;
+    int  crit_bit, end, i, slot_old;
+
+    if (prefix >= length)
+    {
+        crit_bit = length - ctx->order;
+        end = length;
+    }
+    else
+    {
+        crit_bit = radix_trie_align(prefix, length, ctx->order);
+        end = crit_bit + ctx->order;
+        if (end > n->crit_bit)
+            end = n->crit_bit;
+        if (end > length)
+            end = length;
+    }
+    if (crit_bit < parent)
+        crit_bit = parent;
+
+    n_nod = radix_trie_new(ctx, key, crit_bit, end - crit_bit, 2);
+
+    /* n_nod takes over the place of n, so as the composite value */
+    n_nod->value = n->value;
+
+    slot_old = radix_trie_find_slot(n->key, n_nod->order, crit_bit);
+    i = radix_trie_find_slot(key, n_nod->order, crit_bit);
+
+    if (prefix >= length)
+    {
+        /* readers may still take the value n had */
+        if (ctx->shared)
+        {
+            nod *x = radix_trie_copy(ctx, n, n->kind, n->cap);
+
+            radix_trie_free_node(ctx, n);
+            n = x;
+        }
+        n->value = value;
+        radix_trie_slot_add(ctx, 0, n_nod, slot_old, n_composite, n);
+    }
+    else
+    {
+        radix_trie_slot_add(ctx, 0, n_nod, slot_old, n_internal, n);
+
+        if (length == end)
+        {
+            radix_trie_slot_add(ctx, 0, n_nod, i, n_external, value);
+        }
+        else
+        {
+            nod *n_child = radix_trie_leaf(ctx, key, length, end, value);
+            radix_trie_slot_add(ctx, 0, n_nod, i, n_internal, n_child);
+        }
+    }
+
+    return n_nod;
+}
+
+
+/*
+ * radix_trie_split_order:
+ *  a key ends inside the span of node *ref, at bit "length". The node
+ *  is cut in two levels, [crit_bit, length) and [length, crit_bit + order),
+ *  so the key can be kept in a slot of the upper one.
+ */
+nod*
+radix_trie_split_order(struct radix_trie_ctx *ctx, nod **ref, int length)
+{
+    nod *n = *ref;
+    nod *sub[MAP_SIZE];
+    int  hi = length - n->crit_bit;
+    int  lo = n->order - hi;
+    int  h, j, count = 0;
+    int  bound = 0;
+
+    /* the parts keep the scratch nodes of a bulk load, they are scratch too */
+    if (ctx->build)
+    {
+        bound = ctx->build->bound;
+        ctx->build->bound = KEYSIZE_MAX;
+    }
+
+    for (h = 0; h < (1 << hi); h++)
+    {
+        uint64_t k;
+        int c = 0;
+
+        sub[h] = 0;
+        for (j = 0; j < (1 << lo); j++)
+        {
+            if (radix_trie_get_nodetype(n, (h << lo) + j) != n_empty)
+                c++;
+        }
+        if (!c)
+            continue;
+
+        if (n->flags & RT_SKEY)
+            k = 0;  /* nothing is skipped above the lower level */
+        else
+            k = (n->key & radix_trie_prefix_mask(n->crit_bit)) |
+                ((uint64_t)h << (KEYSIZE_MAX - length));
+        sub[h] = radix_trie_new(ctx, k, length, lo, c);
+        sub[h]->flags |= n->flags & RT_SKEY;
+        for (j = 0; j < (1 << lo); j++)
+        {
+            nodetype nt = radix_trie_get_nodetype(n, (h << lo) + j);
+            if (nt != n_empty)
+                radix_trie_slot_add(ctx, 0, sub[h], j, nt, *radix_trie_slot(n, (h << lo) + j));
+        }
+        count++;
+    }
+
+    if (ctx->build)
+        ctx->build->bound = bound;
+
+    if ((n->flags & RT_HEAD) && !ctx->shared)
+    {
+        /* the root made by radix_trie_create() stays where it is */
+        memset(n->fan, 0, n->cap * sizeof(nod*));
+        n->tag = n->tag1 = 0;
+        n->order = hi;
+        if (!(n->flags & RT_SKEY))
+            n->key &= radix_trie_prefix_mask(length);
+    }
+    else
+    {
+        nod *top = radix_trie_new(ctx, n->key, n->crit_bit, hi, count);
+        top->value = n->value;
+        if (n->flags & RT_SKEY)
+        {
+            /* the upper level keeps the path segment */
+            top->key = n->key;
+            top->flags |= RT_SKEY;
+        }
+        for (h = 0; h < (1 << hi); h++)
+        {
+            if (sub[h])
+                radix_trie_slot_add(ctx, 0, top, h, n_internal, sub[h]);
+        }
+        RT_STORE(ref, top);
+        radix_trie_free_node(ctx, n);
+        return top;
+    }
+
+    for (h = 0; h < (1 << hi); h++)
+    {
+        if (sub[h])
+            radix_trie_slot_add(ctx, 0, n, h, n_internal, sub[h]);
+    }
+
+    return n;
+}
+
+
+/*
+ * radix_trie_create:
+ *  an empty trie, with the node layout given by flags, see
+ *  RADIX_TRIE_AUTO, RADIX_TRIE_FULL and RADIX_TRIE_COMPACT, and
+ *  RADIX_TRIE_ARENA for the node allocator, RADIX_TRIE_ORDER() for
+ *  the slots of a node. NULL for an order beyond RADIX_ORDER_MAX.
+ *  The returned root is never moved by insert or delete.
+ */
+nod*
+radix_trie_create(int flags)
+{
+    struct radix_trie_ctx *ctx;
+    int  order = (flags / RADIX_TRIE_ORDER(1)) & 7;
+    nod *n;
+
+    if (order > RADIX_ORDER_MAX)
+    {
+        WARNING("order %d is beyond RADIX_ORDER_MAX\n", order);
+        return 0;
+    }
+    if ((flags & RADIX_TRIE_SET) && (flags & (RADIX_TRIE_SHARED | RADIX_TRIE_CONCURRENT)))
+    {
+        WARNING("%s\n", "a set changes its leaves in place, it is not shared");
+        return 0;
+    }
+
+    ctx = (struct radix_trie_ctx*)malloc(CTX_SIZE + NODE_SIZE(MAP_SIZE));
+    memset(ctx, 0, CTX_SIZE + NODE_SIZE(MAP_SIZE));
+
+    /* the arena is not for threads to share */
+    flags &= RADIX_TRIE_ORDER(1) - 1;
+    if (flags & RADIX_TRIE_CONCURRENT)
+        flags = (flags | RADIX_TRIE_SHARED) & ~RADIX_TRIE_ARENA;
+    ctx->flags = flags;
+    ctx->order = order ? order : RADIX_ORDER;
+    if (flags & RADIX_TRIE_ARENA)
+        ctx->arena = radix_trie_arena_new();
+
+    n = (nod*)((char*)ctx + CTX_SIZE);
+    n->kind = RT_FULL;
+    n->cap = 1 << ctx->order;
+    n->flags = RT_HEAD;
+    n->order = KEYSIZE_MAX % ctx->order;
+    if (n->order == 0)
+        n->order = ctx->order;
+
+    if (flags & RADIX_TRIE_SHARED)
+    {
+        ctx->shared = (struct radix_trie_shared*)calloc(1, sizeof(struct radix_trie_shared));
+        ctx->shared->epoch = 1;
+        ctx->top = n;
+    }
+
+    return n;
+}
+
+
+/*
+ * radix_trie_snapshot:
+ *  a copy of the root, the nodes below are the trie's, held by both.
+ *  They count the holders they have besides the trie in n->share, and
+ *  the trie copies them before they change, see radix_trie_unshare.
+ */
+nod*
+radix_trie_snapshot(nod *root)
+{
+    struct radix_trie_ctx *ctx, *sc;
+    nod *top, *n;
+    int  i;
+
+    if (!root || !(root->flags & RT_HEAD))
+        return 0;
+
+    ctx = radix_trie_ctx(root);
+    top = radix_trie_top(root);
+    if (ctx->origin || (ctx->flags & (RADIX_TRIE_CONCURRENT | RADIX_TRIE_SET)) || (top->flags & RT_SKEY))
+    {
+        WARNING("%s\n", "no snapshot of a snapshot, a concurrent, a set or a string trie");
+        return 0;
+    }
+    if (ctx->snapshots == 0xffff)
+        return 0;
+
+    sc = (struct radix_trie_ctx*)malloc(CTX_SIZE + NODE_SIZE(MAP_SIZE));
+    memset(sc, 0, CTX_SIZE + NODE_SIZE(MAP_SIZE));
+    sc->flags = ctx->flags & (RADIX_TRIE_FULL | RADIX_TRIE_COMPACT);
+    sc->order = ctx->order;
+    sc->origin = ctx;
+
+    n = (nod*)((char*)sc + CTX_SIZE);
+    n->kind = RT_FULL;
+    n->cap = 1 << ctx->order;
+    radix_trie_fill(n, top);
+    n->flags = RT_HEAD;
+    n->share = 0;
+
+    for (i = 0; i < (1 << n->order); i++)
+    {
+        if (radix_trie_get_tag1(n, i))
+            (*radix_trie_slot(n, i))->share++;
+    }
+    ctx->snapshots++;
+
+    /* and of the ranges, tries of their own */
+    if (ctx->ranges)
+    {
+        sc->ranges = (nod**)calloc(KEYSIZE_MAX, sizeof(nod*));
+        for (i = 0; i < KEYSIZE_MAX; i++)
+            sc->ranges[i] = radix_trie_snapshot(ctx->ranges[i]);
+    }
+
+    return n;
+}
+
+
+/*
+ * radix_trie_insert_r:
+ *  insert from the node at *ref, below a node ending at bit "parent",
+ *  the key must go through *ref.
+ */
+void
+radix_trie_insert_r(struct radix_trie_ctx *ctx, nod **ref, int parent, uint64_t _key, int length, void *value)
+{
+    /* trace prefix, a node at a time */
+
+    while (*ref)
+    {
+        nod *n = *ref;
+        int  end = n->crit_bit + n->order;
+        int  prefix, i;
+        nodetype nt;
+        nod **s;
+
+        if (ctx->snapshots && n->share)
+            n = radix_trie_unshare(ctx, ref, n);
+
+        prefix = radix_trie_find_prefix(_key, n->key);
+        if (prefix > length)
+            prefix = length;
+
+        if (prefix < n->crit_bit || length == n->crit_bit)
+        {
+            // a new node is needed with shorter crit_bit
+            // with "prefix" bits of common prefix
+            RT_STORE(ref, radix_trie_split(ctx, n, _key, length, prefix, parent, value));
+            RT_COUNT(ctx, splits, 1);
+            if (prefix >= length)
+                RT_COUNT(ctx, composites, 1);
+            return;
+        }
+
+        if (length < end)
+        {
+            n = radix_trie_split_order(ctx, ref, length);
+            end = length;
+            RT_COUNT(ctx, splits, 1);
+        }
+
+        i = radix_trie_find_slot(_key, n->order, n->crit_bit);
+        nt = radix_trie_get_nodetype(n, i);
+        s = radix_trie_slot(n, i);
+
+        if (length == end)
+        {
+            switch (nt)
+            {
+                case n_empty:
+                    // simply insert value and set tag bit
+                    radix_trie_slot_add(ctx, ref, n, i, n_external, value);
+                    break;
+                case n_external:
+                    // Replace the exiting value
+                    RT_STORE(s, (nod*)value);
+                    break;
+                case n_internal:
+                    if (ctx->snapshots && (*s)->share)
+                        radix_trie_unshare(ctx, s, *s);
+                    RT_STORE(&(*s)->value, value);
+                    radix_trie_slot_set(ctx, ref, n, i, n_composite, *s);
+                    RT_COUNT(ctx, composites, 1);
+                    break;
+                case n_composite:
+                    // replace
+                    if (ctx->snapshots && (*s)->share)
+                        radix_trie_unshare(ctx, s, *s);
+                    RT_STORE(&(*s)->value, value);
+                    break;
+            }
+            return;
+        }
+
+        switch (nt)
+        {
+            case n_empty:
+                // insert new node
+                radix_trie_slot_add(ctx, ref, n, i, n_internal,
+                                    radix_trie_leaf(ctx, _key, length, end, value));
+                return;
+
+            case n_external:
+                /* The slot is already taken by an external entry, the following steps to be done */
+                /* 1. we are going to make a new internal node to fit the current entry */
+                /* 2. and assigned the "value" field in the new node with existing value */
+                /* 3. set bit in tag1 to signal the new entry are compound entry */
+                /* 4. insert the new node to the slot */
+                {
+                    nod *n_child = radix_trie_leaf(ctx, _key, length, end, value);
+
+                    n_child->value = *s;
+                    radix_trie_slot_set(ctx, ref, n, i, n_composite, n_child);
+                    RT_COUNT(ctx, composites, 1);
+                }
+                return;
+
+            default:
+                // iterate down
+                parent = end;
+                ref = s;
+                break;
+        }
+    }
+
+    /* length of key is crit_bit */
+    RT_STORE(ref, radix_trie_leaf(ctx, _key, length, parent, value));
+}
+
+/*
+ * an insert of a RADIX_TRIE_CONCURRENT writer: down to the node the key
+ * changes, as radix_trie_insert_r would go, then that node, and the
+ * one holding it, are locked, and radix_trie_insert_r does the change.
+ */
+static
+void
+radix_trie_insert_olc(struct radix_trie_ctx *ctx, uint64_t _key, int length, void *value)
+{
+    int  tries = 0;
+
+    for (;; radix_trie_backoff(&tries))
+    {
+        word_t *w = &ctx->word;
+        nod **ref = &ctx->top;
+        int  parent = 0;
+        int64_t vw = radix_trie_version(w);
+        int64_t vn;
+        nod *n = RT_LOAD(ref);
+
+        while ((vn = radix_trie_version(&n->word)) >= 0)
+        {
+            int end = n->crit_bit + n->order;
+            int prefix = radix_trie_find_prefix(_key, n->key);
+            int i = radix_trie_find_slot(_key, n->order, n->crit_bit);
+
+            if (prefix < n->crit_bit || length <= end || !radix_trie_get_tag1(n, i))
+            {
+                if (radix_trie_lock(w, vw))
+                {
+                    if (radix_trie_lock(&n->word, vn))
+                    {
+                        radix_trie_insert_r(ctx, ref, parent, _key, length, value);
+                        radix_trie_unlock(&n->word);
+                        radix_trie_unlock(w);
+                        return;
+                    }
+                    radix_trie_unlock(w);
+                }
+                break;
+            }
+
+            w = &n->word;
+            vw = vn;
+            ref = radix_trie_slot(n, i);
+            parent = end;
+            n = RT_LOAD(ref);
+        }
+    }
+}
+
+static int radix_trie_range_cut(nod *t, uint64_t lo, uint64_t hi, int len);
+
+static
+nod*
+radix_trie_insert_k(nod *r, uint64_t _key, int length, void *value)
+{
+    struct radix_trie_ctx *ctx = radix_trie_ctx(r);
+
+    if (radix_trie_readonly(r))
+    {
+        WARNING("%s\n", "a snapshot or an image does not change");
+        return r;
+    }
+    if (radix_trie_stray_writer(ctx))
+        return r;
+    RT_COUNT(ctx, inserts, 1);
+
+    /* a key takes over from the range it was in */
+    if (ctx->ranges && ctx->ranges[length - 1])
+    {
+        uint64_t k = _key >> (KEYSIZE_MAX - length);
+
+        radix_trie_range_cut(ctx->ranges[length - 1], k, k, length);
+    }
+
+    if (ctx->flags & RADIX_TRIE_CONCURRENT)
+    {
+        radix_trie_insert_olc(ctx, _key, length, value);
+        radix_trie_reclaim(ctx);
+        return r;
+    }
+
+    if (ctx->shared)
+    {
+        radix_trie_insert_r(ctx, &ctx->top, 0, _key, length, value);
+        radix_trie_reclaim(ctx);
+        return r;
+    }
+
+    radix_trie_insert_r(ctx, &r, 0, _key, length, value);
+    return r;
+}
+
+nod*
+radix_trie_insert(nod *r, uint32_t key, int length, void *value)
+{
+    if (length <= 0 || length > 32)
+    {
+        WARNING("bad key length %d\n", length);
+        return r;
+    }
+
+    RT_PROBE3(insert_entry, r, key, length);
+    r = radix_trie_insert_k(r, radix_trie_key(key, length), length, value);
+    RT_PROBE3(insert_return, r, key, length);
+    return r;
+}
+
+nod*
+radix_trie_insert64(nod *r, uint64_t key, int length, void *value)
+{
+    if (length <= 0 || length > KEYSIZE_MAX)
+    {
+        WARNING("bad key length %d\n", length);
+        return r;
+    }
+
+    RT_PROBE3(insert_entry, r, key, length);
+    r = radix_trie_insert_k(r, radix_trie_key(key, length), length, value);
+    RT_PROBE3(insert_return, r, key, length);
+    return r;
+}
+
+
+/*
+ * Bulk load.
+ *
+ * Keys given in the order of radix_trie_walk, i.e. by their bits, a
+ * key before the longer keys it is a prefix of, only ever add to the
+ * rightmost path of the trie: the path of the last key. Each key is
+ * inserted from the deepest node of that path it goes through, the
+ * nodes of the path are full scratch nodes, so adding a slot never
+ * moves them. A node left of the path never changes again, it is then
+ * moved once to the layout its final number of slots asks for. The
+ * insert itself is the one of radix_trie_insert, so the trie ends up
+ * with the shape incremental inserts give it.
+ */
+
+struct radix_trie_frame
+{
+    nod **ref;      /* where the path node is kept */
+    nod *node;      /* the path node, when it was last seen there */
+    int slot;       /* the slot the path goes through */
+    int parent;     /* end of the node above it */
+};
+
+/*
+ * radix_trie_build_final:
+ *  a scratch node and the scratch nodes below it, in slots [from, to),
+ *  take their final layout, the node itself only if these are all of
+ *  its slots. Scratch nodes are kept by the build ctx, for the next
+ *  path.
+ */
+static
+void
+radix_trie_build_final(struct radix_trie_ctx *ctx, struct radix_trie_ctx *scratch, nod **ref,
+                       int from, int to)
+{
+    nod *n = *ref;
+    tag_t t = n->tag1 & ((((tag_t)2 << (to - 1)) - 1) & ~(((tag_t)1 << from) - 1));
+    int  kind, cap;
+
+    /* only the slots holding nodes */
+    for (; t; t &= t - 1)
+    {
+        nod **s = radix_trie_slot(n, radix_trie_popcount((t & -t) - 1));
+
+        if ((*s)->flags & RT_SCRATCH)
+            radix_trie_build_final(ctx, scratch, s, 0, 1 << (*s)->order);
+    }
+
+    if (from > 0 || to < (1 << n->order) || !(n->flags & RT_SCRATCH))
+        return;
+
+    n->flags &= ~RT_SCRATCH;
+    kind = RT_FULL;
+    cap = radix_trie_fit(ctx, radix_trie_count(n), &kind);
+    if (kind != RT_FULL)
+    {
+        *ref = radix_trie_copy(ctx, n, kind, cap);
+        n->flags = RT_SCRATCH;
+        radix_trie_free_node(scratch, n);
+    }
+}
+
+static
+nod*
+radix_trie_build_k(nod *r, const uint32_t *keys, const uint64_t *keys64, const int *lens,
+                   void **values, size_t count, int width)
+{
+    struct radix_trie_ctx *ctx = radix_trie_ctx(r);
+    struct radix_trie_ctx scratch = *ctx;
+    struct radix_trie_build build;
+    struct radix_trie_frame path[KEYSIZE_MAX + 1];
+    int  depth = 0;
+    uint64_t k, last = 0;
+    int  length, last_length = 0;
+    size_t j;
+
+    if (radix_trie_readonly(r))
+    {
+        WARNING("%s\n", "a snapshot or an image does not change");
+        return r;
+    }
+    if (radix_trie_stray_writer(ctx))
+        return r;
+
+    build.ctx = ctx;
+    build.spare = 0;
+    scratch.flags = (ctx->flags & RADIX_TRIE_ARENA) | RADIX_TRIE_FULL;
+    scratch.build = &build;
+
+    /* only an empty trie is built, keys are added to others, to shared ones and to those of ranges */
+    j = 0;
+    if (!r || (radix_trie_is_empty(r) && !ctx->shared && !ctx->ranges))
+    {
+        for (; j < count; j++)
+        {
+            nod **ref = &r;
+            int  parent = 0;
+            int  top = depth;
+
+            length = lens ? lens[j] : width;
+            if (length <= 0 || length > width)
+            {
+                WARNING("bad key length %d\n", length);
+                continue;
+            }
+            k = radix_trie_key(keys ? keys[j] : keys64[j], length);
+
+            if (k < last || (k == last && length < last_length))
+            {
+                WARNING("keys are not sorted at %lu\n", (unsigned long)j);
+                break;
+            }
+            last = k;
+            last_length = length;
+
+            /*
+             * the next key goes through the nodes of this one's path
+             * starting upto bit "bound", the others are made final
+             */
+            build.bound = -1;
+            if (j + 1 < count)
+            {
+                int next = lens ? lens[j + 1] : width;
+
+                build.bound = KEYSIZE_MAX;
+                if (next > 0 && next <= width)
+                {
+                    build.bound = radix_trie_find_prefix(k, radix_trie_key(keys ? keys[j + 1] : keys64[j + 1], next));
+                    if (build.bound > length)
+                        build.bound = length;
+                    if (build.bound > next - 1)
+                        build.bound = next - 1;
+                }
+            }
+
+            /* the deepest node of the path the key goes through */
+            while (depth > 0)
+            {
+                nod *n = *path[depth - 1].ref;
+
+                if ((n->flags & RT_HEAD) ||
+                    (length > n->crit_bit &&
+                     !((k ^ n->key) & radix_trie_prefix_mask(n->crit_bit))))
+                    break;
+                depth--;
+            }
+            if (depth > 0)
+            {
+                depth--;
+                ref = path[depth].ref;
+                parent = path[depth].parent;
+            }
+
+            radix_trie_insert_r(&scratch, ref, parent, k, length, values[j]);
+
+            /* the new path, what is left of it is done */
+            for (;;)
+            {
+                nod *n = *ref;
+                int  end = n->crit_bit + n->order;
+                int  i = radix_trie_find_slot(k, n->order, n->crit_bit);
+                int  from = 0;
+
+                /* the same node as for the last key, done upto its slot */
+                if (depth < top && path[depth].ref == ref && path[depth].node == n)
+                    from = path[depth].slot;
+
+                path[depth].ref = ref;
+                path[depth].node = n;
+                path[depth].slot = i;
+                path[depth].parent = parent;
+                depth++;
+
+                if (i > from)
+                    radix_trie_build_final(ctx, &scratch, ref, from, i);
+
+                if (length == end)
+                    break;
+
+                parent = end;
+                ref = radix_trie_slot(*ref, i);
+            }
+        }
+
+        if (r)
+            radix_trie_build_final(ctx, &scratch, &r, 0, 1 << r->order);
+
+        while (build.spare)
+        {
+            nod *n = build.spare;
+
+            build.spare = n->fan[0];
+            n->flags = 0;
+            radix_trie_free_node(ctx, n);
+        }
+    }
+
+    /* what is left, as it comes */
+    for (; j < count; j++)
+    {
+        length = lens ? lens[j] : width;
+        if (length <= 0 || length > width)
+            continue;
+        r = radix_trie_insert_k(r, radix_trie_key(keys ? keys[j] : keys64[j], length), length, values[j]);
+    }
+
+    return r;
+}
+
+/*
+ * radix_trie_build_sorted:
+ *  insert n keys, of length lens[i] (32 for all when lens is NULL),
+ *  given in the order radix_trie_walk hands them out, into a trie that
+ *  is NULL or empty. The trie is built in one pass, each node once in
+ *  its final layout. Keys out of order, and keys for a trie that is
+ *  not empty, are inserted one by one.
+ */
+nod*
+radix_trie_build_sorted(nod *r, const uint32_t *keys, const int *lens, void **values, size_t n)
+{
+    return radix_trie_build_k(r, keys, 0, lens, values, n, 32);
+}
+
+nod*
+radix_trie_build_sorted64(nod *r, const uint64_t *keys, const int *lens, void **values, size_t n)
+{
+    return radix_trie_build_k(r, 0, keys, lens, values, n, KEYSIZE_MAX);
+}
+
+
+/*
+ * fn gets 32 bit keys, fn64 64 bit keys, only one of them is set. The
+ * entries of a string trie, whose keys are not integers, go out with
+ * key 0 and bit 0.
+ */
+static
+void
+radix_trie_walk_r(nod *root, void (*fn)(uint32_t key, int bit, void *v),
+                  void (*fn64)(uint64_t key, int bit, void *v))
+{
+    int i, bit = root->crit_bit + root->order;
+    uint64_t k;
+    void *v;
+
+    for (i = 0; i < (1 << root->order); i++)
+    {
+
+        nodetype nt = radix_trie_get_nodetype(root, i);
 
         if (nt == n_empty)
+            continue;
+
+        if (root->flags & RT_SKEY)
+            k = bit = 0;
+        else
+        {
+            k = (root->key) & radix_trie_prefix_mask(root->crit_bit);
+            if (bit <= KEYSIZE_MAX)
+                k += (uint64_t)i << (KEYSIZE_MAX - bit);
+        }
+
+        if (nt == n_internal)
+        {
+            radix_trie_walk_r(RT_CHILD(root, i), fn, fn64);
+            continue;
+        }
+
+        if (nt == n_external)
+            v = RT_SLOT(root, i);
+        else
+            v = RT_VALUE(root, i);
+
+        if (fn64)
+            fn64(k, bit, v);
+        else
+            fn((uint32_t)(k >> 32), bit, v);
+
+        if (nt == n_composite)
+            radix_trie_walk_r(RT_CHILD(root, i), fn, fn64);
+    }
+
+}
+
+void
+radix_trie_walk(nod *root, void (*fn)(uint32_t key, int bit, void *v))
+{
+    if (!root)
+        return;
+    if (root->flags & RT_SKEY)
+    {
+        WARNING("%s\n", "string keys are walked by radix_trie_walk_str");
+        return;
+    }
+
+    radix_trie_walk_r(radix_trie_top(root), fn, 0);
+}
+
+/*
+ * radix_trie_walk64:
+ *  as radix_trie_walk, with keys of upto 64 bit, aligned on the most
+ *  significant bit.
+ */
+void
+radix_trie_walk64(nod *root, void (*fn)(uint64_t key, int bit, void *v))
+{
+    if (!root)
+        return;
+    if (root->flags & RT_SKEY)
+    {
+        WARNING("%s\n", "string keys are walked by radix_trie_walk_str");
+        return;
+    }
+
+    radix_trie_walk_r(radix_trie_top(root), 0, fn);
+}
+
+
+/*
+ * cursors: the path of a cursor holds, for each node from the root
+ * down, the slot it went through, the top one being the slot of the
+ * current entry. In walk order, the entry of a slot comes before the
+ * keys under it.
+ */
+
+/* the entry in the top slot of the path */
+static
+int
+radix_trie_cursor_entry(struct radix_trie_cursor *c)
+{
+    nod *n = c->path[c->depth - 1];
+    int  i = c->slot[c->depth - 1];
+
+    c->len = n->crit_bit + n->order;
+    c->key = (n->key & radix_trie_prefix_mask(n->crit_bit)) | ((uint64_t)i << (KEYSIZE_MAX - c->len));
+    if (radix_trie_get_nodetype(n, i) == n_external)
+        c->value = RT_SLOT(n, i);
+    else
+        c->value = RT_VALUE(n, i);
+    return 1;
+}
+
+/* the first entry from slot i of the top node on */
+static
+int
+radix_trie_cursor_fwd(struct radix_trie_cursor *c, int i)
+{
+    while (c->depth > 0)
+    {
+        nod *n = c->path[c->depth - 1];
+        tag_t used = i < (1 << n->order) ? (n->tag | n->tag1) >> i : 0;
+
+        if (used)
+        {
+            /* the next slot in use */
+            i += radix_trie_popcount((used & -used) - 1);
+            c->slot[c->depth - 1] = i;
+            if (radix_trie_get_nodetype(n, i) != n_internal)
+                return radix_trie_cursor_entry(c);
+
+            c->path[c->depth++] = RT_CHILD(n, i);
+            i = 0;
+            continue;
+        }
+
+        /* n is done, on with the slot after it */
+        if (--c->depth > 0)
+            i = c->slot[c->depth - 1] + 1;
+    }
+
+    return 0;
+}
+
+/* the last entry from slot i of the top node back */
+static
+int
+radix_trie_cursor_bwd(struct radix_trie_cursor *c, int i)
+{
+    while (c->depth > 0)
+    {
+        nod *n = c->path[c->depth - 1];
+        tag_t used = i >= 0 ? (n->tag | n->tag1) & ((((tag_t)2) << i) - 1) : 0;
+
+        if (used)
+        {
+            /* the previous slot in use, its keys come before its entry */
+            while (used & (used - 1))
+                used &= used - 1;
+            i = radix_trie_popcount(used - 1);
+            c->slot[c->depth - 1] = i;
+            if (radix_trie_get_nodetype(n, i) == n_external)
+                return radix_trie_cursor_entry(c);
+
+            n = RT_CHILD(n, i);
+            c->path[c->depth++] = n;
+            i = (1 << n->order) - 1;
+            continue;
+        }
+
+        /* n is done, the entry of the slot holding it is next */
+        if (--c->depth > 0)
+        {
+            i = c->slot[c->depth - 1];
+            if (radix_trie_get_nodetype(c->path[c->depth - 1], i) == n_composite)
+                return radix_trie_cursor_entry(c);
+            i--;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * the first entry not before (k, len), keys are ordered as they are
+ * walked: on their bits, then a key before the longer ones it is a
+ * prefix of.
+ */
+static
+int
+radix_trie_lower_bound_k(struct radix_trie_cursor *c, nod *n, uint64_t k, int len)
+{
+    c->depth = 0;
+    n = radix_trie_top(n);
+
+    while (n)
+    {
+        uint64_t mask = radix_trie_prefix_mask(n->crit_bit);
+        int end = n->crit_bit + n->order;
+        int i;
+
+        c->path[c->depth++] = n;
+
+        /* the bits n skips decide for all of its keys */
+        if ((k & mask) < (n->key & mask))
+            return radix_trie_cursor_fwd(c, 0);
+        if ((k & mask) > (n->key & mask))
+        {
+            c->depth--;
+            return c->depth > 0 ? radix_trie_cursor_fwd(c, c->slot[c->depth - 1] + 1) : 0;
+        }
+
+        i = radix_trie_find_slot(k, n->order, n->crit_bit);
+        if (len <= end)
+            return radix_trie_cursor_fwd(c, i);
+
+        /* the entry of slot i is shorter than k, its keys may not be */
+        c->slot[c->depth - 1] = i;
+        if (!radix_trie_get_tag1(n, i))
+            return radix_trie_cursor_fwd(c, i + 1);
+        n = RT_CHILD(n, i);
+    }
+
+    return 0;
+}
+
+/*
+ * radix_trie_lower_bound:
+ *  position the cursor on the first entry not before (key, len), in
+ *  the order of radix_trie_walk, a len of 0 is before all keys.
+ * return:
+ *  0 for no such entry
+ *  1 for found, the entry is in c->key, c->len and c->value
+ */
+int
+radix_trie_lower_bound(struct radix_trie_cursor *c, nod *root, uint32_t key, int len)
+{
+    if (len < 0 || len > 32)
+    {
+        c->depth = 0;
+        return 0;
+    }
+    return radix_trie_lower_bound_k(c, root, len ? radix_trie_key(key, len) : 0, len);
+}
+
+int
+radix_trie_lower_bound64(struct radix_trie_cursor *c, nod *root, uint64_t key, int len)
+{
+    if (len < 0 || len > KEYSIZE_MAX)
+    {
+        c->depth = 0;
+        return 0;
+    }
+    return radix_trie_lower_bound_k(c, root, len ? radix_trie_key(key, len) : 0, len);
+}
+
+/* radix_trie_upper_bound: the first entry after (key, len) */
+int
+radix_trie_upper_bound(struct radix_trie_cursor *c, nod *root, uint32_t key, int len)
+{
+    if (!radix_trie_lower_bound(c, root, key, len))
+        return 0;
+    if (len > 0 && c->len == len && c->key == radix_trie_key(key, len))
+        return radix_trie_next(c);
+    return 1;
+}
+
+int
+radix_trie_upper_bound64(struct radix_trie_cursor *c, nod *root, uint64_t key, int len)
+{
+    if (!radix_trie_lower_bound64(c, root, key, len))
+        return 0;
+    if (len > 0 && c->len == len && c->key == radix_trie_key(key, len))
+        return radix_trie_next(c);
+    return 1;
+}
+
+/* radix_trie_first, radix_trie_last: the first and the last entry */
+int
+radix_trie_first(struct radix_trie_cursor *c, nod *root)
+{
+    return radix_trie_lower_bound_k(c, root, 0, 0);
+}
+
+int
+radix_trie_last(struct radix_trie_cursor *c, nod *root)
+{
+    c->depth = 0;
+    root = radix_trie_top(root);
+    if (!root)
+        return 0;
+
+    c->path[c->depth++] = root;
+    return radix_trie_cursor_bwd(c, (1 << root->order) - 1);
+}
+
+/*
+ * radix_trie_next, radix_trie_prev:
+ *  move the cursor to the next (previous) entry
+ * return:
+ *  0 at the end, the cursor is then no longer positioned
+ *  1 for moved
+ */
+int
+radix_trie_next(struct radix_trie_cursor *c)
+{
+    nod *n;
+    int  i;
+
+    if (c->depth <= 0)
+        return 0;
+
+    n = c->path[c->depth - 1];
+    i = c->slot[c->depth - 1];
+
+    /* the keys under a composite slot come after its entry */
+    if (radix_trie_get_nodetype(n, i) == n_composite)
+    {
+        c->path[c->depth++] = RT_CHILD(n, i);
+        return radix_trie_cursor_fwd(c, 0);
+    }
+    return radix_trie_cursor_fwd(c, i + 1);
+}
+
+int
+radix_trie_prev(struct radix_trie_cursor *c)
+{
+    if (c->depth <= 0)
+        return 0;
+
+    return radix_trie_cursor_bwd(c, c->slot[c->depth - 1] - 1);
+}
+
+
+/* RT_CHILD, with the kind of node known to the caller */
+static INLINE
+nod*
+radix_trie_find_child(nod *r, int i, int image)
+{
+    nod *c = RT_SLOT(r, i);
+
+    return image ? (nod*)((char*)r + (intptr_t)c) : c;
+}
+
+/*
+ * one node of a lookup, with the slot i the key takes in it, of type
+ * nt, *rp moves to the next node, image is set in a mapped image
+ * return:
+ *  -1 to go on from *rp
+ *  0 for not found
+ *  1 for found, value stored in val
+ */
+static INLINE
+int
+radix_trie_find_next(nod **rp, int i, nodetype nt, uint64_t k, int len, void **val, int image)
+{
+    nod *r = *rp;
+    int end = r->crit_bit + r->order;
+
+    if (len < end)
+        return 0;
+
+    if (len == end)
+    {
+        /* slots only index the key, the skipped bits are checked here */
+        if ((k ^ r->key) & radix_trie_prefix_mask(r->crit_bit))
+            return 0;
+
+        switch (nt)
+        {
+            case n_composite:
+                *val = RT_LOAD(&radix_trie_find_child(r, i, image)->value);
+                return 1;
+                break;
+            case n_external:
+                *val = RT_SLOT(r, i);
+                return 1;
+                break;
+            case n_internal:
+            default:
+                return 0;
+                break;
+        }
+    }
+
+    switch (nt)
+    {
+        case n_internal:
+        case n_composite:
+            *rp = radix_trie_find_child(r, i, image);
+            return -1;
+            break;
+        case n_external:
+        default:
+            return 0;
+            break;
+    }
+}
+
+static INLINE
+int
+radix_trie_find_step(nod **rp, uint64_t k, int len, void **val, int image)
+{
+    nod *r = *rp;
+    int i = radix_trie_find_slot(k, r->order, r->crit_bit);
+
+    return radix_trie_find_next(rp, i, radix_trie_get_nodetype(r, i), k, len, val, image);
+}
+
+static int radix_trie_range_find(nod **ranges, uint64_t k, int len, void **val);
+
+/*
+ * the lookup loop of a trie in memory, of any order: each node has
+ * its own order, which the root and nodes cut in two do not share.
+ * Loops made for each order, with the slot mask a constant, came out
+ * slower, for the test of the order of each node they need. A key not
+ * there may be in a range of the trie at root.
+ */
+static
+int
+radix_trie_find_heap(struct radix_trie_ctx *ctx, nod *root, nod *r, uint64_t k, int len, void **val)
+{
+    int ret, visits = 1;
+
+    while ((ret = radix_trie_find_step(&r, k, len, val, 0)) < 0)
+        visits++;
+    if (!ret && radix_trie_ctx(root)->ranges)
+        ret = radix_trie_range_find(radix_trie_ctx(root)->ranges, k, len, val);
+
+    RT_COUNT(ctx, finds, 1);
+    RT_COUNT(ctx, find_nodes, visits);
+    if (!ret)
+        RT_COUNT(ctx, find_misses, 1);
+    return ret;
+}
+
+/*
+ * return:
+ *  0 for not found
+ *  1 for found, value stored in val
+ */
+static INLINE
+int
+radix_trie_find_k(nod *r, uint64_t k, int len, void **val)
+{
+    struct radix_trie_ctx *ctx = 0;
+    nod *root = r;
+    int ret;
+
+#ifdef RADIX_TRIE_COUNTERS
+    ctx = radix_trie_ctx(r);
+#endif
+    r = radix_trie_top(r);
+    if (!r)
+        return 0;
+
+    /* a lookup stays in a trie or in an image, the loop is made for each */
+    if (r->flags & RT_IMAGE)
+    {
+        while ((ret = radix_trie_find_step(&r, k, len, val, 1)) < 0)
+            ;
+        return ret;
+    }
+
+    return radix_trie_find_heap(ctx, root, r, k, len, val);
+}
+
+int
+radix_trie_find(nod *r, uint32_t key, int len, void **val)
+{
+    int ret;
+
+    if (len <= 0 || len > 32)
+        return 0;
+
+    RT_PROBE3(find_entry, r, key, len);
+    ret = radix_trie_find_k(r, radix_trie_key(key, len), len, val);
+    RT_PROBE4(find_return, r, key, len, ret);
+    return ret;
+}
+
+int
+radix_trie_find64(nod *r, uint64_t key, int len, void **val)
+{
+    int ret;
+
+    if (len <= 0 || len > KEYSIZE_MAX)
+        return 0;
+
+    RT_PROBE3(find_entry, r, key, len);
+    ret = radix_trie_find_k(r, radix_trie_key(key, len), len, val);
+    RT_PROBE4(find_return, r, key, len, ret);
+    return ret;
+}
+
+/*
+ * batched lookups, in groups of RT_BATCH. The lookups of a group go
+ * down a node at a time, in turn, and each one prefetches the next
+ * node it needs, so its cache miss is taken while the others are
+ * stepped.
+ */
+#define RT_BATCH 16
+
+/*
+ * the slots and slot types keys k[0 .. n) take in node r, all at once,
+ * radix_trie_slots picks the widest version the cpu runs
+ */
+static
+void
+radix_trie_slots_scalar(nod *r, const uint64_t *k, int n, int *slot, int *nt)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        slot[i] = radix_trie_find_slot(k[i], r->order, r->crit_bit);
+        nt[i] = radix_trie_get_nodetype(r, slot[i]);
+    }
+}
+
+#ifdef RT_X86
+__attribute__((target("sse2")))
+static
+void
+radix_trie_slots_sse2(nod *r, const uint64_t *k, int n, int *slot, int *nt)
+{
+    __m128i up = _mm_cvtsi32_si128(r->crit_bit);
+    __m128i down = _mm_cvtsi32_si128(KEYSIZE_MAX - r->order);
+    int i;
+
+    for (i = 0; i + 2 <= n; i += 2)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(k + i));
+
+        v = _mm_srl_epi64(_mm_sll_epi64(v, up), down);
+        _mm_storel_epi64((__m128i*)(slot + i), _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 0, 2, 0)));
+        nt[i] = radix_trie_get_nodetype(r, slot[i]);
+        nt[i + 1] = radix_trie_get_nodetype(r, slot[i + 1]);
+    }
+    radix_trie_slots_scalar(r, k + i, n - i, slot + i, nt + i);
+}
+
+__attribute__((target("avx2")))
+static
+void
+radix_trie_slots_avx2(nod *r, const uint64_t *k, int n, int *slot, int *nt)
+{
+    __m128i up = _mm_cvtsi32_si128(r->crit_bit);
+    __m128i down = _mm_cvtsi32_si128(KEYSIZE_MAX - r->order);
+    __m256i tag = _mm256_set1_epi64x((long long)r->tag);
+    __m256i tag1 = _mm256_set1_epi64x((long long)r->tag1);
+    __m256i one = _mm256_set1_epi64x(1);
+    __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    int i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(k + i));
+        __m256i t;
+
+        v = _mm256_srl_epi64(_mm256_sll_epi64(v, up), down);
+        t = _mm256_or_si256(_mm256_and_si256(_mm256_srlv_epi64(tag, v), one),
+                            _mm256_slli_epi64(_mm256_and_si256(_mm256_srlv_epi64(tag1, v), one), 1));
+        _mm_storeu_si128((__m128i*)(slot + i), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(v, pack)));
+        _mm_storeu_si128((__m128i*)(nt + i), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(t, pack)));
+    }
+    radix_trie_slots_scalar(r, k + i, n - i, slot + i, nt + i);
+}
+#endif
+
+static radix_trie_slots_fn radix_trie_slots = radix_trie_slots_scalar;
+
+/*
+ * radix_trie_slots_kernel:
+ *  a version of the slot decoding, RT_SLOTS_SCALAR, _SSE2 or _AVX2,
+ *  NULL when the cpu does not run it.
+ */
+radix_trie_slots_fn
+radix_trie_slots_kernel(int which)
+{
+    switch (which)
+    {
+        case RT_SLOTS_SCALAR:
+            return radix_trie_slots_scalar;
+#ifdef RT_X86
+        case RT_SLOTS_SSE2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("sse2") ? radix_trie_slots_sse2 : 0;
+        case RT_SLOTS_AVX2:
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2") ? radix_trie_slots_avx2 : 0;
+#endif
+        default:
+            return 0;
+    }
+}
+
+/* the version batched lookups use from now on, -1 when the cpu does not run it */
+int
+radix_trie_slots_use(int which)
+{
+    radix_trie_slots_fn f = radix_trie_slots_kernel(which);
+
+    if (!f)
+        return -1;
+    RT_STORE(&radix_trie_slots, f);
+    return 0;
+}
+
+/* the widest version is picked once, before any thread can look up */
+#if defined(__GNUC__)
+__attribute__((constructor))
+static
+void
+radix_trie_slots_pick(void)
+{
+    if (radix_trie_slots_use(RT_SLOTS_AVX2) != 0)
+        radix_trie_slots_use(RT_SLOTS_SSE2);
+}
+#endif
+
+static
+size_t
+radix_trie_find_batch_k(nod *r, const uint32_t *keys, const uint64_t *keys64, const int *lens,
+                        size_t count, void **vals, int *found, int width)
+{
+    struct radix_trie_ctx *ctx = 0;
+    nod **ranges = radix_trie_ctx(r)->ranges;
+    nod *n[RT_BATCH];
+    uint64_t k[RT_BATCH];
+    int  len[RT_BATCH], slot[RT_BATCH], nt[RT_BATCH];
+    size_t base, hits = 0, tried = 0, steps = 0;
+    int  g, s, live, image;
+
+#ifdef RADIX_TRIE_COUNTERS
+    ctx = radix_trie_ctx(r);
+#endif
+    r = radix_trie_top(r);
+    if (!r)
+    {
+        for (base = 0; base < count; base++)
+            found[base] = 0;
+        return 0;
+    }
+    image = (r->flags & RT_IMAGE) != 0;
+
+    for (base = 0; base < count; base += g)
+    {
+        g = count - base < RT_BATCH ? (int)(count - base) : RT_BATCH;
+
+        live = 0;
+        for (s = 0; s < g; s++)
         {
-            if (match + RADIX_ORDER >= length)
-            {
-                // simply insert value and set tag bit
-                r->fan[i] = value;
-                radix_trie_set_nodetype(r, n_external, i);
-            }
-            else
-            {
-                // insert new node
-                nod *n_child;
-                n_child = radix_trie_new(_key, KEYSIZE_MAX, length, value, 1); /* crit_bit is the last bit */
-                r->fan[i] = n_child;
-                radix_trie_set_nodetype(r, n_internal, i);
-            }
-            return _r;
+            len[s] = lens ? lens[base + s] : width;
+            found[base + s] = 0;
+            n[s] = 0;
+            k[s] = 0;
+            if (len[s] <= 0 || len[s] > width)
+                continue;
+            k[s] = radix_trie_key(keys ? keys[base + s] : keys64[base + s], len[s]);
+            n[s] = r;
+            live++;
         }
-        else if (nt == n_external)
+        tried += live;
+
+        /* the root is the same for all, its slots are found at once */
+        RT_LOAD(&radix_trie_slots)(r, k, g, slot, nt);
+        for (s = 0; s < g; s++)
         {
-            // Take a leaf and read ...
-            if (r->crit_bit + r->order == length)
-            {
-                // The reasoning is:
-                // we matched the whole key, note: (match == r->crit_bit),
-                // and the existing holder being external, means the keys must match
-                // So, let's Replace the exiting value
-                r->fan[i] = value;
-            }
-            else if (r->crit_bit + r->order > length)
+            int ret;
+
+            if (!n[s])
+                continue;
+
+            ret = radix_trie_find_next(&n[s], slot[s], (nodetype)nt[s], k[s], len[s], &vals[base + s], image);
+            steps++;
+            if (ret < 0)
             {
-                /* r->crit_bit + r->order should always less than 32 */
-                r->fan[i] = value;
+                RT_PREFETCH(n[s]);
+                continue;
             }
-            else
+            found[base + s] = ret;
+            hits += ret;
+            n[s] = 0;
+            live--;
+        }
+
+        /* a node down for every lookup of the group, in turn */
+        while (live)
+        {
+            for (s = 0; s < g; s++)
             {
-                /* The slot is already taken by an external entry, the following steps to be done */
-                /* 1. we are going to make a new internal node to fit the current entry */
-                /* 2. and assigned the "value" field in the new node with existing value */
-                /* 3. clear bit in tag */
-                /* 4. set bit in tag1 to signal the new entry are compound entry */
-                /* 5. insert the new node to the slot */
+                int ret;
 
-                nod *n_child =
-                    radix_trie_new(_key, KEYSIZE_MAX, length, value, 1); /* crit_bit is the last bit, and its an external */
+                if (!n[s])
+                    continue;
 
-                n_child->value = r->fan[i];
-                radix_trie_set_nodetype(r, n_composite, i);
-                r->fan[i] = n_child;
+                ret = radix_trie_find_step(&n[s], k[s], len[s], &vals[base + s], image);
+                steps++;
+                if (ret < 0)
+                {
+                    RT_PREFETCH(n[s]);
+                    continue;
+                }
+                found[base + s] = ret;
+                hits += ret;
+                n[s] = 0;
+                live--;
             }
         }
-        else if (nt == n_composite)
-        {
-            // replace
-            r->fan[i]->value = value;
-            return _r;
-        }
-        else if (nt == n_internal)
+
+        /* keys not there may be in a range, see radix_trie_insert_range */
+        for (s = 0; ranges && s < g; s++)
         {
-            r->fan[i]->value = value;
-            radix_trie_set_nodetype(r, n_composite, i);
-            return _r;
+            if (!found[base + s] && len[s] > 0 && len[s] <= width)
+            {
+                found[base + s] = radix_trie_range_find(ranges, k[s], len[s], &vals[base + s]);
+                hits += found[base + s];
+            }
         }
     }
-    else if (match < r->crit_bit)
-    {
-        // a new node is needed with shorter crit_bit
-        // with "match" bits of common prefix
-        // with new child and old_child, as is "r"
-
 
-        /* split r */
-        int i = radix_trie_find_slot(_key, r->order, match);
-        uint32_t n_mask = 0xffffffff >> match;
-        nod *n_nod, *n_child;
-        int slot_old;
+    RT_COUNT(ctx, finds, tried);
+    RT_COUNT(ctx, find_nodes, steps);
+    RT_COUNT(ctx, find_misses, tried - hits);
+    return hits;
+}
 
-        /* new child node for new key 
-         * crit_bit is set to the key_length subtracted by fanning factor, 
-         * to INDICATE this node contains only externals, and it will stay this way.
-         */
-        n_child = radix_trie_new(_key, KEYSIZE_MAX, length, value, 1);
+/*
+ * radix_trie_find_batch:
+ *  look up n keys at once, of length lens[i] (32 for all when lens is
+ *  NULL). found[i] tells if keys[i] is found, its value is then stored
+ *  in vals[i]. Returns the number of keys found.
+ */
+size_t
+radix_trie_find_batch(nod *r, const uint32_t *keys, const int *lens, size_t n,
+                      void **vals, int *found)
+{
+    return radix_trie_find_batch_k(r, keys, 0, lens, n, vals, found, 32);
+}
 
-        /* new root for sub-tree */
+size_t
+radix_trie_find_batch64(nod *r, const uint64_t *keys, const int *lens, size_t n,
+                        void **vals, int *found)
+{
+    return radix_trie_find_batch_k(r, 0, keys, lens, n, vals, found, KEYSIZE_MAX);
+}
 
+/*
+ * the value of the longest key that is a prefix of k, of "width" bits,
+ * in one descent. A key of length l sits in the node ending at bit l,
+ * with the bits it skips checked, once they differ no deeper key can
+ * match.
+ */
+static
+int
+radix_trie_lpm_k(nod *r, uint64_t k, int width, int *matched_len, void **val)
+{
+    int found = 0;
 
-        n_nod = radix_trie_new(_key, KEYSIZE_MAX, prefix, r->value, 0);
-        /* connect the old root to the 1st slot */
-        slot_old = radix_trie_find_slot(r->key, n_nod->order, n_nod->crit_bit);
-        n_nod->fan[slot_old] = r;
+    r = radix_trie_top(r);
+    while (r)
+    {
+        int end = r->crit_bit + r->order;
+        int i;
+        nodetype nt;
 
-        /* connect the new child to new root */
-        i = radix_trie_find_slot(_key, n_nod->order, match);
-        n_nod->fan[i] = n_child;
+        if (end > width || ((k ^ r->key) & radix_trie_prefix_mask(r->crit_bit)))
+            break;
 
-        /* set tags */
-        radix_trie_set_nodetype(n_nod, n_internal, slot_old);
-        radix_trie_set_nodetype(n_nod, n_internal, i);
+        i = radix_trie_find_slot(k, r->order, r->crit_bit);
+        nt = radix_trie_get_nodetype(r, i);
 
-        if (r == _r)
-        {
-            return n_nod;
-        }
-        else
+        if (nt == n_external || nt == n_composite)
         {
-            i = radix_trie_find_slot(_key, last_r->order, last_r->crit_bit);
-            last_r->fan[i] = n_nod;
-            return _r;
+            *matched_len = end;
+            *val = nt == n_external ? RT_SLOT(r, i) : RT_VALUE(r, i);
+            found = 1;
         }
+        if (nt != n_internal && nt != n_composite)
+            break;
 
-    }
-    else if (match > r->crit_bit)
-    {
-        WARNING("%s", "Something weird happened\n");
+        r = RT_CHILD(r, i);
     }
 
-    return _r;
+    return found;
 }
 
-void
-radix_trie_walk(nod *root, void (*fn)(uint32_t key, int bit, void *v))
+/*
+ * radix_trie_lpm:
+ *  longest prefix match, the value of the longest key stored that is a
+ *  prefix of the 32 bit key, its length is stored in matched_len.
+ * return:
+ *  0 for no prefix of key stored
+ *  1 for found, value stored in val
+ */
+int
+radix_trie_lpm(nod *r, uint32_t key, int *matched_len, void **val)
 {
-    int i;
-    uint32_t k;
+    return radix_trie_lpm_k(r, radix_trie_key(key, 32), 32, matched_len, val);
+}
 
+int
+radix_trie_lpm64(nod *r, uint64_t key, int *matched_len, void **val)
+{
+    return radix_trie_lpm_k(r, key, KEYSIZE_MAX, matched_len, val);
+}
 
-    if (!root)
-        return;
-    for (i = 0; i < MAP_SIZE; i++)
-    {
+/*
+ * radix_trie_collapse:
+ *  the node below internal slot i of n holds nothing but the way down
+ *  to another node, which takes its place; the bits in between are
+ *  skipped, as those of a node an insert hangs under a shorter parent.
+ *  Returns 1 when the node went. Not in a RADIX_TRIE_CONCURRENT trie,
+ *  whose deletes lock only the nodes they empty. A node a snapshot
+ *  holds was copied on the way down, the copy goes.
+ */
+static
+int
+radix_trie_collapse(struct radix_trie_ctx *ctx, nod **ref, nod *n, int i)
+{
+    nod *c = *radix_trie_slot(n, i);
+    nod *g;
 
-        nodetype nt = radix_trie_get_nodetype(root, i);
+    if ((ctx->flags & RADIX_TRIE_CONCURRENT) || c->tag || radix_trie_count(c) != 1)
+        return 0;
 
-        k = (root->key) & (0xffffffff << (KEYSIZE_MAX - root->crit_bit));
-        k += i << (KEYSIZE_MAX - root->crit_bit - root->order);
+    g = *radix_trie_slot(c, radix_trie_popcount((c->tag1 & -c->tag1) - 1));
+    radix_trie_slot_set(ctx, ref, n, i, n_internal, g);
+    radix_trie_free_node(ctx, c);
+    return 1;
+}
 
-        if (nt == n_external)
+/*
+ * ref is where the parent keeps n, NULL for the root, which stays in
+ * place.
+ */
+static
+int
+radix_trie_delete_r(struct radix_trie_ctx *ctx, nod **ref, nod *n, uint64_t k, int len)
+{
+    int  r = 0;
+    int  i;
+    nodetype nt;
+    nod **s;
+
+    /* keys end on the end of a node, one ending before it is not there */
+    if (len < n->crit_bit + n->order)
+        return 0;
+
+    if (ctx->snapshots && n->share)
+        n = radix_trie_unshare(ctx, ref, n);
+
+    // need to look up the node using partial key
+    i = radix_trie_find_slot(k, n->order, n->crit_bit);
+    nt = radix_trie_get_nodetype(n, i);
+    s = radix_trie_slot(n, i);
+
+    if (len == n->crit_bit + n->order)
+    {
+        // varify key is same
+        if (radix_trie_find_prefix(k, n->key) < n->crit_bit)
+            return 0;
+
+        switch (nt)
         {
-            fn(k, root->crit_bit + root->order, root->fan[i]);
+            case n_composite:
+                radix_trie_slot_set(ctx, ref, n, i, n_internal, *s);
+                r = 1;
+                break;
+            case n_external:
+                // unset tag
+                radix_trie_slot_remove(ctx, ref, n, i);
+                r = 1;
+                break;
+            default:
+                WARNING("%016llX is not in the set\n", (unsigned long long)k);
+                break;
         }
-        else if (nt == n_internal)
+        return r;
+    }
+
+    switch (nt)
+    {
+        case n_internal:
+            r = radix_trie_delete_r(ctx, s, *s, k, len);
+            if (r && radix_trie_is_empty(*s))
+            {
+                radix_trie_free_node(ctx, *s);
+                radix_trie_slot_remove(ctx, ref, n, i);
+                RT_COUNT(ctx, delete_frees, 1);
+            }
+            else if (r && radix_trie_collapse(ctx, ref, n, i))
+                RT_COUNT(ctx, delete_frees, 1);
+            break;
+        case n_composite:
+            r = radix_trie_delete_r(ctx, s, *s, k, len);
+            if (r && radix_trie_is_empty(*s))
+            {
+                void *x = (*s)->value;
+                radix_trie_free_node(ctx, *s);
+                radix_trie_slot_set(ctx, ref, n, i, n_external, x);
+                RT_COUNT(ctx, delete_frees, 1);
+            }
+            break;
+        default:
+            WARNING("%016llX is not in the set\n", (unsigned long long)k);
+            break;
+    }
+    return r;
+}
+
+/*
+ * a delete of a RADIX_TRIE_CONCURRENT writer: down to the node holding
+ * the key, noting the path. The node is changed, and so is each node
+ * above it that held nothing but the way down to a node left empty.
+ * Those are locked with the node holding the first of them, and
+ * radix_trie_delete_r does the change from there.
+ */
+static
+int
+radix_trie_delete_olc(struct radix_trie_ctx *ctx, uint64_t k, int len)
+{
+    nod *path[KEYSIZE_MAX + 1];
+    nod **ref[KEYSIZE_MAX + 1];
+    int64_t ver[KEYSIZE_MAX + 1];
+    int  tries = 0;
+
+    for (;; radix_trie_backoff(&tries))
+    {
+        int64_t vw = radix_trie_version(&ctx->word);
+        int  d = 0, j, l, r, empty;
+        word_t *w;
+        nodetype nt;
+        nod *n;
+
+        ref[0] = &ctx->top;
+        n = RT_LOAD(ref[0]);
+        for (;;)
         {
-            radix_trie_walk(root->fan[i], fn);
+            int end = n->crit_bit + n->order;
+            int i;
+
+            path[d] = n;
+            ver[d] = radix_trie_version(&n->word);
+            if (ver[d] < 0 || len <= end)
+                break;
+            i = radix_trie_find_slot(k, n->order, n->crit_bit);
+            if (!radix_trie_get_tag1(n, i))
+                return 0;
+            ref[++d] = radix_trie_slot(n, i);
+            n = RT_LOAD(ref[d]);
         }
-        else if (nt == n_composite)
+        if (ver[d] < 0)
+            continue;
+
+        if (len < n->crit_bit + n->order || radix_trie_find_prefix(k, n->key) < n->crit_bit)
+            return 0;
+        nt = radix_trie_get_nodetype(n, radix_trie_find_slot(k, n->order, n->crit_bit));
+        if (nt != n_external && nt != n_composite)
+            return 0;
+
+        /* the nodes left empty take their slot away from the one above */
+        j = d;
+        empty = nt == n_external && radix_trie_count(n) == 1;
+        while (empty && j > 0)
         {
-            fn(k, root->crit_bit + root->order, root->fan[i]->value);
-            radix_trie_walk(root->fan[i], fn);
+            nod *p = path[--j];
+
+            nt = radix_trie_get_nodetype(p, radix_trie_find_slot(k, p->order, p->crit_bit));
+            empty = nt == n_internal && radix_trie_count(p) == 1;
         }
+
+        w = j ? &path[j - 1]->word : &ctx->word;
+        if (!radix_trie_lock(w, j ? ver[j - 1] : vw))
+            continue;
+        for (l = j; l <= d && radix_trie_lock(&path[l]->word, ver[l]); l++)
+            ;
+        r = l > d ? radix_trie_delete_r(ctx, ref[j], path[j], k, len) : -1;
+        while (l-- > j)
+            radix_trie_unlock(&path[l]->word);
+        radix_trie_unlock(w);
+        if (r >= 0)
+            return r;
+    }
+}
+
+/*
+ * radix_trie_delete:
+ *  Given a key, remove the entry or node associated with key
+ *  within the tree if the key is found, otherwise, do nothing
+ *  The root node itself is never freed or moved.
+ *
+ * Return:
+ *  0 : fail
+ *  1 : success
+ */
+int
+radix_trie_delete(nod *n, uint32_t key, int len)
+{
+    int  r = 0;
+
+
+    if (!n || len <= 0 || len > 32)
+        return r;
+
+    return radix_trie_delete64(n, key, len);
+}
+
+static
+int
+radix_trie_delete_k(nod *n, uint64_t key, int len)
+{
+    struct radix_trie_ctx *ctx = radix_trie_ctx(n);
+    void *val;
+    int  r;
+
+    if (radix_trie_readonly(n))
+    {
+        WARNING("%s\n", "a snapshot or an image does not change");
+        return 0;
+    }
+    if (radix_trie_stray_writer(ctx))
+        return 0;
+    RT_COUNT(ctx, deletes, 1);
+
+    /* nodes held by snapshots are copied on the way, only for a key there */
+    if (ctx->snapshots && !radix_trie_find_k(n, radix_trie_key(key, len), len, &val))
+        return 0;
+
+    if (ctx->flags & RADIX_TRIE_CONCURRENT)
+    {
+        r = radix_trie_delete_olc(ctx, radix_trie_key(key, len), len);
+        radix_trie_reclaim(ctx);
+        return r;
+    }
+    if (ctx->shared)
+    {
+        r = radix_trie_delete_r(ctx, &ctx->top, ctx->top, radix_trie_key(key, len), len);
+        radix_trie_reclaim(ctx);
+        return r;
     }
 
+    r = radix_trie_delete_r(ctx, 0, n, radix_trie_key(key, len), len);
+    if (!r && ctx->ranges && ctx->ranges[len - 1])
+        r = radix_trie_range_cut(ctx->ranges[len - 1], key, key, len);
+    return r;
+}
+
+int
+radix_trie_delete64(nod *n, uint64_t key, int len)
+{
+    int  r;
+
+    if (!n || len <= 0 || len > KEYSIZE_MAX)
+        return 0;
+
+    RT_PROBE3(delete_entry, n, key, len);
+    r = radix_trie_delete_k(n, key, len);
+    RT_PROBE4(delete_return, n, key, len, r);
+    return r;
+}
+
+
+/*
+ * Ranges.
+ *
+ * radix_trie_insert_range maps the keys lo .. hi of len bits to base,
+ * base + 1, ... The range is cut into blocks of 2^m keys starting at a
+ * multiple of 2^m, each a key of the len - m bits its keys share, in a
+ * trie of blocks of its own for keys of len bits, kept in ctx->ranges.
+ * The value of a block is that of its first key. The blocks of a trie
+ * do not overlap, nor do they hold a key of the trie itself: a lookup
+ * that misses in the trie takes the one block that is a prefix of the
+ * key, by longest prefix match, and adds the bits of the key after it.
+ */
+
+/* the value of key k, aligned on the most significant bit, in a block */
+static
+int
+radix_trie_range_find(nod **ranges, uint64_t k, int len, void **val)
+{
+    nod *t = ranges[len - 1];
+    void *v;
+    int  l, m;
+
+    if (!t || !radix_trie_lpm_k(t, k, len, &l, &v))
+        return 0;
+
+    m = len - l;
+    *val = (void*)((uintptr_t)v + (m ? (k << l) >> (KEYSIZE_MAX - m) : 0));
+    return 1;
 }
 
+/* blocks of the keys lo .. hi, the first of value base */
+static
+void
+radix_trie_range_add(nod *t, uint64_t lo, uint64_t hi, int len, uintptr_t base)
+{
+    for (;;)
+    {
+        int m = 0;
+
+        /* the largest block starting at lo, not past hi, of a bit at least */
+        while (m + 1 < len && !(lo & (((uint64_t)2 << m) - 1)) && hi - lo >= ((uint64_t)2 << m) - 1)
+            m++;
+        radix_trie_insert_k(t, radix_trie_key(lo >> m, len - m), len - m, (void*)base);
+
+        if (hi - lo == ((uint64_t)1 << m) - 1)
+            break;
+        lo += (uint64_t)1 << m;
+        base += (uint64_t)1 << m;
+    }
+}
 
 /*
+ * radix_trie_range_cut:
+ *  take the keys lo .. hi out of the blocks of t, of keys of len bits.
+ *  A block holding lo or hi goes, and the keys of it outside lo .. hi
+ *  are added again, then the blocks in between go.
  * return:
- *  0 for not found
- *  1 for found, value stored in val
+ *  0 for no key taken out
+ *  1 for keys taken out
  */
+static
 int
-radix_trie_find(nod *r, uint32_t key, int len, void **val)
+radix_trie_range_cut(nod *t, uint64_t lo, uint64_t hi, int len)
 {
+    radix_trie_cursor c;
+    int  cut = 0, j, l;
+    void *v;
+
+    for (j = 0; j < 2; j++)
+    {
+        uint64_t k = j ? hi : lo;
+        uint64_t first, last;
+        int m;
+
+        if (!radix_trie_lpm_k(t, radix_trie_key(k, len), len, &l, &v))
+            continue;
+
+        m = len - l;
+        first = k >> m << m;
+        last = first | (((uint64_t)1 << m) - 1);
+        radix_trie_delete_k(t, k >> m, l);
+        if (first < lo)
+            radix_trie_range_add(t, first, lo - 1, len, (uintptr_t)v);
+        if (last > hi)
+            radix_trie_range_add(t, hi + 1, last, len, (uintptr_t)v + (hi + 1 - first));
+        cut = 1;
+    }
+
+    while (radix_trie_lower_bound_k(&c, t, radix_trie_key(lo, len), len) &&
+           c.key >> (KEYSIZE_MAX - len) <= hi)
+    {
+        radix_trie_delete_k(t, c.key >> (KEYSIZE_MAX - c.len), c.len);
+        cut = 1;
+    }
+
+    return cut;
+}
 
+static
+void
+radix_trie_range_free(struct radix_trie_ctx *ctx)
+{
     int i;
-    uint32_t k;
-    nodetype nt;
-    int length = len;
-    int prefix;
 
-    if (!r)
-        return 0;
+    if (!ctx->ranges)
+        return;
+    for (i = 0; i < KEYSIZE_MAX; i++)
+        radix_trie_delete_all(ctx->ranges[i]);
+    free(ctx->ranges);
+    ctx->ranges = 0;
+}
 
-    if (len < KEYSIZE_MAX)
-        k = key << (KEYSIZE_MAX - len);
-    else
-        k = key;
+static
+size_t
+radix_trie_range_bytes(struct radix_trie_ctx *ctx)
+{
+    struct radix_trie_stats st;
+    size_t bytes = KEYSIZE_MAX * sizeof(nod*);
+    int i;
 
-    while (len > r->crit_bit)
+    for (i = 0; i < KEYSIZE_MAX; i++)
     {
-
-        i = radix_trie_find_slot(k, r->order, r->crit_bit);
-        nt = radix_trie_get_nodetype(r, i);
-        switch (nt)
-        {
-            case n_internal:
-                r = r->fan[i];
-                break;
-            case n_composite:
-                r = r->fan[i];
-                break;
-            case n_external:
-                if (r->crit_bit + r->order == len)
-                {
-                    break;
-                }
-                else
-                {
-                    return 0;
-                }
-                break;
-            default:
-                return 0;
-                break;
-        }
-        if (r->crit_bit + r->order == len)
-        {
-            break;
-        }
+        if (ctx->ranges[i] && radix_trie_stats(ctx->ranges[i], &st) == 0)
+            bytes += st.bytes;
     }
+    return bytes;
+}
 
-    i = radix_trie_find_slot(k, r->order, r->crit_bit);
-    nt = radix_trie_get_nodetype(r, i);
+static
+nod*
+radix_trie_insert_range_k(nod *r, uint64_t lo, uint64_t hi, int len, void *base)
+{
+    struct radix_trie_ctx *ctx = radix_trie_ctx(r);
+    radix_trie_cursor c;
+    uint64_t k;
+    int  more;
 
-    prefix = radix_trie_find_prefix(k, r->key);
-    if (prefix > length)
-        prefix = length;
+    if (radix_trie_readonly(r) || (ctx->flags & RADIX_TRIE_SET))
+    {
+        WARNING("%s\n", "a snapshot, an image or a set takes no range");
+        return r;
+    }
+    if (radix_trie_stray_writer(ctx))
+        return r;
 
-    if (prefix > r->crit_bit + r->order)
+    /*
+     * readers of a shared trie do not see a trie of blocks change, tries
+     * grown from a NULL root have no ctx of their own, they take the
+     * keys one by one
+     */
+    if (!r || !(r->flags & RT_HEAD) || ctx->shared || (r->flags & RT_SKEY))
     {
-        switch (nt)
+        for (k = lo;; k++)
         {
-            case n_internal:
-            case n_composite:
-                r = r->fan[i];
-                break;
-            case n_external:
-                return 0;
-                break;
-            default:
-                return 0;
+            r = radix_trie_insert_k(r, radix_trie_key(k, len), len, (void*)((uintptr_t)base + (k - lo)));
+            if (k == hi)
                 break;
         }
+        return r;
     }
-    else
+
+    /* the keys of the trie in the range go, then the blocks there */
+    more = radix_trie_lower_bound_k(&c, r, radix_trie_key(lo, len), len);
+    while (more && c.key <= radix_trie_key(hi, len))
     {
-        if (length == r->crit_bit + r->order)
-        {
-            switch (nt)
-            {
-                case n_composite:
-                    *val = r->fan[i]->value;
-                    return 1;
-                    break;
-                case n_external:
-                    *val = r->fan[i];
-                    return 1;
-                    break;
-                case n_internal:
-                default:
-                    return 0;
-                    break;
-            }
-                
-        }
-        else
+        if (c.len != len)
         {
-            switch (nt)
-            {
-                case n_internal:
-                case n_composite:
-                    r = r->fan[i];
-                    break;
-                case n_external:
-                    return 0;
-                    break;
-                default:
-                    return 0;
-                    break;
-            }
+            more = radix_trie_next(&c);
+            continue;
         }
+        k = c.key;
+        radix_trie_delete_k(r, k >> (KEYSIZE_MAX - len), len);
+        more = radix_trie_lower_bound_k(&c, r, k, len);
     }
 
-    return 0;
-}
+    if (!ctx->ranges)
+        ctx->ranges = (nod**)calloc(KEYSIZE_MAX, sizeof(nod*));
+    if (!ctx->ranges[len - 1])
+        ctx->ranges[len - 1] = radix_trie_create(RADIX_TRIE_AUTO | RADIX_TRIE_ORDER(ctx->order));
+    else
+        radix_trie_range_cut(ctx->ranges[len - 1], lo, hi, len);
 
-static
-int
-radix_trie_is_empty(nod* n)
-{
-    return (n->tag == 0 &&
-            n->tag1 == 0);
+    radix_trie_range_add(ctx->ranges[len - 1], lo, hi, len, (uintptr_t)base);
+    return r;
 }
+
 /*
- * radix_trie_delete:
- *  Given a key, remove the entry or node associated with key
- *  within the tree if the key is found, otherwise, do nothing
- *
- * Return:
- *  0 : fail
- *  1 : success
+ * radix_trie_insert_range:
+ *  map the keys lo .. hi of len bits to base + (key - lo), over what
+ *  they were mapped to. A trie made by radix_trie_create keeps the
+ *  range in a few blocks, others get a key at a time.
  */
-int
-radix_trie_delete(nod *n, uint32_t key, int len)
+nod*
+radix_trie_insert_range(nod *r, uint32_t lo, uint32_t hi, int len, void *base)
 {
-    int  r = 0;
-    int  i;
-    uint32_t k;
-
+    if (len <= 0 || len > 32 || lo > hi || (len < 32 && hi >> len))
+    {
+        WARNING("bad range %x .. %x of %d bits\n", lo, hi, len);
+        return r;
+    }
+    return radix_trie_insert_range_k(r, lo, hi, len, base);
+}
 
-    if (!n)
+nod*
+radix_trie_insert_range64(nod *r, uint64_t lo, uint64_t hi, int len, void *base)
+{
+    if (len <= 0 || len > KEYSIZE_MAX || lo > hi || (len < KEYSIZE_MAX && hi >> len))
+    {
+        WARNING("bad range of %d bits\n", len);
         return r;
+    }
+    return radix_trie_insert_range_k(r, lo, hi, len, base);
+}
 
-    if (len < KEYSIZE_MAX)
-        k = key << (KEYSIZE_MAX - len);
-    else
-        k = key;
+static
+void
+radix_trie_delete_all_r(struct radix_trie_ctx *ctx, nod *root)
+{
 
+    int i, n;
 
-    // search for key entry
-    if (n->crit_bit < len)
+    n = 1 << root->order;
+    for (i = 0; i < n; i++)
     {
-        nodetype nt;
 
-        // need to look up the node using partial key
-        i = radix_trie_find_slot(k, n->order, n->crit_bit);
-        nt = radix_trie_get_nodetype(n, i);
+        nodetype nt = radix_trie_get_nodetype (root, i);
+
         switch (nt)
         {
-            case n_internal:
-                r = radix_trie_delete(n->fan[i], key, len);
-                if (radix_trie_is_empty(n->fan[i]))
-                {
-                    free(n->fan[i]);
-                    radix_trie_set_nodetype(n, n_empty, i);
-                    // for debuging
-                    n->fan[i] = 0;
-                }
-                return r;
-            case n_composite:
-                if (n->crit_bit + n->order == len)
-                {
-                    radix_trie_set_nodetype(n, n_internal, i);
-                    r = 1;
-                }
-                else
-                {
-                    r = radix_trie_delete(n->fan[i], key, len);
 
+            case n_internal:
+                radix_trie_delete_all_r(ctx, *radix_trie_slot(root, i));
+                break;
 
-                    if (radix_trie_is_empty(n->fan[i]))
-                    {
-                        void *x = n->fan[i]->value;
-                        free(n->fan[i]);
-                        radix_trie_set_nodetype(n, n_external, i);
-                        n->fan[i] = x;
-                    }
-                }
+            case n_composite:
+                if (ctx->flags & RADIX_TRIE_SET)
+                    radix_trie_mem_free(ctx, (*radix_trie_slot(root, i))->value, RT_SET_LEAF);
+                radix_trie_delete_all_r(ctx, *radix_trie_slot(root, i));
                 break;
+
             case n_external:
-                // varify key is same
-                // they should be the same
-                // ..
-                // unset tag
-                radix_trie_set_nodetype(n, n_empty, i);
-                r = 1;
+                /* the leaf bitmaps of a set */
+                if (ctx->flags & RADIX_TRIE_SET)
+                    radix_trie_mem_free(ctx, *radix_trie_slot(root, i), RT_SET_LEAF);
                 break;
+
             default:
-                WARNING("%08X is not in the set\n", key);
                 break;
         }
     }
-    else if (n->crit_bit == len)
+    if (root->flags & RT_SKEY)
+        free(RT_SEG(root));
+    radix_trie_free_node(ctx, root);
+}
+
+/* a snapshot lets go of node n, which goes when no one else holds it */
+static
+void
+radix_trie_unref(struct radix_trie_ctx *ctx, nod *n)
+{
+    int i;
+
+    if (n->share)
     {
-        // just look up in the node
-        printf("%08X should be in this node\n", k);
+        n->share--;
+        return;
     }
-    else
+
+    for (i = 0; i < (1 << n->order); i++)
     {
-        WARNING("crit_bit = %d > len = %d\n", n->crit_bit, len);
-        return 0;
+        if (radix_trie_get_tag1(n, i))
+            radix_trie_unref(ctx, *radix_trie_slot(n, i));
     }
-    return r;
+    radix_trie_free_node(ctx, n);
 }
 
 void
 radix_trie_delete_all(nod *root)
 {
-
-    int i, n;
+    struct radix_trie_ctx *ctx;
 
     if (!root)
         return;
 
-    n = 1 << root->order;
-    for (i = 0; i < n; i++)
+    if (root->flags & RT_IMAGE)
     {
+        WARNING("%s\n", "an image goes with radix_trie_unmap");
+        return;
+    }
 
-        nodetype nt = radix_trie_get_nodetype (root, i);
+    ctx = radix_trie_ctx(root);
 
-        switch (nt)
+    if (ctx->origin)
+    {
+        /* a snapshot: nodes it held alone go, to the trie it was taken of */
+        int i;
+
+        for (i = 0; i < (1 << root->order); i++)
         {
+            if (radix_trie_get_tag1(root, i))
+                radix_trie_unref(ctx->origin, *radix_trie_slot(root, i));
+        }
+        ctx->origin->snapshots--;
+        radix_trie_range_free(ctx);
+        free(ctx);
+        return;
+    }
 
-            case n_internal:
-                radix_trie_delete_all(root->fan[i]);
-                break;
+    if (ctx->snapshots)
+        WARNING("%d snapshots of the trie are left\n", ctx->snapshots);
+    radix_trie_range_free(ctx);
 
-            case n_composite:
-                radix_trie_delete_all(root->fan[i]);
-                break;
+    if (ctx->set_short && !ctx->arena)
+        radix_trie_mem_free(ctx, ctx->set_short, RT_SET_SHORT);
 
-            default:
-                break;
+    if (ctx->shared)
+    {
+        /* readers must be done, the root's copy holds what is left */
+        nod *top = ctx->top;
+
+        radix_trie_shared_free(ctx);
+        if (top != root)
+        {
+            if (!ctx->arena)
+                radix_trie_delete_all_r(ctx, top);
+            radix_trie_free_node(ctx, root);
+            return;
+        }
+    }
+
+    /* nodes of an arena go away with their chunks */
+    if (ctx->arena)
+        radix_trie_free_node(ctx, root);
+    else
+        radix_trie_delete_all_r(ctx, root);
+}
+
+
+/*
+ * compaction of the nodes below *ref, n being the node there, in key
+ * order from the key ctx->compact on. A node is done once the slots
+ * below it are: the nodes below its internal slots that lead to a
+ * single node go, and it is copied to the size radix_trie_fit gives,
+ * if smaller. Each node done takes one off *budget, which is looked at
+ * before going down a slot. Returns 0 when out of budget, ctx->compact
+ * is then the first key of the slot it stopped at.
+ */
+static
+int
+radix_trie_compact_r(struct radix_trie_ctx *ctx, nod **ref, nod *n, int *budget)
+{
+    int end = n->crit_bit + n->order;
+    uint64_t base = n->key & radix_trie_prefix_mask(n->crit_bit);
+    int i, kind, cap;
+
+    for (i = 0; i < (1 << n->order); i++)
+    {
+        uint64_t from = base | (uint64_t)i << (KEYSIZE_MAX - end);
+        uint64_t last = end < KEYSIZE_MAX ? from | ~(uint64_t)0 >> end : from;
+        nodetype nt = radix_trie_get_nodetype(n, i);
+        nod **s = radix_trie_slot(n, i);
+
+        if (!radix_trie_get_tag1(n, i) || last < ctx->compact)
+            continue;
+
+        if (*budget <= 0)
+        {
+            if (from > ctx->compact)
+                ctx->compact = from;
+            return 0;
         }
+        if (!radix_trie_compact_r(ctx, s, *s, budget))
+            return 0;
+
+        while (nt == n_internal && radix_trie_collapse(ctx, ref, n, i))
+            n = *ref;
+    }
+    (*budget)--;
+
+    if (n->flags & RT_HEAD)
+        return 1;
+
+    kind = n->kind;
+    cap = radix_trie_fit(ctx, radix_trie_count(n), &kind);
+    if (cap < n->cap)
+    {
+        RT_STORE(ref, radix_trie_copy(ctx, n, kind, cap));
+        radix_trie_free_node(ctx, n);
     }
-    free(root);
+    return 1;
+}
+
+int
+radix_trie_compact(nod *root, int budget)
+{
+    struct radix_trie_ctx *ctx = radix_trie_ctx(root);
+    nod **ref = &root;
+    int done;
+
+    /* the path segments of string keys hang on where their parent ends */
+    if (!root || !(root->flags & RT_HEAD) || (root->flags & RT_SKEY) || radix_trie_readonly(root))
+        return 0;
+
+    /* nodes snapshots hold stay as they are, concurrent writers lock their own */
+    if (ctx->snapshots || (ctx->flags & RADIX_TRIE_CONCURRENT))
+        return 0;
+
+    if (ctx->shared)
+        ref = &ctx->top;
+
+    if (budget < 1)
+        budget = 1;
+    done = radix_trie_compact_r(ctx, ref, *ref, &budget);
+    if (done)
+        ctx->compact = 0;
+
+    if (ctx->shared)
+        radix_trie_reclaim(ctx);
+    return !done;
 }
 
 
@@ -850,15 +3301,154 @@ radix_trie_delete_all(nod *root)
  * radix_trie_destroy:
  *
  *  Use user provided destructor to delete all leaf objects
- *  Then, the tree is free'd
+ *  Then, the tree is free'd. The values of a string trie go to the
+ *  destructor with key 0 and bit 0.
  *
  */
 void
 radix_trie_destroy(nod *r, void (*fn)(uint32_t key, int bit, void *v))
 {
 
-    radix_trie_walk(r, fn);
+    if (r)
+        radix_trie_walk_r(radix_trie_top(r), fn, 0);
 
     radix_trie_delete_all(r);
 
 }
+
+
+/*
+ * radix_trie_stats:
+ *  the nodes are gone through from a stack of their own, each with its
+ *  level and the bit the node above it ends on, which a path segment
+ *  starts from.
+ */
+struct radix_trie_stats_item
+{
+    nod *n;
+    int level;
+    int parent;
+};
+
+int
+radix_trie_stats(nod *root, struct radix_trie_stats *st)
+{
+    struct radix_trie_stats_item *stack, *more;
+    struct radix_trie_ctx *ctx;
+    size_t used, size = 64;
+    int top = 0;
+
+    memset(st, 0, sizeof(*st));
+    if (!root)
+        return 0;
+
+    stack = (struct radix_trie_stats_item*)malloc(size * sizeof(*stack));
+    if (!stack)
+        return -1;
+
+    ctx = radix_trie_ctx(root);
+    if (root->flags & RT_HEAD)
+        st->bytes += CTX_SIZE + NODE_SIZE(MAP_SIZE);
+    if (ctx->set_short)
+        st->bytes += RT_SET_SHORT;
+    if (ctx->ranges)
+        st->bytes += radix_trie_range_bytes(ctx);
+
+    stack[top].n = radix_trie_top(root);
+    stack[top].level = 0;
+    stack[top++].parent = 0;
+
+    while (top)
+    {
+        struct radix_trie_stats_item it = stack[--top];
+        nod *n = it.n;
+        int l = it.level < RADIX_TRIE_STATS_LEVELS ? it.level : RADIX_TRIE_STATS_LEVELS - 1;
+        int i, slots = 1 << n->order;
+
+        st->nodes++;
+        st->slots += slots;
+        st->level_nodes[l]++;
+        st->level_slots[l] += slots;
+        st->level_used[l] += radix_trie_count(n);
+        if (it.level > st->depth)
+            st->depth = it.level;
+
+        if (n->flags & RT_IMAGE)
+            st->bytes += NODE_SIZE(n->cap);
+        else if (!(n->flags & RT_HEAD))
+            st->bytes += radix_trie_node_size(ctx, n->kind, n->cap);
+        if ((n->flags & RT_SKEY) && RT_SEG(n))
+            st->bytes += RT_SEG_SIZE(it.parent, n->crit_bit);
+
+        for (i = 0; i < slots; i++)
+        {
+            switch (radix_trie_get_nodetype(n, i))
+            {
+                case n_external:
+                    st->external++;
+                    st->level_keys[l]++;
+                    if (ctx->flags & RADIX_TRIE_SET)
+                        st->bytes += RT_SET_LEAF;
+                    continue;
+
+                case n_composite:
+                    st->composite++;
+                    st->level_keys[l]++;
+                    if (ctx->flags & RADIX_TRIE_SET)
+                        st->bytes += RT_SET_LEAF;
+                    break;
+
+                case n_internal:
+                    st->internal++;
+                    break;
+
+                default:
+                    continue;
+            }
+
+            if (top == (int)size)
+            {
+                more = (struct radix_trie_stats_item*)realloc(stack, 2 * size * sizeof(*stack));
+                if (!more)
+                {
+                    free(stack);
+                    return -1;
+                }
+                stack = more;
+                size *= 2;
+            }
+            stack[top].n = RT_CHILD(n, i);
+            stack[top].level = it.level + 1;
+            stack[top++].parent = n->crit_bit + n->order;
+        }
+    }
+    free(stack);
+
+    st->keys = st->external + st->composite;
+    used = st->keys + st->internal;
+    st->fill = st->slots ? (double)used / st->slots : 0;
+    st->bytes_per_key = st->keys ? (double)st->bytes / st->keys : 0;
+    return 0;
+}
+
+
+int
+radix_trie_counters(nod *root, struct radix_trie_counters *c)
+{
+#ifdef RADIX_TRIE_COUNTERS
+    struct radix_trie_ctx *ctx = radix_trie_ctx(root);
+
+    c->finds = RT_LOAD(&ctx->counters.finds);
+    c->find_misses = RT_LOAD(&ctx->counters.find_misses);
+    c->find_nodes = RT_LOAD(&ctx->counters.find_nodes);
+    c->inserts = RT_LOAD(&ctx->counters.inserts);
+    c->splits = RT_LOAD(&ctx->counters.splits);
+    c->composites = RT_LOAD(&ctx->counters.composites);
+    c->deletes = RT_LOAD(&ctx->counters.deletes);
+    c->delete_frees = RT_LOAD(&ctx->counters.delete_frees);
+    return 0;
+#else
+    memset(c, 0, sizeof(*c));
+    return -1;
+#endif
+}
@@ -40,6 +40,7 @@ typedef unsigned __int64 uint64_t;
 #include <stdint.h>
 #define INLINE inline
 #endif
+#include <stddef.h>
 
 
 
@@ -55,6 +56,45 @@ typedef struct node nod;
 #define EXTERNC extern
 #endif
 
+/*
+ * node layout, given to radix_trie_create()
+ *
+ * RADIX_TRIE_AUTO     nodes start compact, and become full when most
+ *                     slots are taken.
+ * RADIX_TRIE_FULL     every node has all 1 << order slots.
+ * RADIX_TRIE_COMPACT  nodes only keep the occupied slots.
+ *
+ * Tries grown from a NULL root use RADIX_TRIE_AUTO.
+ *
+ * RADIX_TRIE_ARENA, or'ed with one of the above, takes the nodes from
+ * large chunks owned by the trie instead of malloc, deleted nodes are
+ * kept on free lists for reuse, and radix_trie_delete_all frees the
+ * chunks without walking the trie.
+ *
+ * RADIX_TRIE_SHARED, or'ed in as well, lets threads look up keys while
+ * one thread inserts and deletes, see radix_trie_reader_new.
+ * RADIX_TRIE_CONCURRENT is RADIX_TRIE_SHARED with any number of threads
+ * inserting and deleting, each one as a reader too, and no arena.
+ *
+ * RADIX_TRIE_SET, or'ed in, makes a set of keys with no values, changed
+ * and looked up with radix_trie_set_*. Not with RADIX_TRIE_SHARED.
+ *
+ * RADIX_TRIE_ORDER(n), or'ed in too, gives the nodes of the trie 1 << n
+ * slots each, n from 1 to RADIX_ORDER_MAX (5 unless built otherwise).
+ * Fewer slots take less memory for sparse keys, more slots take fewer
+ * steps down for dense ones. Without it the order is RADIX_ORDER.
+ */
+#define RADIX_TRIE_AUTO     0
+#define RADIX_TRIE_FULL     1
+#define RADIX_TRIE_COMPACT  2
+#define RADIX_TRIE_ARENA    4
+#define RADIX_TRIE_SHARED   8
+#define RADIX_TRIE_CONCURRENT 16
+#define RADIX_TRIE_SET      32
+#define RADIX_TRIE_ORDER(n) ((n) << 8)
+
+EXTERNC nod* radix_trie_create(int flags);
+
 EXTERNC nod* radix_trie_insert(nod *r, uint32_t key, int length, void *value);
 
 EXTERNC void radix_trie_walk(nod *root, void (*fn)(uint32_t key, int bit, void *v));
@@ -64,8 +104,344 @@ EXTERNC int radix_trie_find(nod *root, uint32_t key, int len, void **val);
 
 EXTERNC int radix_trie_delete(nod *n, uint32_t key, int len);
 
+/*
+ * longest prefix match: the value of the longest key stored that is a
+ * prefix of "key", its length in matched_len, in one descent.
+ */
+EXTERNC int radix_trie_lpm(nod *root, uint32_t key, int *matched_len, void **val);
+
 EXTERNC void radix_trie_delete_all(nod *root);
 
+/*
+ * radix_trie_compact: a step of a pass over a trie of integer keys made
+ * by radix_trie_create, of about "budget" nodes, in key order from where
+ * the last step stopped. Nodes left leading to a single node are taken
+ * out, as deletes do, and nodes bigger than their slots need are
+ * copied to their size. Returns 1 while the pass goes on, 0 once it
+ * is over, the next call starts another. Called by the writer of a
+ * shared trie; does nothing while snapshots are held, nor on a
+ * RADIX_TRIE_CONCURRENT trie.
+ */
+EXTERNC int radix_trie_compact(nod *root, int budget);
+
+EXTERNC void radix_trie_destroy(nod *r, void (*fn)(uint32_t key, int bit, void *v));
+
+
+/*
+ * 64 bit keys, of length 1 to 64 bit. They share the tree with the
+ * 32 bit calls above, a 32 bit key is a 64 bit key of the same value
+ * and length. radix_trie_walk64 hands out keys aligned on the most
+ * significant bit of an uint64_t.
+ */
+EXTERNC nod* radix_trie_insert64(nod *r, uint64_t key, int length, void *value);
+
+EXTERNC int radix_trie_find64(nod *root, uint64_t key, int len, void **val);
+
+EXTERNC int radix_trie_delete64(nod *n, uint64_t key, int len);
+
+EXTERNC int radix_trie_lpm64(nod *root, uint64_t key, int *matched_len, void **val);
+
+EXTERNC void radix_trie_walk64(nod *root, void (*fn)(uint64_t key, int bit, void *v));
+
+
+/*
+ * ranges of keys, such as the cidrange and bfrange blocks of a CMap:
+ * the keys lo .. hi of len bits are mapped to base, base + 1, ..., the
+ * value of key k being (void*)((uintptr_t)base + (k - lo)), over what
+ * they were mapped to. A trie made by radix_trie_create keeps a range
+ * as a few aligned blocks of keys, a block an entry; radix_trie_find,
+ * find64 and the batch lookups find the keys in them, an insert or a
+ * delete of a key in a range changes that key alone. Walks, cursors
+ * and lpm hand out the keys inserted one by one only, and a trie with
+ * ranges is not saved or frozen. Other tries get the keys one by one.
+ */
+EXTERNC nod* radix_trie_insert_range(nod *r, uint32_t lo, uint32_t hi, int len, void *base);
+
+EXTERNC nod* radix_trie_insert_range64(nod *r, uint64_t lo, uint64_t hi, int len, void *base);
+
+
+/*
+ * cursors, over the entries in the order radix_trie_walk hands them
+ * out: on their bits, and a key before the longer keys it is a prefix
+ * of. A cursor is kept by the caller, on the stack is fine, it holds
+ * its path down the trie, so a scan of a range costs the depth of the
+ * trie and the entries in it. Once positioned, key (aligned on the most
+ * significant bit, as by radix_trie_walk64), len and value are those of
+ * the entry. The trie must not change while a cursor is in use.
+ */
+#define RADIX_TRIE_CURSOR_DEPTH 64
+
+typedef struct radix_trie_cursor
+{
+    uint64_t key;
+    int      len;
+    void    *value;
+
+    int      depth;
+    nod     *path[RADIX_TRIE_CURSOR_DEPTH];
+    unsigned char slot[RADIX_TRIE_CURSOR_DEPTH];
+} radix_trie_cursor;
+
+EXTERNC int radix_trie_lower_bound(radix_trie_cursor *c, nod *root, uint32_t key, int len);
+
+EXTERNC int radix_trie_upper_bound(radix_trie_cursor *c, nod *root, uint32_t key, int len);
+
+EXTERNC int radix_trie_lower_bound64(radix_trie_cursor *c, nod *root, uint64_t key, int len);
+
+EXTERNC int radix_trie_upper_bound64(radix_trie_cursor *c, nod *root, uint64_t key, int len);
+
+EXTERNC int radix_trie_first(radix_trie_cursor *c, nod *root);
+
+EXTERNC int radix_trie_last(radix_trie_cursor *c, nod *root);
+
+EXTERNC int radix_trie_next(radix_trie_cursor *c);
+
+EXTERNC int radix_trie_prev(radix_trie_cursor *c);
+
+
+/*
+ * readers of a RADIX_TRIE_SHARED trie, of 32 and 64 bit keys. A single
+ * writer changes the trie, readers take no lock: a changed node is
+ * copied, the copy put in its place, and the old one freed once no
+ * reader can see it. Each reading thread gets a reader, and puts its
+ * lookups, walks and cursor scans between radix_trie_read_begin and
+ * radix_trie_read_end; a cursor is not used past read_end. Readers are
+ * freed with the trie, which is deleted once they are done.
+ * Writers of a RADIX_TRIE_CONCURRENT trie insert and delete between
+ * read_begin and read_end of their own reader as well.
+ */
+typedef struct radix_trie_reader radix_trie_reader;
+
+EXTERNC radix_trie_reader* radix_trie_reader_new(nod *root);
+
+EXTERNC void radix_trie_reader_free(radix_trie_reader *rd);
+
+EXTERNC void radix_trie_read_begin(radix_trie_reader *rd);
+
+EXTERNC void radix_trie_read_end(radix_trie_reader *rd);
+
+
+/*
+ * a snapshot of a trie of integer keys, taken in constant time: the
+ * trie as it is now, for lookups, walks and cursors, from any thread
+ * and with no reader. It shares the nodes of the trie, which copies a
+ * node a snapshot holds before changing it. Snapshots are taken and
+ * freed with radix_trie_delete_all by the writer, before the trie
+ * itself. Not for RADIX_TRIE_CONCURRENT tries.
+ */
+EXTERNC nod* radix_trie_snapshot(nod *root);
+
+
+/*
+ * images of a trie of integer keys, in radix-trie-image.c. A saved
+ * image holds no pointers, radix_trie_map maps it read only and gives
+ * a root for lookups, walks and cursors, shared by all processes that
+ * map it. Values are saved as their bits, for values that are numbers
+ * or offsets. The image is of the build that saved it, its RADIX_ORDER_MAX
+ * and byte order, and is released with radix_trie_unmap. Every node is
+ * checked once when mapped, a file cut short or of bad nodes is not
+ * mapped; one changed while mapped is not checked again.
+ */
+EXTERNC int radix_trie_save(nod *root, const char *path);
+
+EXTERNC nod* radix_trie_map(const char *path);
+
+EXTERNC void radix_trie_unmap(nod *root);
+
+
+/*
+ * frozen tries, in radix-trie-freeze.c: a read only copy of a trie of
+ * integer keys, for maps built once. Nodes have no slots, the node or
+ * the value a slot leads to is found by counting the bits of the slot
+ * bitmaps, and values take the bytes the largest one needs. The trie
+ * is not changed, and can be freed once frozen.
+ */
+typedef struct radix_trie_frozen radix_trie_frozen;
+
+EXTERNC radix_trie_frozen* radix_trie_freeze(nod *root);
+
+EXTERNC void radix_trie_frozen_free(radix_trie_frozen *f);
+
+EXTERNC size_t radix_trie_frozen_size(const radix_trie_frozen *f);
+
+EXTERNC int radix_trie_frozen_find(const radix_trie_frozen *f, uint32_t key, int len, void **val);
+
+EXTERNC int radix_trie_frozen_find64(const radix_trie_frozen *f, uint64_t key, int len, void **val);
+
+EXTERNC void radix_trie_frozen_walk64(const radix_trie_frozen *f, void (*fn)(uint64_t key, int bit, void *v));
+
+
+/*
+ * lookups of n keys at once, of length lens[i], or 32 (64) bits when
+ * lens is NULL. found[i] is set to 1 when keys[i] is found, its value
+ * is then in vals[i]. The lookups go down the trie together, so their
+ * cache misses overlap. Returns the number of keys found.
+ */
+EXTERNC size_t radix_trie_find_batch(nod *root, const uint32_t *keys, const int *lens, size_t n,
+                                     void **vals, int *found);
+
+EXTERNC size_t radix_trie_find_batch64(nod *root, const uint64_t *keys, const int *lens, size_t n,
+                                       void **vals, int *found);
+
+
+/*
+ * bulk load of a NULL or empty trie, from keys in the order of
+ * radix_trie_walk, of length lens[i], or 32 (64) bits when lens is
+ * NULL. The trie is the one n inserts would give, built in one pass.
+ */
+EXTERNC nod* radix_trie_build_sorted(nod *r, const uint32_t *keys, const int *lens, void **values, size_t n);
+
+EXTERNC nod* radix_trie_build_sorted64(nod *r, const uint64_t *keys, const int *lens, void **values, size_t n);
+
+/*
+ * bulk load on threads, in radix-trie-parallel.c: keys in any order,
+ * into a NULL or empty trie, as by radix_trie_build_sorted, on
+ * nthreads threads (0 for one per cpu). The keys are split by their
+ * first bits, deeper where they are many, and each part is built as a
+ * subtree of its own, in a thread that takes the next part when done.
+ * For the same key given twice the last value is kept. Shared tries,
+ * sets, tries with ranges and tries that are not empty get the keys
+ * one by one. Needs -pthread.
+ */
+EXTERNC nod* radix_trie_build_parallel(nod *r, const uint32_t *keys, const int *lens, void **values,
+                                       size_t n, int nthreads);
+
+EXTERNC nod* radix_trie_build_parallel64(nod *r, const uint64_t *keys, const int *lens, void **values,
+                                         size_t n, int nthreads);
+
+/*
+ * walk and teardown on threads, in radix-trie-parallel.c, nthreads as
+ * above. The subtrees of the upper levels are shared out, and a thread
+ * out of work takes over part of the subtrees another has yet to go
+ * through. fn gets the thread it runs on, 0 to nthreads - 1, and arg,
+ * so each thread can add up in a place of its own without locks. The
+ * entries come in no set order, on all threads at once; with
+ * RADIX_TRIE_WALK_ORDERED they come in the order of radix_trie_walk,
+ * one call at a time, the entries of a subtree walked ahead of its
+ * turn kept until then. radix_trie_destroy_parallel calls fn for each
+ * entry, in no set order, and frees the trie on the same threads;
+ * snapshots, tries with snapshots, shared tries and tries of an arena
+ * are walked on threads and freed as by radix_trie_delete_all.
+ */
+#define RADIX_TRIE_WALK_ORDERED 1
+
+EXTERNC void radix_trie_walk_parallel(nod *root, void (*fn)(uint32_t key, int bit, void *v, int thread, void *arg),
+                                      void *arg, int nthreads, int flags);
+
+EXTERNC void radix_trie_walk_parallel64(nod *root, void (*fn)(uint64_t key, int bit, void *v, int thread, void *arg),
+                                        void *arg, int nthreads, int flags);
+
+EXTERNC void radix_trie_destroy_parallel(nod *r, void (*fn)(uint32_t key, int bit, void *v, int thread, void *arg),
+                                         void *arg, int nthreads);
+
+EXTERNC void radix_trie_delete_all_parallel(nod *root, int nthreads);
+
+
+/*
+ * byte string keys, of 1 to RADIX_TRIE_STR_MAX bytes, any byte value.
+ * A trie holds either string keys or integer keys, never both, and is
+ * freed with radix_trie_delete_all, or radix_trie_destroy(_parallel)
+ * which hand each value with key 0 and bit 0. radix_trie_walk_str, not
+ * radix_trie_walk(_parallel), hands out the entries starting with
+ * "prefix" (all of them for len 0) in the byte order of their keys.
+ */
+#define RADIX_TRIE_STR_MAX  8191
+
+EXTERNC nod* radix_trie_insert_str(nod *r, const void *key, size_t len, void *value);
+
+EXTERNC int radix_trie_find_str(nod *root, const void *key, size_t len, void **val);
+
+EXTERNC int radix_trie_delete_str(nod *n, const void *key, size_t len);
+
+EXTERNC void radix_trie_walk_str(nod *root, const void *prefix, size_t len,
+                                 void (*fn)(const void *key, size_t len, void *v));
+
+
+/*
+ * the shape of a trie, taken in one pass over its nodes: how many
+ * there are, how full their slots are, level by level from the root
+ * at level 0, and at which level its keys are. bytes are those of the
+ * nodes, their index and path segments, and of the trie's own context;
+ * a snapshot counts the nodes it shares as well. Levels past
+ * RADIX_TRIE_STATS_LEVELS - 1 are counted in the last one, depth is
+ * the real one. Returns 0, or -1 when out of memory. The trie must not
+ * change while this runs, a reader of a shared trie calls it between
+ * read_begin and read_end.
+ */
+#define RADIX_TRIE_STATS_LEVELS 65
+
+struct radix_trie_stats
+{
+    size_t nodes;
+    size_t slots;                 /* of the nodes, 1 << order each */
+    size_t internal;              /* slots leading to a node */
+    size_t external;              /* slots holding a value */
+    size_t composite;             /* slots holding a value and leading to a node */
+    size_t keys;                  /* external + composite */
+    size_t bytes;
+    double fill;                  /* occupied slots over slots */
+    double bytes_per_key;
+    int    depth;                 /* levels below the root */
+
+    size_t level_nodes[RADIX_TRIE_STATS_LEVELS];
+    size_t level_slots[RADIX_TRIE_STATS_LEVELS];
+    size_t level_used[RADIX_TRIE_STATS_LEVELS];
+    size_t level_keys[RADIX_TRIE_STATS_LEVELS];   /* the depth histogram */
+};
+
+EXTERNC int radix_trie_stats(nod *root, struct radix_trie_stats *st);
+
+
+/*
+ * sets, in radix-trie-set.c: a trie made with RADIX_TRIE_SET holds keys
+ * of 1 to 64 bits and no values. The last 8 bits of a key are a bit of
+ * a 256 bit leaf, the value of the key of the bits before them, so a
+ * lookup ends in a bit test, and a dense set takes about a bit a key.
+ * Keys are as those of radix_trie_insert64. radix_trie_set_walk hands
+ * out the keys as radix_trie_walk64, with no value, those of a leaf
+ * together. Union, intersection and difference change "a" to hold
+ * those of a and b, a leaf a word at a time. radix_trie_stats counts
+ * the leaves, a key of it being a leaf.
+ */
+EXTERNC int radix_trie_set_add(nod *r, uint64_t key, int len);
+
+EXTERNC int radix_trie_set_has(nod *root, uint64_t key, int len);
+
+EXTERNC int radix_trie_set_remove(nod *r, uint64_t key, int len);
+
+EXTERNC size_t radix_trie_set_count(nod *root);
+
+EXTERNC void radix_trie_set_walk(nod *root, void (*fn)(uint64_t key, int bit, void *v));
+
+EXTERNC int radix_trie_set_union(nod *a, nod *b);
+
+EXTERNC int radix_trie_set_intersect(nod *a, nod *b);
+
+EXTERNC int radix_trie_set_subtract(nod *a, nod *b);
+
+
+/*
+ * counts of what lookups, inserts and deletes of integer keys did to a
+ * trie, since it was created. They are kept when the library is built
+ * with -DRADIX_TRIE_COUNTERS, and cost nothing otherwise; tries grown
+ * from a NULL root share one set. Threads add to them with relaxed
+ * atomics, so a count read while others change it may be a little
+ * behind. Returns 0, or -1, with all counts 0, when not built in.
+ */
+struct radix_trie_counters
+{
+    uint64_t finds;               /* radix_trie_find*() and batched lookups */
+    uint64_t find_misses;
+    uint64_t find_nodes;          /* nodes the finds went through */
+    uint64_t inserts;
+    uint64_t splits;              /* nodes made to hold a key leaving a path */
+    uint64_t composites;          /* slots made composite by inserts */
+    uint64_t deletes;
+    uint64_t delete_frees;        /* nodes freed by deletes */
+};
+
+EXTERNC int radix_trie_counters(nod *root, struct radix_trie_counters *c);
+
 
 
 // Helpers
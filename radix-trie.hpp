@@ -0,0 +1,767 @@
+/*
+Copyright (c) 2014 Dakai Liu
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+
+#ifndef RADIX_TRIE_HPP
+#define RADIX_TRIE_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <cstddef>
+#include <new>
+#include <algorithm>
+#include <utility>
+#include <iterator>
+#include <type_traits>
+
+
+/*
+  radix_trie<Key, Value, Order, Bits>: the radix trie of radix-trie.c
+  for C++, header only, for keys of one length, "Bits", the keys that
+  radix_trie_insert64(r, key, Bits, value) takes.
+
+  Nodes span Order bits, aligned from the end of the key, and skip the
+  bits no other key tells apart, as in radix-trie.c. Slots are compact,
+  found by the popcount of the slot bitmap below them. With one key
+  length a node holds either nodes or values, never both: the nodes
+  ending at the last bit hold the values, typed, in place of the
+  void * of the C interface.
+
+  Order and Bits are constants, so the slot of a key in a node is two
+  shifts, and the loop down the trie tests no order and no key length.
+  The first node, of the bits left over by Order, is taken before the
+  loop.
+
+  Values are moved when a node grows or shrinks, pointers to them are
+  good until the next insert_or_assign or erase. Values whose moves may
+  throw are copied into a new node instead; when a value or the memory
+  for a node throws, insert_or_assign and erase leave the trie as it
+  was.
+ */
+
+template <class Key, class Value, int Order = 4, int Bits = 8 * sizeof(Key)>
+class radix_trie
+{
+    static_assert(std::is_integral<Key>::value && std::is_unsigned<Key>::value, "keys are unsigned integers");
+    static_assert(Order >= 1 && Order <= 6, "order is 1 to 6");
+    static_assert(Bits > Order && Bits <= 64 && Bits <= 8 * (int)sizeof(Key), "Bits is Order + 1 to the width of Key");
+    static_assert(alignof(Value) <= alignof(std::max_align_t), "values are aligned as malloc aligns");
+
+    typedef typename std::conditional<(Order > 5), uint64_t, uint32_t>::type tag_t;
+
+    /* the bits of the first node, the last node starts at LAST */
+    static const int TOP = Bits % Order ? Bits % Order : Order;
+    static const int LAST = Bits - Order;
+    static const int DEPTH = (Bits - TOP) / Order + 1;
+
+    struct node
+    {
+        uint64_t key;           /* the bits before crit_bit, the rest 0 */
+        tag_t tag;              /* occupied slots */
+        unsigned char crit_bit;
+        unsigned char order;
+        unsigned char cap;      /* room in the slots */
+    };
+
+    /* the slots follow the node, nodes or values */
+    static const size_t SLOTS = (sizeof(node) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+    node  *root_;
+    size_t size_;
+
+    static int
+    popcount(uint64_t x)
+    {
+#if defined(__GNUC__)
+        return __builtin_popcountll(x);
+#else
+        x = x - ((x >> 1) & 0x5555555555555555ULL);
+        x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+        x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+        return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+    }
+
+    static int
+    clz(uint64_t x)
+    {
+#if defined(__GNUC__)
+        return __builtin_clzll(x);
+#else
+        int n = 0;
+
+        while (!(x & (uint64_t)1 << 63))
+        {
+            x <<= 1;
+            n++;
+        }
+        return n;
+#endif
+    }
+
+    /* keys are kept aligned on the most significant bit */
+    static uint64_t
+    left(Key key)
+    {
+        return (uint64_t)key << (64 - Bits);
+    }
+
+    static uint64_t
+    prefix_mask(int crit_bit)
+    {
+        return crit_bit ? ~(uint64_t)0 << (64 - crit_bit) : 0;
+    }
+
+    /* slot of k in a node of order o at crit_bit */
+    template <int o>
+    static int
+    slot(uint64_t k, int crit_bit)
+    {
+        return (int)((k << crit_bit) >> (64 - o));
+    }
+
+    static int
+    rank(const node *n, tag_t bit)
+    {
+        return popcount(n->tag & (bit - 1));
+    }
+
+    static bool
+    is_leaf(const node *n)
+    {
+        return n->crit_bit == LAST;
+    }
+
+    static node**
+    children(node *n)
+    {
+        return reinterpret_cast<node**>(reinterpret_cast<char*>(n) + SLOTS);
+    }
+
+    static node* const*
+    children(const node *n)
+    {
+        return reinterpret_cast<node* const*>(reinterpret_cast<const char*>(n) + SLOTS);
+    }
+
+    static Value*
+    values(node *n)
+    {
+        return reinterpret_cast<Value*>(reinterpret_cast<char*>(n) + SLOTS);
+    }
+
+    static const Value*
+    values(const node *n)
+    {
+        return reinterpret_cast<const Value*>(reinterpret_cast<const char*>(n) + SLOTS);
+    }
+
+    static node*
+    alloc(uint64_t key, int crit_bit, int order, int cap)
+    {
+        size_t slot = crit_bit == LAST ? sizeof(Value) : sizeof(node*);
+        node *n = static_cast<node*>(::operator new(SLOTS + cap * slot));
+
+        n->key = key & prefix_mask(crit_bit);
+        n->tag = 0;
+        n->crit_bit = (unsigned char)crit_bit;
+        n->order = (unsigned char)order;
+        n->cap = (unsigned char)cap;
+        return n;
+    }
+
+    static void
+    free_node(node *n)
+    {
+        if (is_leaf(n))
+        {
+            Value *v = values(n);
+
+            for (int i = popcount(n->tag) - 1; i >= 0; i--)
+                v[i].~Value();
+        }
+        ::operator delete(n);
+    }
+
+    static void
+    free_r(node *n)
+    {
+        if (!is_leaf(n))
+        {
+            node **c = children(n);
+
+            for (int i = popcount(n->tag) - 1; i >= 0; i--)
+                free_r(c[i]);
+        }
+        free_node(n);
+    }
+
+    /* moves that may throw would leave a node half moved, nodes of such values are copied */
+    template <class T>
+    struct in_place
+    {
+        static const bool value = std::is_nothrow_move_constructible<T>::value &&
+                                  std::is_nothrow_move_assignable<T>::value;
+    };
+
+    /*
+     * put x in slot "bit" of n, at position r of the slots, in a larger
+     * copy of n when it is full. *ref is where n is kept. When a value
+     * throws, n is left as it was.
+     */
+    template <class T, class V>
+    static void
+    add(node **ref, tag_t bit, int r, V &&x)
+    {
+        node *n = *ref;
+        int count = popcount(n->tag);
+        T *s = reinterpret_cast<T*>(reinterpret_cast<char*>(n) + SLOTS);
+
+        if (count == n->cap || !in_place<T>::value)
+        {
+            node *m = alloc(n->key, n->crit_bit, n->order, count == n->cap ? 2 * n->cap : n->cap);
+            T *d = reinterpret_cast<T*>(reinterpret_cast<char*>(m) + SLOTS);
+            int i = 0;
+
+            try
+            {
+                new (&d[r]) T(std::forward<V>(x));
+            }
+            catch (...)
+            {
+                ::operator delete(m);
+                throw;
+            }
+            try
+            {
+                for (; i < count; i++)
+                    new (&d[i < r ? i : i + 1]) T(std::move_if_noexcept(s[i]));
+            }
+            catch (...)
+            {
+                while (i-- > 0)
+                    d[i < r ? i : i + 1].~T();
+                d[r].~T();
+                ::operator delete(m);
+                throw;
+            }
+            for (i = 0; i < count; i++)
+                s[i].~T();
+            m->tag = n->tag | bit;
+            ::operator delete(n);
+            *ref = m;
+            return;
+        }
+
+        if (r == count)
+        {
+            new (&s[r]) T(std::forward<V>(x));
+        }
+        else
+        {
+            T t(std::forward<V>(x));
+
+            new (&s[count]) T(std::move(s[count - 1]));
+            std::move_backward(s + r, s + count - 1, s + count);
+            s[r] = std::move(t);
+        }
+        n->tag |= bit;
+    }
+
+    /* take slot "bit", at position r, out of n, in a smaller copy when a quarter is used */
+    template <class T>
+    static void
+    remove(node **ref, tag_t bit, int r)
+    {
+        node *n = *ref;
+        int count = popcount(n->tag);
+        T *s = reinterpret_cast<T*>(reinterpret_cast<char*>(n) + SLOTS);
+        bool shrink = n->cap > 4 && count - 1 <= n->cap / 4;
+
+        if (shrink || !in_place<T>::value)
+        {
+            node *m = alloc(n->key, n->crit_bit, n->order, shrink ? n->cap / 2 : n->cap);
+            T *d = reinterpret_cast<T*>(reinterpret_cast<char*>(m) + SLOTS);
+            int i, j = 0;
+
+            try
+            {
+                for (i = 0; i < count; i++)
+                {
+                    if (i == r)
+                        continue;
+                    new (&d[j]) T(std::move_if_noexcept(s[i]));
+                    j++;
+                }
+            }
+            catch (...)
+            {
+                while (j-- > 0)
+                    d[j].~T();
+                ::operator delete(m);
+                throw;
+            }
+            for (i = 0; i < count; i++)
+                s[i].~T();
+            m->tag = n->tag & ~bit;
+            ::operator delete(n);
+            *ref = m;
+            return;
+        }
+
+        std::move(s + r + 1, s + count, s + r);
+        s[count - 1].~T();
+        n->tag &= ~bit;
+    }
+
+    /* a node at the last bits holding the value of k */
+    template <class V>
+    static node*
+    leaf(uint64_t k, V &&v)
+    {
+        node *n = alloc(k, LAST, Order, 1);
+
+        try
+        {
+            new (values(n)) Value(std::forward<V>(v));
+        }
+        catch (...)
+        {
+            ::operator delete(n);
+            throw;
+        }
+        n->tag = (tag_t)1 << slot<Order>(k, LAST);
+        return n;
+    }
+
+    template <class V>
+    bool
+    put(Key key, V &&v)
+    {
+        uint64_t k = left(key);
+        node **ref = &root_;
+        node *n = root_;
+        tag_t bit;
+        int r;
+
+        if (!n)
+            n = root_ = alloc(0, 0, TOP, 1);
+
+        bit = (tag_t)1 << slot<TOP>(k, 0);
+        for (;;)
+        {
+            r = rank(n, bit);
+            if (is_leaf(n))
+            {
+                if (n->tag & bit)
+                {
+                    values(n)[r] = std::forward<V>(v);
+                    return false;
+                }
+                add<Value>(ref, bit, r, std::forward<V>(v));
+                break;
+            }
+
+            if (!(n->tag & bit))
+            {
+                node *x = leaf(k, std::forward<V>(v));
+
+                try
+                {
+                    add<node*>(ref, bit, r, x);
+                }
+                catch (...)
+                {
+                    free_node(x);
+                    throw;
+                }
+                break;
+            }
+
+            node **cref = &children(n)[r];
+            node *c = *cref;
+            uint64_t diff = (k ^ c->key) & prefix_mask(c->crit_bit);
+
+            if (diff)
+            {
+                /* k leaves the path of c before c, a node goes where they part */
+                int d = clz(diff);
+                int s = Bits - (Bits - d + Order - 1) / Order * Order;
+                node *x = leaf(k, std::forward<V>(v));
+                node *m;
+
+                try
+                {
+                    m = alloc(k, s, Order, 2);
+                }
+                catch (...)
+                {
+                    free_node(x);
+                    throw;
+                }
+                int a = slot<Order>(c->key, s), b = slot<Order>(k, s);
+
+                children(m)[a > b] = c;
+                children(m)[a < b] = x;
+                m->tag = (tag_t)1 << a | (tag_t)1 << b;
+                *cref = m;
+                break;
+            }
+
+            ref = cref;
+            n = c;
+            bit = (tag_t)1 << slot<Order>(k, n->crit_bit);
+        }
+
+        size_++;
+        return true;
+    }
+
+public:
+    typedef Key key_type;
+    typedef Value mapped_type;
+
+    template <bool Const>
+    class basic_iterator
+    {
+        friend class radix_trie;
+
+        node *path_[DEPTH];
+        int   slot_[DEPTH];
+        int   depth_;
+
+        /* from slot i of the node on top on, the first value */
+        void
+        first(int i)
+        {
+            for (;;)
+            {
+                node *n = path_[depth_ - 1];
+                uint64_t more = i < 64 ? (uint64_t)n->tag >> i : 0;
+
+                if (!more)
+                {
+                    if (--depth_ == 0)
+                        return;
+                    i = slot_[depth_ - 1] + 1;
+                    continue;
+                }
+                i += popcount((more & -more) - 1);
+                slot_[depth_ - 1] = i;
+                if (is_leaf(n))
+                    return;
+                path_[depth_++] = children(n)[rank(n, (tag_t)1 << i)];
+                i = 0;
+            }
+        }
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<Key, typename std::conditional<Const, const Value&, Value&>::type> value_type;
+        typedef value_type reference;
+        typedef std::ptrdiff_t difference_type;
+        typedef void pointer;
+
+        basic_iterator() : depth_(0) {}
+
+        Key
+        key() const
+        {
+            const node *n = path_[depth_ - 1];
+            int end = n->crit_bit + n->order;
+
+            return (Key)((n->key | (uint64_t)slot_[depth_ - 1] << (64 - end)) >> (64 - Bits));
+        }
+
+        typename std::conditional<Const, const Value&, Value&>::type
+        value() const
+        {
+            node *n = path_[depth_ - 1];
+
+            return values(n)[rank(n, (tag_t)1 << slot_[depth_ - 1])];
+        }
+
+        reference
+        operator*() const
+        {
+            return reference(key(), value());
+        }
+
+        basic_iterator&
+        operator++()
+        {
+            first(slot_[depth_ - 1] + 1);
+            return *this;
+        }
+
+        basic_iterator
+        operator++(int)
+        {
+            basic_iterator x = *this;
+
+            ++*this;
+            return x;
+        }
+
+        bool
+        operator==(const basic_iterator &o) const
+        {
+            return depth_ == o.depth_ && (!depth_ ||
+                   (path_[depth_ - 1] == o.path_[depth_ - 1] && slot_[depth_ - 1] == o.slot_[depth_ - 1]));
+        }
+
+        bool
+        operator!=(const basic_iterator &o) const
+        {
+            return !(*this == o);
+        }
+    };
+
+    typedef basic_iterator<false> iterator;
+    typedef basic_iterator<true> const_iterator;
+
+    radix_trie() : root_(0), size_(0) {}
+
+    ~radix_trie()
+    {
+        clear();
+    }
+
+    radix_trie(const radix_trie&) = delete;
+    radix_trie& operator=(const radix_trie&) = delete;
+
+    radix_trie(radix_trie &&o) noexcept : root_(o.root_), size_(o.size_)
+    {
+        o.root_ = 0;
+        o.size_ = 0;
+    }
+
+    radix_trie&
+    operator=(radix_trie &&o) noexcept
+    {
+        if (this != &o)
+        {
+            clear();
+            swap(o);
+        }
+        return *this;
+    }
+
+    void
+    swap(radix_trie &o) noexcept
+    {
+        std::swap(root_, o.root_);
+        std::swap(size_, o.size_);
+    }
+
+    size_t
+    size() const
+    {
+        return size_;
+    }
+
+    bool
+    empty() const
+    {
+        return size_ == 0;
+    }
+
+    void
+    clear()
+    {
+        if (root_)
+            free_r(root_);
+        root_ = 0;
+        size_ = 0;
+    }
+
+    /* the value of key, NULL when not there */
+    const Value*
+    find(Key key) const
+    {
+        uint64_t k = left(key);
+        const node *n = root_;
+        tag_t bit;
+
+        if (!n)
+            return 0;
+
+        bit = (tag_t)1 << slot<TOP>(k, 0);
+        for (;;)
+        {
+            if (!(n->tag & bit))
+                return 0;
+            if (is_leaf(n))
+                break;
+            n = children(n)[rank(n, bit)];
+            bit = (tag_t)1 << slot<Order>(k, n->crit_bit);
+        }
+
+        /* slots only index the key, the skipped bits are checked here */
+        if ((k ^ n->key) & prefix_mask(LAST))
+            return 0;
+        return &values(n)[rank(n, bit)];
+    }
+
+    Value*
+    find(Key key)
+    {
+        return const_cast<Value*>(static_cast<const radix_trie*>(this)->find(key));
+    }
+
+    bool
+    contains(Key key) const
+    {
+        return find(key) != 0;
+    }
+
+    /* true for a new key, false when the value of key is replaced */
+    bool
+    insert_or_assign(Key key, const Value &v)
+    {
+        return put(key, v);
+    }
+
+    bool
+    insert_or_assign(Key key, Value &&v)
+    {
+        return put(key, std::move(v));
+    }
+
+    /* false when key is not there */
+    bool
+    erase(Key key)
+    {
+        uint64_t k = left(key);
+        node **ref[DEPTH];
+        tag_t bit[DEPTH];
+        int r[DEPTH];
+        int depth = 0;
+        node *n = root_;
+
+        if (!n)
+            return false;
+
+        ref[0] = &root_;
+        bit[0] = (tag_t)1 << slot<TOP>(k, 0);
+        for (;;)
+        {
+            if (!(n->tag & bit[depth]))
+                return false;
+            r[depth] = rank(n, bit[depth]);
+            if (is_leaf(n))
+                break;
+            ref[depth + 1] = &children(n)[r[depth]];
+            depth++;
+            n = *ref[depth];
+            bit[depth] = (tag_t)1 << slot<Order>(k, n->crit_bit);
+        }
+        if ((k ^ n->key) & prefix_mask(LAST))
+            return false;
+
+        if (popcount(n->tag) > 1)
+        {
+            remove<Value>(ref[depth], bit[depth], r[depth]);
+            size_--;
+            return true;
+        }
+
+        /* the last value of its node, the node goes, the first node is never one */
+        depth--;
+        remove<node*>(ref[depth], bit[depth], r[depth]);
+        free_node(n);
+        size_--;
+
+        /* a node left with one below it is not needed, but the first one */
+        n = *ref[depth];
+        if (depth > 0 && popcount(n->tag) == 1)
+        {
+            *ref[depth] = children(n)[0];
+            ::operator delete(n);
+        }
+        return true;
+    }
+
+    iterator
+    begin()
+    {
+        return first<iterator>();
+    }
+
+    iterator
+    end()
+    {
+        return iterator();
+    }
+
+    const_iterator
+    begin() const
+    {
+        return first<const_iterator>();
+    }
+
+    const_iterator
+    end() const
+    {
+        return const_iterator();
+    }
+
+    /* bytes of the nodes */
+    size_t
+    memory() const
+    {
+        return root_ ? memory_r(root_) : 0;
+    }
+
+private:
+    template <class It>
+    It
+    first() const
+    {
+        It x;
+
+        if (root_)
+        {
+            x.path_[0] = root_;
+            x.depth_ = 1;
+            x.first(0);
+        }
+        return x;
+    }
+
+    static size_t
+    memory_r(node *n)
+    {
+        size_t size = SLOTS + n->cap * (is_leaf(n) ? sizeof(Value) : sizeof(node*));
+
+        if (!is_leaf(n))
+        {
+            for (int i = popcount(n->tag) - 1; i >= 0; i--)
+                size += memory_r(children(n)[i]);
+        }
+        return size;
+    }
+};
+
+
+#endif
@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "radix-trie.h"
+
+/*
+ * RADIX_TRIE_SHARED: readers look up keys while the writer inserts and
+ * deletes. Stable keys must always be found, with one of the values
+ * the writer gave them, other keys must give their own value when
+ * found, and cursor scans must come out in order. Then the trie must
+ * hold what the writer left.
+ */
+
+#define SIZE 20000
+#define OPS 60000
+#define READERS 3
+
+static uint32_t keys[SIZE];
+static int lens[SIZE];
+static int present[SIZE];
+static nod *trie;
+static int done;
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+/* the first half of the keys stays in the trie, its values change */
+static int
+stable(int i, void *v)
+{
+    long x = (long)v - 1;
+
+    return x >= 0 && x % SIZE == i;
+}
+
+/* the value of a key of the second half is its index */
+static int
+own(int i, void *v)
+{
+    long x = (long)v - 1;
+
+    return x >= SIZE / 2 && x < SIZE && keys[x] == keys[i] && lens[x] == lens[i];
+}
+
+static void*
+reader(void *arg)
+{
+    radix_trie_reader *rd = radix_trie_reader_new(trie);
+    radix_trie_cursor c;
+    unsigned seed = (unsigned)(long)arg;
+    uint32_t q[32];
+    void *vals[32];
+    int found[32];
+    long errors = 0;
+    int i, j, ok, len, r = 0;
+
+    while (!__atomic_load_n(&done, __ATOMIC_RELAXED))
+    {
+        radix_trie_read_begin(rd);
+
+        for (j = 0; j < 64; j++)
+        {
+            void *v;
+
+            i = rnd(&seed) % (SIZE / 2);
+            if (!radix_trie_find(trie, keys[i], 32, &v) || !stable(i, v))
+                errors++;
+            if (!radix_trie_lpm(trie, keys[i], &len, &v) || len != 32 || !stable(i, v))
+                errors++;
+
+            i = SIZE / 2 + rnd(&seed) % (SIZE / 2);
+            if (radix_trie_find(trie, keys[i], lens[i], &v) && !own(i, v))
+                errors++;
+        }
+
+        for (j = 0; j < 32; j++)
+            q[j] = keys[rnd(&seed) % (SIZE / 2)];
+        if (radix_trie_find_batch(trie, q, 0, 32, vals, found) != 32)
+            errors++;
+
+        if (++r % 16 == 0)
+        {
+            uint64_t key = 0;
+            int last = 0;
+
+            for (j = 0, ok = radix_trie_lower_bound(&c, trie, rnd(&seed), 32); ok && j < 200; ok = radix_trie_next(&c), j++)
+            {
+                if (j && (c.key < key || (c.key == key && c.len <= last)))
+                    errors++;
+                key = c.key;
+                last = c.len;
+            }
+        }
+
+        radix_trie_read_end(rd);
+    }
+
+    radix_trie_reader_free(rd);
+    return (void*)errors;
+}
+
+static int
+run(int flags)
+{
+    pthread_t t[READERS];
+    unsigned seed = flags + 1;
+    void *v;
+    long errors = 0;
+    int i, n;
+
+    trie = radix_trie_create(flags | RADIX_TRIE_SHARED);
+    done = 0;
+
+    for (i = 0; i < SIZE; i++)
+    {
+        keys[i] = rnd(&seed);
+        lens[i] = i < SIZE / 2 ? 32 : 8 + rnd(&seed) % 25;
+        keys[i] >>= 32 - lens[i];
+        present[i] = i < SIZE / 2;
+        if (present[i])
+            radix_trie_insert(trie, keys[i], 32, (void*)(long)(i + 1));
+    }
+
+    for (i = 0; i < READERS; i++)
+        pthread_create(&t[i], 0, reader, (void*)(long)(flags * READERS + i + 1));
+
+    for (n = 0; n < OPS; n++)
+    {
+        i = rnd(&seed) % SIZE;
+        if (i < SIZE / 2)
+        {
+            // a new value for a stable key
+            radix_trie_insert(trie, keys[i], 32, (void*)(long)(i + 1 + (n & 1) * SIZE));
+        }
+        else if (present[i])
+        {
+            radix_trie_delete(trie, keys[i], lens[i]);
+            present[i] = 0;
+        }
+        else
+        {
+            radix_trie_insert(trie, keys[i], lens[i], (void*)(long)(i + 1));
+            present[i] = 1;
+        }
+    }
+    __atomic_store_n(&done, 1, __ATOMIC_RELAXED);
+
+    for (i = 0; i < READERS; i++)
+    {
+        void *r;
+
+        pthread_join(t[i], &r);
+        errors += (long)r;
+    }
+
+    // what is left, read by the writer
+    for (i = 0; i < SIZE; i++)
+    {
+        int f = radix_trie_find(trie, keys[i], lens[i], &v);
+
+        if (i < SIZE / 2 ? !f || !stable(i, v) : f && !own(i, v))
+            errors++;
+    }
+
+    printf("flags %d, %d readers, %ld errors\n", flags, READERS, errors);
+    radix_trie_delete_all(trie);
+    return errors != 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    int errors = 0;
+
+    errors += run(RADIX_TRIE_AUTO);
+    errors += run(RADIX_TRIE_FULL);
+    errors += run(RADIX_TRIE_COMPACT);
+    errors += run(RADIX_TRIE_AUTO | RADIX_TRIE_ARENA);
+
+    // not shared, no reader
+    trie = radix_trie_create(RADIX_TRIE_AUTO);
+    if (radix_trie_reader_new(trie))
+        errors++;
+    radix_trie_delete_all(trie);
+
+    return errors != 0;
+}
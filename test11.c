@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "radix-trie.h"
+
+/*
+ * RADIX_TRIE_CONCURRENT: writer threads insert and delete keys of their
+ * own, of mixed length, all over the key space, while a reader looks
+ * up keys no one deletes. Then the trie must hold what each writer
+ * left, and nothing else. A write outside a read section of a reader
+ * of the trie, or in one of another trie, is refused.
+ */
+
+#define WRITERS 4
+#define SIZE 8000           /* keys per writer, the first 256 stay */
+#define OPS 40000
+
+static uint32_t keys[WRITERS][SIZE];
+static int lens[WRITERS][SIZE];
+static int present[WRITERS][SIZE];
+static nod *trie;
+static int done;
+static long walked;
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+static void
+count(uint32_t key, int bit, void *v)
+{
+    walked++;
+}
+
+/* writer t owns the keys with values t * SIZE + 1 .. (t + 1) * SIZE */
+static int
+owner(void *v, uint32_t key, int len)
+{
+    long x = (long)v - 1;
+    int t = x / SIZE, i = x % SIZE;
+
+    return x >= 0 && t < WRITERS && keys[t][i] == key && lens[t][i] == len;
+}
+
+static void*
+writer(void *arg)
+{
+    int t = (int)(long)arg;
+    radix_trie_reader *rd = radix_trie_reader_new(trie);
+    unsigned seed = t + 1;
+    int i, n;
+
+    for (n = 0; n < OPS; n++)
+    {
+        i = 256 + rnd(&seed) % (SIZE - 256);
+
+        radix_trie_read_begin(rd);
+        if (present[t][i])
+            radix_trie_delete(trie, keys[t][i], lens[t][i]);
+        else
+            radix_trie_insert(trie, keys[t][i], lens[t][i], (void*)(long)(t * SIZE + i + 1));
+        radix_trie_read_end(rd);
+        present[t][i] ^= 1;
+    }
+
+    radix_trie_reader_free(rd);
+    return 0;
+}
+
+static void*
+reader(void *arg)
+{
+    radix_trie_reader *rd = radix_trie_reader_new(trie);
+    unsigned seed = 99;
+    long errors = 0;
+    void *v;
+    int i;
+
+    while (!__atomic_load_n(&done, __ATOMIC_RELAXED))
+    {
+        radix_trie_read_begin(rd);
+        for (i = 0; i < 64; i++)
+        {
+            int k = rnd(&seed) % 256;
+
+            // the first keys of writer 0 stay
+            if (!radix_trie_find(trie, keys[0][k], lens[0][k], &v) || !owner(v, keys[0][k], lens[0][k]))
+                errors++;
+        }
+        radix_trie_read_end(rd);
+    }
+
+    radix_trie_reader_free(rd);
+    return (void*)errors;
+}
+
+/* writes with no reader of the trie reading on the thread change nothing */
+static int
+stray(nod *t)
+{
+    nod *other = radix_trie_create(RADIX_TRIE_SHARED);
+    radix_trie_reader *rd = radix_trie_reader_new(t), *ro = radix_trie_reader_new(other);
+    int errors = 0, pass;
+    void *v;
+
+    radix_trie_read_begin(rd);
+    radix_trie_insert(t, 7, 32, (void*)1);
+    radix_trie_read_end(rd);
+
+    for (pass = 0; pass < 2; pass++)
+    {
+        // on its own, then inside a read section of another trie
+        if (pass)
+            radix_trie_read_begin(ro);
+        radix_trie_insert(t, 8, 32, (void*)2);
+        if (radix_trie_find(t, 8, 32, &v) || radix_trie_delete(t, 7, 32))
+            errors++;
+        if (pass)
+            radix_trie_read_end(ro);
+    }
+    if (!radix_trie_find(t, 7, 32, &v) || v != (void*)1)
+        errors++;
+
+    radix_trie_reader_free(rd);
+    radix_trie_reader_free(ro);
+    radix_trie_delete_all(other);
+    return errors;
+}
+
+int
+main(int argc, char **argv)
+{
+    pthread_t w[WRITERS], r;
+    radix_trie_reader *rd;
+    unsigned seed = 1;
+    long errors = 0, expect = 0;
+    void *v;
+    int t, i, l;
+
+    for (l = 0; l < 3; l++)
+    {
+        trie = radix_trie_create(l | RADIX_TRIE_CONCURRENT);
+        done = 0;
+
+        // distinct keys, the low 15 bits tell them apart
+        for (t = 0; t < WRITERS; t++)
+        {
+            for (i = 0; i < SIZE; i++)
+            {
+                lens[t][i] = i % 3 ? 32 : 16 + rnd(&seed) % 16;
+                keys[t][i] = (rnd(&seed) << 15 | (i * WRITERS + t)) & (~(uint32_t)0 >> (32 - lens[t][i]));
+                present[t][i] = 0;
+            }
+        }
+        rd = radix_trie_reader_new(trie);
+        radix_trie_read_begin(rd);
+        for (i = 0; i < 256; i++)
+        {
+            radix_trie_insert(trie, keys[0][i], lens[0][i], (void*)(long)(i + 1));
+            present[0][i] = 1;
+        }
+        radix_trie_read_end(rd);
+        radix_trie_reader_free(rd);
+
+        pthread_create(&r, 0, reader, 0);
+        for (t = 0; t < WRITERS; t++)
+            pthread_create(&w[t], 0, writer, (void*)(long)t);
+        for (t = 0; t < WRITERS; t++)
+            pthread_join(w[t], 0);
+        __atomic_store_n(&done, 1, __ATOMIC_RELAXED);
+        pthread_join(r, &v);
+        errors += (long)v;
+
+        expect = 0;
+        for (t = 0; t < WRITERS; t++)
+        {
+            for (i = 0; i < SIZE; i++)
+            {
+                int f = radix_trie_find(trie, keys[t][i], lens[t][i], &v);
+
+                if (f != present[t][i] || (f && !owner(v, keys[t][i], lens[t][i])))
+                    errors++;
+                expect += present[t][i];
+            }
+        }
+        walked = 0;
+        radix_trie_walk(trie, count);
+        if (walked != expect)
+            errors++;
+
+        printf("layout %d, %d writers, %ld keys, %ld errors\n", l, WRITERS, expect, errors);
+        radix_trie_delete_all(trie);
+    }
+
+    trie = radix_trie_create(RADIX_TRIE_CONCURRENT);
+    t = stray(trie);
+    printf("writes outside a read section: %d errors\n", t);
+    errors += t;
+    radix_trie_delete_all(trie);
+
+    return errors != 0;
+}
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "radix-trie.h"
+
+/*
+ * snapshots: random inserts, replacements and deletes, with a snapshot
+ * taken every so often. Each snapshot must keep holding what the trie
+ * held when it was taken, whatever the trie does after, and whichever
+ * snapshots are freed before it; the trie must hold its own keys.
+ */
+
+#define SIZE 3000
+#define OPS 30000
+#define SNAPS 8
+
+static uint64_t keys[SIZE];
+static int lens[SIZE];
+static long model[SNAPS + 1][SIZE];     /* value of each key, 0 when not there */
+static long walked;
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+static void
+count(uint64_t key, int bit, void *v)
+{
+    walked++;
+}
+
+/* trie t against model m */
+static int
+check(nod *t, long *m)
+{
+    long expect = 0;
+    int errors = 0, i;
+    void *v;
+
+    for (i = 0; i < SIZE; i++)
+    {
+        int f = radix_trie_find64(t, keys[i], lens[i], &v);
+
+        if (f != (m[i] != 0) || (f && (long)v != m[i]))
+            errors++;
+        expect += m[i] != 0;
+    }
+    walked = 0;
+    radix_trie_walk64(t, count);
+    if (walked != expect)
+        errors++;
+
+    return errors;
+}
+
+static int
+run(int flags)
+{
+    nod *trie = radix_trie_create(flags), *snap[SNAPS];
+    unsigned seed = flags + 1;
+    int order[SNAPS];
+    int errors = 0, taken = 0, i, j, n;
+    long *live = model[SNAPS];
+
+    // distinct keys, the low 12 bits tell them apart, every 8th is a prefix of the next
+    for (i = SIZE - 1; i >= 0; i--)
+    {
+        lens[i] = i % 4 ? 64 : 13 + rnd(&seed) % 51;
+        keys[i] = ((uint64_t)rnd(&seed) << 44 | (uint64_t)rnd(&seed) << 12 | i) & (~(uint64_t)0 >> (64 - lens[i]));
+        if (i % 8 == 0 && i + 1 < SIZE)
+            keys[i] = keys[i + 1] >> (64 - lens[i]);
+        live[i] = 0;
+    }
+
+    for (n = 0; n < OPS; n++)
+    {
+        i = rnd(&seed) % SIZE;
+        if (live[i] && n % 3 == 0)
+        {
+            if (!radix_trie_delete64(trie, keys[i], lens[i]))
+                errors++;
+            live[i] = 0;
+        }
+        else
+        {
+            // new keys, and new values of keys in the trie
+            live[i] = (long)n * SIZE + i + 1;
+            radix_trie_insert64(trie, keys[i], lens[i], (void*)live[i]);
+        }
+
+        if (n % (OPS / SNAPS) == OPS / SNAPS / 2 && taken < SNAPS)
+        {
+            snap[taken] = radix_trie_snapshot(trie);
+            if (!snap[taken])
+                return 1;
+            memcpy(model[taken], live, sizeof(model[taken]));
+            taken++;
+        }
+
+        // not in the trie: no copies
+        if (n % 97 == 0 && !live[i] && radix_trie_delete64(trie, keys[i], lens[i]))
+            errors++;
+    }
+
+    for (j = 0; j < taken; j++)
+        errors += check(snap[j], model[j]);
+    errors += check(trie, live);
+
+    // a snapshot does not change
+    if (taken)
+    {
+        radix_trie_insert64(snap[0], keys[0], lens[0], (void*)1);
+        radix_trie_delete64(snap[0], keys[1], lens[1]);
+        errors += check(snap[0], model[0]);
+    }
+
+    // freed in any order, the others stay as they were
+    for (j = 0; j < taken; j++)
+        order[j] = j;
+    for (j = taken - 1; j > 0; j--)
+    {
+        int k = rnd(&seed) % (j + 1), x = order[j];
+
+        order[j] = order[k];
+        order[k] = x;
+    }
+    for (j = 0; j < taken; j++)
+    {
+        int k;
+
+        radix_trie_delete_all(snap[order[j]]);
+        snap[order[j]] = 0;
+        for (k = 0; k < taken; k++)
+        {
+            if (snap[k])
+                errors += check(snap[k], model[k]);
+        }
+
+        // the trie goes on, copying less
+        for (k = 0; k < 200; k++)
+        {
+            i = rnd(&seed) % SIZE;
+            live[i] = (long)(OPS + j) * SIZE + i + 1;
+            radix_trie_insert64(trie, keys[i], lens[i], (void*)live[i]);
+        }
+        errors += check(trie, live);
+    }
+
+    printf("flags %d, %d snapshots, %d errors\n", flags, taken, errors);
+    radix_trie_delete_all(trie);
+    return errors != 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    int errors = 0;
+    nod *t;
+
+    errors += run(RADIX_TRIE_AUTO);
+    errors += run(RADIX_TRIE_FULL);
+    errors += run(RADIX_TRIE_COMPACT);
+    errors += run(RADIX_TRIE_AUTO | RADIX_TRIE_ARENA);
+    errors += run(RADIX_TRIE_AUTO | RADIX_TRIE_SHARED);
+
+    // no snapshot of a concurrent trie
+    t = radix_trie_create(RADIX_TRIE_CONCURRENT);
+    if (radix_trie_snapshot(t))
+        errors++;
+    radix_trie_delete_all(t);
+
+    return errors != 0;
+}
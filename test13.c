@@ -0,0 +1,282 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "radix-trie-int.h"
+
+/*
+ * images: a trie saved and mapped again must give the same lookups,
+ * walk, cursor scans and longest prefix matches as the trie, and must
+ * not change. An image saved again gives the same file, mapped it gives
+ * the same again. Files that are not whole images, or whose nodes are
+ * not those of an image, are not mapped.
+ */
+
+#define SIZE 20000
+#define IMAGE "test13.img"
+#define IMAGE2 "test13.img2"
+#define TRAILER 32          /* the struct radix_trie_image ending an image */
+
+static uint64_t keys[SIZE];
+static int lens[SIZE];
+static uint64_t seen[2][SIZE + 1][2];
+static int walked;
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+static void
+w0(uint64_t key, int bit, void *v)
+{
+    if (walked < SIZE + 1)
+    {
+        seen[0][walked][0] = key + bit;
+        seen[0][walked][1] = (uint64_t)(uintptr_t)v;
+    }
+    walked++;
+}
+
+static void
+w1(uint64_t key, int bit, void *v)
+{
+    if (walked < SIZE + 1)
+    {
+        seen[1][walked][0] = key + bit;
+        seen[1][walked][1] = (uint64_t)(uintptr_t)v;
+    }
+    walked++;
+}
+
+static int
+compare(nod *trie, nod *img, unsigned seed)
+{
+    radix_trie_cursor a, b;
+    void *u, *v, *vals[64];
+    int errors = 0, n0, i, j, fa, fb, la, lb, found[64];
+    uint64_t q[64];
+
+    for (i = 0; i < SIZE; i++)
+    {
+        fa = radix_trie_find64(trie, keys[i], lens[i], &u);
+        fb = radix_trie_find64(img, keys[i], lens[i], &v);
+        if (!fa || fa != fb || u != v)
+            errors++;
+
+        // keys near those there, mostly not there
+        fa = radix_trie_find64(trie, keys[i] ^ 1, lens[i], &u);
+        fb = radix_trie_find64(img, keys[i] ^ 1, lens[i], &v);
+        if (fa != fb || (fa && u != v))
+            errors++;
+
+        q[0] = keys[i] << (64 - lens[i]) | (rnd(&seed) & 0xff);
+        fa = radix_trie_lpm64(trie, q[0], &la, &u);
+        fb = radix_trie_lpm64(img, q[0], &lb, &v);
+        if (fa != fb || (fa && (la != lb || u != v)))
+            errors++;
+    }
+
+    walked = 0;
+    radix_trie_walk64(trie, w0);
+    n0 = walked;
+    walked = 0;
+    radix_trie_walk64(img, w1);
+    if (n0 != walked || memcmp(seen[0], seen[1], sizeof(seen[0])) != 0)
+        errors++;
+
+    // scans from random places, forward and back
+    for (i = 0; i < 200; i++)
+    {
+        uint64_t k = (uint64_t)rnd(&seed) << 32 | rnd(&seed);
+
+        fa = radix_trie_lower_bound64(&a, trie, k, 64);
+        fb = radix_trie_lower_bound64(&b, img, k, 64);
+        for (j = 0; j < 50 && (fa || fb); j++)
+        {
+            if (fa != fb || a.key != b.key || a.len != b.len || a.value != b.value)
+            {
+                errors++;
+                break;
+            }
+            fa = i & 1 ? radix_trie_next(&a) : radix_trie_prev(&a);
+            fb = i & 1 ? radix_trie_next(&b) : radix_trie_prev(&b);
+        }
+    }
+    fa = radix_trie_last(&a, trie);
+    fb = radix_trie_last(&b, img);
+    if (fa != fb || (fa && (a.key != b.key || a.len != b.len)))
+        errors++;
+
+    for (i = 0; i < 64; i++)
+        q[i] = keys[rnd(&seed) % SIZE] >> (64 - 32);
+    if (radix_trie_find_batch64(img, q, 0, 64, vals, found) != radix_trie_find_batch64(trie, q, 0, 64, vals, found))
+        errors++;
+
+    return errors;
+}
+
+/* the bytes of two files differ */
+static int
+differ(const char *a, const char *b)
+{
+    FILE *fa = fopen(a, "rb"), *fb = fopen(b, "rb");
+    int ca = 0, cb = 0;
+
+    while (fa && fb && ca == cb && ca != EOF)
+    {
+        ca = getc(fa);
+        cb = getc(fb);
+    }
+    if (fa)
+        fclose(fa);
+    if (fb)
+        fclose(fb);
+    return !fa || !fb || ca != cb;
+}
+
+/* the image with node 0, or the root, changed by "how" must not map */
+static int
+corrupt(const char *path, int how)
+{
+    FILE *f = fopen(path, "rb");
+    char *b;
+    long size;
+    nod *n, *img = radix_trie_map(path);
+    int errors = 0, k;
+
+    if (!f || !img)
+    {
+        if (f)
+            fclose(f);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    rewind(f);
+    b = (char*)malloc(size);
+    if (fread(b, 1, size, f) != (size_t)size)
+        errors++;
+    fclose(f);
+
+    n = (nod*)b;
+    switch (how)
+    {
+        case 0: n->order = 200; break;
+        case 1: n->cap++; break;
+        case 2: n->crit_bit = KEYSIZE_MAX; break;
+        default:
+            // each child of the root after it, or inside a node
+            n = (nod*)(b + size - TRAILER - NODE_SIZE(img->cap));
+            for (k = 0; k < n->cap; k++)
+                n->fan[k] = (nod*)(intptr_t)(how == 3 ? 8 : -4);
+            break;
+    }
+    radix_trie_unmap(img);
+
+    f = fopen(IMAGE2, "wb");
+    if (fwrite(b, 1, size, f) != (size_t)size)
+        errors++;
+    fclose(f);
+    free(b);
+    if ((img = radix_trie_map(IMAGE2)))
+    {
+        errors++;
+        radix_trie_unmap(img);
+    }
+    return errors;
+}
+
+static int
+run(int flags)
+{
+    nod *trie = radix_trie_create(flags), *img, *img2;
+    unsigned seed = flags + 1;
+    int errors = 0, i;
+    void *v;
+
+    // every 4th key a prefix of the next, so some slots are composite
+    for (i = SIZE - 1; i >= 0; i--)
+    {
+        lens[i] = i % 2 ? 64 : 8 + rnd(&seed) % 57;
+        keys[i] = ((uint64_t)rnd(&seed) << 32 | rnd(&seed)) >> (64 - lens[i]);
+        if (i % 4 == 0 && i + 1 < SIZE)
+            keys[i] = keys[i + 1] >> (64 - lens[i]);
+        radix_trie_insert64(trie, keys[i], lens[i], (void*)(uintptr_t)(i + 1));
+    }
+
+    if (radix_trie_save(trie, IMAGE) != 0 || !(img = radix_trie_map(IMAGE)))
+    {
+        printf("flags %d, no image\n", flags);
+        radix_trie_delete_all(trie);
+        return 1;
+    }
+    errors += compare(trie, img, seed);
+
+    // an image does not change
+    radix_trie_insert64(img, 12345, 20, (void*)1);
+    if (radix_trie_delete64(img, keys[0], lens[0]) || radix_trie_find64(img, 12345, 20, &v))
+        errors++;
+    if (!radix_trie_find64(img, keys[0], lens[0], &v) || v != (void*)1)
+        errors++;
+
+    // the image saved again, and mapped
+    if (radix_trie_save(img, IMAGE2) != 0 || !(img2 = radix_trie_map(IMAGE2)))
+        errors++;
+    else
+    {
+        errors += differ(IMAGE, IMAGE2);
+        errors += compare(trie, img2, seed);
+        radix_trie_unmap(img2);
+    }
+
+    radix_trie_unmap(img);
+    printf("flags %d, %d keys, %d errors\n", flags, SIZE, errors);
+    radix_trie_delete_all(trie);
+    return errors != 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    int errors = 0, i;
+    nod *t, *img = 0;
+    void *v;
+    FILE *f;
+
+    errors += run(RADIX_TRIE_AUTO);
+    errors += run(RADIX_TRIE_FULL);
+    errors += run(RADIX_TRIE_COMPACT);
+    errors += run(RADIX_TRIE_AUTO | RADIX_TRIE_ARENA);
+    errors += run(RADIX_TRIE_AUTO | RADIX_TRIE_SHARED);
+
+    // an empty trie
+    t = radix_trie_create(RADIX_TRIE_AUTO);
+    if (radix_trie_save(t, IMAGE) != 0 || !(img = radix_trie_map(IMAGE)) || radix_trie_find64(img, 0, 1, &v))
+        errors++;
+    radix_trie_unmap(img);
+
+    // nodes that are not those of an image
+    for (i = 0; i < 1000; i++)
+        radix_trie_insert(t, i * 12345, 32, (void*)(long)(i + 1));
+    radix_trie_save(t, IMAGE);
+    for (i = 0; i < 5; i++)
+        errors += corrupt(IMAGE, i);
+
+    // cut short, or not an image at all
+    radix_trie_insert(t, 7, 32, (void*)7);
+    radix_trie_save(t, IMAGE);
+    if (truncate(IMAGE, 40) != 0 || radix_trie_map(IMAGE))
+        errors++;
+    f = fopen(IMAGE, "w");
+    fprintf(f, "%0100d\n", 0);
+    fclose(f);
+    if (radix_trie_map(IMAGE) || radix_trie_map("no such file"))
+        errors++;
+    radix_trie_delete_all(t);
+
+    unlink(IMAGE);
+    unlink(IMAGE2);
+    return errors != 0;
+}
@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "radix-trie.h"
+
+/*
+ * frozen tries: lookups of keys there and not there, and the walk,
+ * must be those of the trie frozen, for dense and random keys, keys
+ * of mixed length, and values of each width.
+ */
+
+#define SIZE 30000
+
+static uint64_t keys[SIZE];
+static int lens[SIZE];
+static uint64_t seen[2][SIZE][3];
+static int walked[2], side;
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+static void
+note(uint64_t key, int bit, void *v)
+{
+    int n = walked[side]++;
+
+    if (n < SIZE)
+    {
+        seen[side][n][0] = key;
+        seen[side][n][1] = bit;
+        seen[side][n][2] = (uint64_t)(uintptr_t)v;
+    }
+}
+
+/* keys of kind "kind", values up to "most" */
+static int
+run(int kind, uint64_t most, int flags)
+{
+    nod *trie = radix_trie_create(flags);
+    radix_trie_frozen *f;
+    unsigned seed = kind * 7 + flags + 1;
+    int errors = 0, i, fa, fb;
+    void *u, *v;
+
+    for (i = SIZE - 1; i >= 0; i--)
+    {
+        switch (kind)
+        {
+            case 0:             // dense, as test1
+                lens[i] = 32;
+                keys[i] = i;
+                break;
+            case 1:             // random, as test2
+                lens[i] = 32;
+                keys[i] = rnd(&seed);
+                break;
+            default:            // mixed length, prefixes of each other
+                lens[i] = i % 2 ? 64 : 1 + rnd(&seed) % 63;
+                keys[i] = ((uint64_t)rnd(&seed) << 32 | rnd(&seed)) >> (64 - lens[i]);
+                if (i % 4 == 0 && i + 1 < SIZE)
+                    keys[i] = keys[i + 1] >> (64 - lens[i]);
+                break;
+        }
+        radix_trie_insert64(trie, keys[i], lens[i], (void*)(uintptr_t)((i * 2654435761u) % most));
+    }
+
+    f = radix_trie_freeze(trie);
+    if (!f)
+        return 1;
+
+    for (i = 0; i < SIZE; i++)
+    {
+        fa = radix_trie_find64(trie, keys[i], lens[i], &u);
+        fb = radix_trie_frozen_find64(f, keys[i], lens[i], &v);
+        if (!fa || !fb || u != v)
+            errors++;
+
+        fa = radix_trie_find64(trie, keys[i] ^ 2, lens[i], &u);
+        fb = radix_trie_frozen_find64(f, keys[i] ^ 2, lens[i], &v);
+        if (fa != fb || (fa && u != v))
+            errors++;
+
+        if (lens[i] < 64)
+        {
+            fa = radix_trie_find64(trie, keys[i] << 1, lens[i] + 1, &u);
+            fb = radix_trie_frozen_find64(f, keys[i] << 1, lens[i] + 1, &v);
+            if (fa != fb || (fa && u != v))
+                errors++;
+        }
+    }
+    if (kind < 2)
+    {
+        fa = radix_trie_find(trie, (uint32_t)keys[5], 32, &u);
+        fb = radix_trie_frozen_find(f, (uint32_t)keys[5], 32, &v);
+        if (!fa || !fb || u != v)
+            errors++;
+    }
+
+    walked[0] = walked[1] = 0;
+    side = 0;
+    radix_trie_walk64(trie, note);
+    side = 1;
+    radix_trie_frozen_walk64(f, note);
+    if (walked[0] != walked[1] || memcmp(seen[0], seen[1], sizeof(seen[0])) != 0)
+        errors++;
+
+    printf("keys %d, values < %llx, flags %d: %d keys, %.1f bytes a key, %d errors\n", kind,
+           (unsigned long long)most, flags, walked[1], (double)radix_trie_frozen_size(f) / walked[1], errors);
+
+    radix_trie_frozen_free(f);
+    radix_trie_delete_all(trie);
+    return errors != 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    int errors = 0, kind;
+    radix_trie_frozen *f;
+    nod *t;
+    void *v;
+
+    for (kind = 0; kind < 3; kind++)
+    {
+        errors += run(kind, 200, RADIX_TRIE_AUTO);
+        errors += run(kind, 60000, RADIX_TRIE_COMPACT);
+        errors += run(kind, 0xfffffff0u, RADIX_TRIE_FULL);
+        errors += run(kind, ~(uint64_t)0 >> 1, RADIX_TRIE_AUTO | RADIX_TRIE_SHARED);
+    }
+
+    // nothing in it
+    t = radix_trie_create(RADIX_TRIE_AUTO);
+    f = radix_trie_freeze(t);
+    if (!f || radix_trie_frozen_find(f, 0, 1, &v) || radix_trie_frozen_find(f, 0, 32, &v))
+        errors++;
+    radix_trie_frozen_free(f);
+    radix_trie_delete_all(t);
+
+    return errors != 0;
+}
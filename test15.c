@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "radix-trie.h"
+
+/*
+ * RADIX_TRIE_ORDER: random inserts, replacements and deletes of keys of
+ * mixed length, and of string keys, on tries of each order and layout,
+ * must leave what a plain array of the keys holds. Orders past
+ * RADIX_ORDER_MAX give no trie.
+ */
+
+#define SIZE 4000
+#define OPS 40000
+#define STRS 1000
+
+static uint64_t keys[SIZE];
+static int lens[SIZE];
+static long model[SIZE];        /* value of each key, 0 when not there */
+static unsigned char strs[STRS][24];
+static size_t slens[STRS];
+static long walked;
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+static void
+count(uint64_t key, int bit, void *v)
+{
+    walked++;
+}
+
+static void
+count_str(const void *key, size_t len, void *v)
+{
+    walked++;
+}
+
+static int
+check(nod *t)
+{
+    long expect = 0;
+    int errors = 0, i;
+    void *v;
+
+    for (i = 0; i < SIZE; i++)
+    {
+        int f = radix_trie_find64(t, keys[i], lens[i], &v);
+
+        if (f != (model[i] != 0) || (f && (long)v != model[i]))
+            errors++;
+        expect += model[i] != 0;
+    }
+    walked = 0;
+    radix_trie_walk64(t, count);
+    if (walked != expect)
+        errors++;
+
+    return errors;
+}
+
+static int
+run(int order, int flags)
+{
+    nod *trie = radix_trie_create(flags | RADIX_TRIE_ORDER(order));
+    unsigned seed = order * 32 + flags + 1;
+    int errors = 0, i, n;
+    void *v;
+
+    if (!trie)
+        return 1;
+
+    // distinct keys, dense and random, every 8th a prefix of the next
+    for (i = SIZE - 1; i >= 0; i--)
+    {
+        if (i % 2)
+        {
+            lens[i] = i % 4 == 1 ? 32 : 64;
+            keys[i] = ((uint64_t)rnd(&seed) << 44 | (uint64_t)rnd(&seed) << 12 | i) & (~(uint64_t)0 >> (64 - lens[i]));
+        }
+        else
+        {
+            lens[i] = 20 + rnd(&seed) % 44;
+            keys[i] = (uint64_t)i << (lens[i] - 13);
+        }
+        if (i % 8 == 0 && i + 1 < SIZE && lens[i + 1] > lens[i])
+            keys[i] = keys[i + 1] >> (lens[i + 1] - lens[i]);
+        model[i] = 0;
+    }
+
+    for (n = 0; n < OPS; n++)
+    {
+        i = rnd(&seed) % SIZE;
+        if (model[i] && n % 3 == 0)
+        {
+            if (!radix_trie_delete64(trie, keys[i], lens[i]))
+                errors++;
+            model[i] = 0;
+        }
+        else
+        {
+            model[i] = n + 1;
+            radix_trie_insert64(trie, keys[i], lens[i], (void*)(long)model[i]);
+        }
+        if (n % (OPS / 4) == 0)
+            errors += check(trie);
+    }
+    errors += check(trie);
+
+    // the 32 bit calls
+    for (i = 1; i < SIZE; i += 4)
+    {
+        int f = radix_trie_find(trie, (uint32_t)keys[i], 32, &v);
+
+        if (f != (model[i] != 0) || (f && (long)v != model[i]))
+            errors++;
+    }
+
+    for (i = 0; i < SIZE; i++)
+    {
+        if (model[i] && !radix_trie_delete64(trie, keys[i], lens[i]))
+            errors++;
+        model[i] = 0;
+    }
+    errors += check(trie);
+
+    printf("order %d, flags %d, %d errors\n", order, flags, errors);
+    radix_trie_delete_all(trie);
+    return errors != 0;
+}
+
+static int
+run_str(int order)
+{
+    nod *trie = radix_trie_create(RADIX_TRIE_ORDER(order));
+    unsigned seed = order + 1;
+    long expect = 0;
+    int errors = 0, i, n;
+    void *v;
+
+    // strings sharing prefixes, some prefixes of others
+    for (i = 0; i < STRS; i++)
+    {
+        slens[i] = 1 + rnd(&seed) % sizeof(strs[i]);
+        memset(strs[i], 'a', sizeof(strs[i]));
+        strs[i][slens[i] - 1] = (unsigned char)(i & 0xff);
+        strs[i][0] = (unsigned char)(i >> 8);
+        model[i] = 0;
+    }
+    for (i = 0; i < STRS; i++)
+    {
+        int j;
+
+        for (j = 0; j < i; j++)
+            if (slens[j] == slens[i] && memcmp(strs[j], strs[i], slens[i]) == 0)
+                break;
+        if (j < i)
+            slens[i] = 0;   // not distinct, left out
+    }
+
+    for (n = 0; n < OPS / 4; n++)
+    {
+        i = rnd(&seed) % STRS;
+        if (!slens[i])
+            continue;
+        if (model[i] && n % 3 == 0)
+        {
+            if (!radix_trie_delete_str(trie, strs[i], slens[i]))
+                errors++;
+            model[i] = 0;
+        }
+        else
+        {
+            model[i] = n + 1;
+            trie = radix_trie_insert_str(trie, strs[i], slens[i], (void*)(long)model[i]);
+        }
+    }
+
+    for (i = 0; i < STRS; i++)
+    {
+        int f;
+
+        if (!slens[i])
+            continue;
+        f = radix_trie_find_str(trie, strs[i], slens[i], &v);
+        if (f != (model[i] != 0) || (f && (long)v != model[i]))
+            errors++;
+        expect += model[i] != 0;
+    }
+    walked = 0;
+    radix_trie_walk_str(trie, 0, 0, count_str);
+    if (walked != expect)
+        errors++;
+
+    printf("order %d, strings, %d errors\n", order, errors);
+    radix_trie_delete_all(trie);
+    return errors != 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    int errors = 0, order;
+
+    // 0 is RADIX_ORDER, 6 only when built with RADIX_ORDER_MAX 6
+    for (order = 0; order <= 6; order++)
+    {
+        nod *t = radix_trie_create(RADIX_TRIE_ORDER(order));
+
+        if (!t)
+        {
+            errors += order < 6;
+            continue;
+        }
+        radix_trie_delete_all(t);
+
+        errors += run(order, RADIX_TRIE_AUTO);
+        errors += run(order, RADIX_TRIE_FULL);
+        errors += run(order, RADIX_TRIE_COMPACT);
+        errors += run(order, RADIX_TRIE_AUTO | RADIX_TRIE_ARENA);
+        errors += run(order, RADIX_TRIE_AUTO | RADIX_TRIE_SHARED);
+        errors += run_str(order);
+    }
+    if (radix_trie_create(RADIX_TRIE_ORDER(7)))
+        errors++;
+
+    return errors != 0;
+}
@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <string>
+#include <stdexcept>
+#include "radix-trie.hpp"
+#include "radix-trie.h"
+
+/*
+ * radix_trie<>: random inserts, replacements and erases, for each order
+ * and key width, must leave what a std::map holds, found and walked in
+ * the same order, with values that own memory too. The keys found must
+ * be those the C trie finds, and a trie moved away from must be empty.
+ * Values that throw as they are copied or moved must leave the trie as
+ * it was, with no value lost or left over.
+ */
+
+#define OPS 60000
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+template <class T, class M>
+static int
+check(const T &t, const M &m)
+{
+    typename M::const_iterator i = m.begin();
+    int errors = 0;
+
+    if (t.size() != m.size())
+        errors++;
+    for (typename T::const_iterator x = t.begin(); x != t.end(); ++x, ++i)
+    {
+        if (i == m.end() || x.key() != i->first || x.value() != i->second)
+            return errors + 1;
+    }
+    if (i != m.end())
+        errors++;
+    for (i = m.begin(); i != m.end(); ++i)
+    {
+        if (!t.find(i->first) || *t.find(i->first) != i->second)
+            errors++;
+    }
+    return errors;
+}
+
+/* keys of Bits bits, dense ones when "dense", values made by "value" */
+template <class Key, class Value, int Order, int Bits>
+static int
+run(bool dense, Value (*value)(long))
+{
+    radix_trie<Key, Value, Order, Bits> t;
+    std::map<Key, Value> m;
+    nod *c = radix_trie_create(RADIX_TRIE_AUTO);
+    uint64_t mask = Bits == 64 ? ~(uint64_t)0 : ((uint64_t)1 << Bits) - 1;
+    unsigned seed = Order * 64 + Bits;
+    int errors = 0, n;
+    void *v;
+
+    for (n = 0; n < OPS; n++)
+    {
+        uint64_t r = (uint64_t)rnd(&seed) << 32 | rnd(&seed);
+        Key k = (Key)((dense ? r % (OPS / 2) : r) & mask);
+
+        if (n % 3 == 0)
+        {
+            bool there = m.erase(k) != 0;
+
+            if (t.erase(k) != there)
+                errors++;
+            radix_trie_delete64(c, k, Bits);
+        }
+        else
+        {
+            bool fresh = m.find(k) == m.end();
+
+            m[k] = value(n);
+            if (t.insert_or_assign(k, value(n)) != fresh)
+                errors++;
+            radix_trie_insert64(c, k, Bits, (void*)(long)n);
+        }
+        if (n % (OPS / 4) == 0)
+            errors += check(t, m);
+
+        // a key near this one, mostly not there
+        k ^= 1;
+        if ((t.find(k) != 0) != (m.find(k) != m.end()) || t.contains(k) != (radix_trie_find64(c, k, Bits, &v) != 0))
+            errors++;
+    }
+    errors += check(t, m);
+
+    // the trie moves as a whole
+    radix_trie<Key, Value, Order, Bits> u(std::move(t));
+    if (!t.empty() || t.begin() != t.end() || u.size() != m.size())
+        errors++;
+    t = std::move(u);
+    errors += check(t, m);
+
+    // and empties
+    for (typename std::map<Key, Value>::iterator i = m.begin(); i != m.end(); ++i)
+    {
+        if (!t.erase(i->first))
+            errors++;
+    }
+    if (!t.empty() || t.begin() != t.end() || (!m.empty() && t.find(m.begin()->first)))
+        errors++;
+
+    printf("order %d, %d bit keys, %s: %d errors\n", Order, Bits, dense ? "dense" : "random", errors);
+    radix_trie_delete_all(c);
+    return errors != 0;
+}
+
+static uint16_t
+small(long n)
+{
+    return (uint16_t)n;
+}
+
+static std::string
+text(long n)
+{
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), "value %ld", n);
+    return buf;
+}
+
+/* a value that throws on the copy or move "countdown" counts down to 0 */
+struct boom
+{
+    static long live, countdown;
+    long v;
+
+    static void
+    tick()
+    {
+        if (countdown > 0 && --countdown == 0)
+            throw std::runtime_error("boom");
+    }
+
+    boom(long x) : v(x) { live++; }
+    boom(const boom &b) : v(b.v) { tick(); live++; }
+    boom(boom &&b) : v(b.v) { tick(); live++; }
+    ~boom() { live--; }
+    boom &operator=(const boom &b) { tick(); v = b.v; return *this; }
+    boom &operator=(boom &&b) { tick(); v = b.v; return *this; }
+};
+
+long boom::live, boom::countdown;
+
+static int
+throwing()
+{
+    std::map<uint32_t, long> m;
+    unsigned seed = 5;
+    long thrown = 0;
+    int errors = 0, n;
+
+    {
+        radix_trie<uint32_t, boom, 4, 32> t;
+
+        for (n = 0; n < OPS; n++)
+        {
+            uint32_t k = rnd(&seed) % 4096;
+
+            boom::countdown = n % 3 ? 0 : 1 + rnd(&seed) % 8;
+            try
+            {
+                if (n % 4 == 0)
+                {
+                    t.erase(k);
+                    m.erase(k);
+                }
+                else
+                {
+                    t.insert_or_assign(k, boom(n));
+                    m[k] = n;
+                }
+            }
+            catch (const std::runtime_error &)
+            {
+                thrown++;
+            }
+            boom::countdown = 0;
+        }
+
+        std::map<uint32_t, long>::const_iterator i = m.begin();
+        for (radix_trie<uint32_t, boom, 4, 32>::iterator x = t.begin(); x != t.end(); ++x, ++i)
+        {
+            if (i == m.end() || x.key() != i->first || x.value().v != i->second)
+            {
+                errors++;
+                break;
+            }
+        }
+        if (i != m.end() || t.size() != m.size() || boom::live != (long)m.size())
+            errors++;
+    }
+    if (boom::live != 0)
+        errors++;
+
+    printf("throwing values: %ld thrown, %d errors\n", thrown, errors);
+    return errors != 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    int errors = 0, dense;
+
+    for (dense = 0; dense < 2; dense++)
+    {
+        errors += run<uint32_t, uint16_t, 1, 32>(dense, small);
+        errors += run<uint32_t, uint16_t, 4, 32>(dense, small);
+        errors += run<uint32_t, uint16_t, 5, 32>(dense, small);
+        errors += run<uint32_t, uint16_t, 4, 21>(dense, small);
+        errors += run<uint64_t, std::string, 3, 64>(dense, text);
+        errors += run<uint64_t, std::string, 6, 64>(dense, text);
+        errors += run<uint64_t, uint16_t, 5, 40>(dense, small);
+        errors += run<uint16_t, std::string, 2, 16>(dense, text);
+    }
+    errors += throwing();
+
+    return errors != 0;
+}
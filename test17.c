@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include "radix-trie.h"
+
+/*
+ * radix_trie_stats: the counts of a trie of known shape, and of random
+ * tries of each order and layout, must add up: every node but the root
+ * hangs from an internal or composite slot, the keys are those walked,
+ * the levels sum to the totals, and the bytes are those malloc gave
+ * out for the trie, less its own overhead, when that is glibc's malloc.
+ */
+
+#define SIZE 20000
+
+/* the bytes against the heap, not under the malloc of AddressSanitizer */
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+#define HEAP 1
+#else
+#define HEAP 0
+#endif
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#undef HEAP
+#define HEAP 0
+#endif
+#endif
+
+static long walked;
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+static void
+count(uint64_t key, int bit, void *v)
+{
+    walked++;
+}
+
+static size_t
+heap(void)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    return mallinfo2().uordblks;
+#else
+    return (size_t)mallinfo().uordblks;
+#endif
+}
+
+/* the totals against the levels and the walk */
+static int
+check(nod *t, const struct radix_trie_stats *st)
+{
+    size_t nodes = 0, slots = 0, used = 0, keys = 0;
+    int errors = 0, i;
+
+    for (i = 0; i < RADIX_TRIE_STATS_LEVELS; i++)
+    {
+        nodes += st->level_nodes[i];
+        slots += st->level_slots[i];
+        used += st->level_used[i];
+        keys += st->level_keys[i];
+        if (i > st->depth && st->level_nodes[i])
+            errors++;
+    }
+    if (nodes != st->nodes || slots != st->slots || keys != st->keys)
+        errors++;
+    if (used != st->internal + st->external + st->composite)
+        errors++;
+    if (st->nodes && st->internal + st->composite != st->nodes - 1)
+        errors++;
+    if (st->fill != (st->slots ? (double)used / st->slots : 0))
+        errors++;
+
+    walked = 0;
+    radix_trie_walk64(t, count);
+    if ((size_t)walked != st->keys)
+        errors++;
+
+    return errors;
+}
+
+/* every key of 8 bits, under every key of 4 */
+static int
+known(void)
+{
+    nod *t = radix_trie_create(RADIX_TRIE_FULL | RADIX_TRIE_ORDER(4));
+    struct radix_trie_stats st;
+    int errors = 0, i;
+
+    for (i = 0; i < 256; i++)
+        radix_trie_insert(t, i, 8, (void*)(long)(i + 1));
+    if (radix_trie_stats(t, &st) != 0 || check(t, &st))
+        errors++;
+    if (st.keys != 256 || st.external != 256 || st.composite != 0)
+        errors++;
+    if (st.level_keys[st.depth] != 256 || st.level_nodes[st.depth] != 16)
+        errors++;
+    if (st.level_used[st.depth] != 256 || st.level_slots[st.depth] != 256)
+        errors++;
+
+    for (i = 0; i < 16; i++)
+        radix_trie_insert(t, i, 4, (void*)(long)(i + 1));
+    if (radix_trie_stats(t, &st) != 0 || check(t, &st))
+        errors++;
+    if (st.keys != 272 || st.composite != 16 || st.level_keys[st.depth - 1] != 16)
+        errors++;
+
+    printf("known shape: %lu nodes, depth %d, %d errors\n", (unsigned long)st.nodes, st.depth, errors);
+    radix_trie_delete_all(t);
+
+    if (radix_trie_stats(0, &st) != 0 || st.nodes || st.keys || st.bytes)
+        errors++;
+    return errors != 0;
+}
+
+static int
+run(int order, int flags)
+{
+    static uint64_t keys[SIZE];
+    static int lens[SIZE];
+    size_t h = heap();
+    nod *t = radix_trie_create(flags | RADIX_TRIE_ORDER(order));
+    struct radix_trie_stats st;
+    unsigned seed = order * 32 + flags + 1;
+    int errors = 0, i;
+
+    // random keys of mixed length, and a dense run
+    for (i = 0; i < SIZE; i++)
+    {
+        lens[i] = i % 2 ? 8 + rnd(&seed) % 57 : 32;
+        keys[i] = i % 2 ? ((uint64_t)rnd(&seed) << 32 | rnd(&seed)) & (~(uint64_t)0 >> (64 - lens[i])) : (uint64_t)i;
+        radix_trie_insert64(t, keys[i], lens[i], (void*)(long)(i + 1));
+    }
+    h = heap() - h;
+
+    if (radix_trie_stats(t, &st) != 0)
+        errors++;
+    errors += check(t, &st);
+
+    // malloc rounds each block up and adds a word, a shared trie keeps
+    // the nodes it retired a while
+    if (HEAP && !(flags & (RADIX_TRIE_ARENA | RADIX_TRIE_SHARED)) && (st.bytes > h || h - st.bytes > 3 * sizeof(size_t) * (st.nodes + 1)))
+        errors++;
+
+    // a snapshot has the same keys, in the same nodes
+    if (!(flags & RADIX_TRIE_SHARED))
+    {
+        nod *s = radix_trie_snapshot(t);
+        struct radix_trie_stats ss;
+
+        if (radix_trie_stats(s, &ss) != 0 || check(s, &ss))
+            errors++;
+        if (ss.keys != st.keys || ss.nodes != st.nodes || ss.bytes != st.bytes)
+            errors++;
+        radix_trie_delete_all(s);
+    }
+
+    for (i = 0; i < SIZE; i++)
+        radix_trie_delete64(t, keys[i], lens[i]);
+    if (radix_trie_stats(t, &st) != 0 || check(t, &st) || st.keys != 0 || st.nodes != 1)
+        errors++;
+
+    printf("order %d, flags %d: %d errors\n", order, flags, errors);
+    radix_trie_delete_all(t);
+    return errors != 0;
+}
+
+/* string keys, their path segments counted in the bytes */
+static int
+run_str(void)
+{
+    size_t h = heap();
+    nod *t = radix_trie_create(RADIX_TRIE_AUTO);
+    struct radix_trie_stats st;
+    unsigned seed = 7;
+    int errors = 0, i, j;
+
+    for (i = 0; i < SIZE / 4; i++)
+    {
+        char s[40];
+        int n = 1 + rnd(&seed) % (sizeof(s) - 1);
+
+        for (j = 0; j < n; j++)
+            s[j] = j < 12 ? 'k' : 'a' + rnd(&seed) % 4;
+        t = radix_trie_insert_str(t, s, n, (void*)(long)(i + 1));
+    }
+    h = heap() - h;
+
+    if (radix_trie_stats(t, &st) != 0)
+        errors++;
+    if (st.nodes && st.internal + st.composite != st.nodes - 1)
+        errors++;
+    // a node and its segment are two blocks
+    if (HEAP && (st.bytes > h || h - st.bytes > 3 * sizeof(size_t) * (2 * st.nodes + 1)))
+        errors++;
+
+    printf("strings: %lu keys, depth %d, %.1f bytes/key, %d errors\n",
+           (unsigned long)st.keys, st.depth, st.bytes_per_key, errors);
+    radix_trie_delete_all(t);
+    return errors != 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    int errors = 0, order, i;
+    static const int flags[] = { RADIX_TRIE_AUTO, RADIX_TRIE_FULL, RADIX_TRIE_COMPACT,
+                                 RADIX_TRIE_ARENA, RADIX_TRIE_SHARED };
+
+    errors += known();
+    for (order = 1; order <= 5; order++)
+        for (i = 0; i < (int)(sizeof(flags) / sizeof(flags[0])); i++)
+            errors += run(order, flags[i]);
+    errors += run_str();
+
+    return errors != 0;
+}
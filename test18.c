@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "radix-trie.h"
+
+/*
+ * radix_trie_counters, built with -DRADIX_TRIE_COUNTERS: the splits,
+ * composites and frees of a few keys of known shape, and the finds and
+ * misses of readers of a shared trie in threads of their own, which
+ * must all be counted.
+ */
+
+#define SIZE 4096
+#define FINDS 200000
+#define READERS 4
+
+static nod *trie;
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+static int
+known(void)
+{
+    nod *t = radix_trie_create(RADIX_TRIE_FULL | RADIX_TRIE_ORDER(4));
+    struct radix_trie_counters c;
+    int errors = 0;
+    void *v;
+
+    if (radix_trie_counters(t, &c) != 0 || c.finds || c.inserts || c.splits)
+        errors++;
+
+    // a leaf under the root, then one leaving it at bit 8, then a key
+    // ending at bit 8, on the node made for the second
+    radix_trie_insert(t, 0x1234, 16, (void*)1);
+    radix_trie_insert(t, 0x1299, 16, (void*)2);
+    radix_trie_counters(t, &c);
+    if (c.inserts != 2 || c.splits != 1 || c.composites != 0)
+        errors++;
+    radix_trie_insert(t, 0x12, 8, (void*)3);
+    radix_trie_counters(t, &c);
+    if (c.inserts != 3 || c.splits != 2 || c.composites != 1)
+        errors++;
+
+    if (!radix_trie_find(t, 0x1234, 16, &v) || radix_trie_find(t, 0x1235, 16, &v))
+        errors++;
+    radix_trie_counters(t, &c);
+    if (c.finds != 2 || c.find_misses != 1 || c.find_nodes < 4)
+        errors++;
+
+    // the leaf of 0x1299 goes, then those 0x1234 leaves empty
+    radix_trie_delete(t, 0x1299, 16);
+    radix_trie_delete(t, 0x12, 8);
+    radix_trie_delete(t, 0x1234, 16);
+    radix_trie_counters(t, &c);
+    if (c.deletes != 3 || c.delete_frees < 2)
+        errors++;
+
+    printf("known shape: %llu splits, %llu composites, %llu frees, %d errors\n",
+           (unsigned long long)c.splits, (unsigned long long)c.composites,
+           (unsigned long long)c.delete_frees, errors);
+    radix_trie_delete_all(t);
+    return errors != 0;
+}
+
+/* even keys are there, odd ones not */
+static void*
+reader(void *arg)
+{
+    radix_trie_reader *rd = radix_trie_reader_new(trie);
+    unsigned seed = (unsigned)(long)arg;
+    long errors = 0;
+    int i;
+    void *v;
+
+    for (i = 0; i < FINDS; i++)
+    {
+        uint32_t k = rnd(&seed) % SIZE;
+
+        if (i % 256 == 0)
+        {
+            radix_trie_read_end(rd);
+            radix_trie_read_begin(rd);
+        }
+        k = i % 2 ? k | 1 : k & ~1u;
+        if (radix_trie_find(trie, k, 32, &v) != !(k & 1))
+            errors++;
+    }
+    radix_trie_read_end(rd);
+    return (void*)errors;
+}
+
+static int
+threads(void)
+{
+    pthread_t th[READERS];
+    struct radix_trie_counters c;
+    uint32_t keys[64];
+    void *vals[64];
+    int found[64];
+    long errors = 0;
+    int i;
+
+    trie = radix_trie_create(RADIX_TRIE_SHARED);
+    for (i = 0; i < SIZE; i += 2)
+        radix_trie_insert(trie, i, 32, (void*)(long)(i + 1));
+
+    for (i = 0; i < READERS; i++)
+        pthread_create(&th[i], 0, reader, (void*)(long)(i + 1));
+    for (i = 0; i < READERS; i++)
+    {
+        void *e;
+
+        pthread_join(th[i], &e);
+        errors += (long)e;
+    }
+
+    radix_trie_counters(trie, &c);
+    if (c.inserts != SIZE / 2 || c.finds != (uint64_t)READERS * FINDS || c.find_misses != c.finds / 2)
+        errors++;
+    if (c.find_nodes < c.finds)
+        errors++;
+
+    // batched lookups are counted as well
+    for (i = 0; i < 64; i++)
+        keys[i] = i;
+    radix_trie_find_batch(trie, keys, 0, 64, vals, found);
+    radix_trie_counters(trie, &c);
+    if (c.finds != (uint64_t)READERS * FINDS + 64 || c.find_misses != c.finds / 2)
+        errors++;
+
+    printf("threads: %llu finds, %.2f nodes a find, %ld errors\n", (unsigned long long)c.finds,
+           (double)c.find_nodes / c.finds, errors);
+    radix_trie_delete_all(trie);
+    return errors != 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    int errors = 0;
+
+    errors += known();
+    errors += threads();
+
+    return errors != 0;
+}
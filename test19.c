@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "radix-trie.h"
+
+/*
+ * collapse and compaction: keys inserted and then deleted again must
+ * leave a trie no deeper, and of hardly more nodes (nodes split for a
+ * key ending inside them stay split), than one the other keys were
+ * inserted in alone, finding what it holds all along. Steps of
+ * radix_trie_compact must keep the keys and not grow the trie, a
+ * snapshot taken before the deletes must still hold all keys.
+ */
+
+#define SIZE 6000
+#define CHURN 30000
+
+static uint64_t keys[SIZE + CHURN];
+static int lens[SIZE + CHURN];
+static long walked;
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+static void
+count(uint64_t key, int bit, void *v)
+{
+    walked++;
+}
+
+/* the first "kept" keys are there, with their index as value, the others not */
+static int
+check(nod *t, int kept, int all)
+{
+    int errors = 0, i;
+    void *v;
+
+    for (i = 0; i < all; i++)
+    {
+        int f = radix_trie_find64(t, keys[i], lens[i], &v);
+
+        if (i < kept ? !f || (long)v != i + 1 : f)
+            errors++;
+    }
+    walked = 0;
+    radix_trie_walk64(t, count);
+    if (walked != kept)
+        errors++;
+    return errors;
+}
+
+static int
+run(int order, int flags)
+{
+    nod *t = radix_trie_create(flags | RADIX_TRIE_ORDER(order));
+    nod *u = radix_trie_create(flags | RADIX_TRIE_ORDER(order));
+    nod *s = 0;
+    struct radix_trie_stats st, su, sc;
+    unsigned seed = order * 64 + flags + 1;
+    int errors = 0, i, steps = 0;
+
+    // keys kept have odd lengths, those churned even ones, dense and sparse
+    for (i = 0; i < SIZE + CHURN; i++)
+    {
+        uint64_t r = (uint64_t)rnd(&seed) << 32 | rnd(&seed);
+
+        if (i < SIZE)
+            lens[i] = i % 3 ? 33 + 2 * (rnd(&seed) % 16) : 31;
+        else
+            lens[i] = i % 3 ? 16 + 2 * (rnd(&seed) % 25) : 32;
+        keys[i] = i % 3 ? r & (~(uint64_t)0 >> (64 - lens[i])) : i < SIZE ? (uint64_t)i : r & 0xfffff;
+    }
+
+    for (i = 0; i < SIZE + CHURN; i++)
+        radix_trie_insert64(t, keys[i], lens[i], (void*)(long)(i + 1));
+    for (i = 0; i < SIZE; i++)
+        radix_trie_insert64(u, keys[i], lens[i], (void*)(long)(i + 1));
+
+    if (!(flags & RADIX_TRIE_SHARED))
+        s = radix_trie_snapshot(t);
+    for (i = SIZE; i < SIZE + CHURN; i++)
+        radix_trie_delete64(t, keys[i], lens[i]);
+    errors += check(t, SIZE, SIZE + CHURN);
+
+    if (s)
+    {
+        if (radix_trie_compact(t, 100) != 0)
+            errors++;
+        for (i = 0; i < SIZE + CHURN; i++)
+        {
+            void *v;
+
+            if (!radix_trie_find64(s, keys[i], lens[i], &v))
+                errors++;
+        }
+        radix_trie_delete_all(s);
+    }
+
+    radix_trie_stats(t, &st);
+    radix_trie_stats(u, &su);
+    if (st.depth > su.depth || st.nodes > su.nodes + su.nodes / 50)
+        errors++;
+
+    // a pass, a few nodes at a time, then one at once
+    while (radix_trie_compact(t, 64))
+    {
+        if (++steps % 16 == 0)
+            errors += check(t, SIZE, SIZE);
+    }
+    errors += check(t, SIZE, SIZE + CHURN);
+    radix_trie_stats(t, &sc);
+    if (sc.nodes > st.nodes || sc.bytes > st.bytes || steps < (int)(st.nodes / 64) - 1)
+        errors++;
+    if (radix_trie_compact(t, 1 << 30) != 0 || check(t, SIZE, SIZE))
+        errors++;
+
+    printf("order %d, flags %d: %lu nodes, %lu alone, %lu bytes, %lu compacted in %d steps, %d errors\n",
+           order, flags, (unsigned long)st.nodes, (unsigned long)su.nodes, (unsigned long)st.bytes,
+           (unsigned long)sc.bytes, steps, errors);
+    radix_trie_delete_all(t);
+    radix_trie_delete_all(u);
+    return errors != 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    static const int flags[] = { RADIX_TRIE_AUTO, RADIX_TRIE_FULL, RADIX_TRIE_COMPACT,
+                                 RADIX_TRIE_ARENA, RADIX_TRIE_SHARED };
+    int errors = 0, i;
+
+    for (i = 0; i < (int)(sizeof(flags) / sizeof(flags[0])); i++)
+    {
+        errors += run(4, flags[i]);
+        errors += run(2, flags[i]);
+    }
+
+    return errors != 0;
+}
@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "radix-trie.h"
+
+/*
+ * RADIX_TRIE_SET: random adds and removes of keys of mixed length, some
+ * of 8 bits or less, must leave what a plain array of flags holds,
+ * counted and walked, and so must unions, intersections and
+ * differences of two sets. A dense set must take about a bit a key.
+ */
+
+#define SIZE 5000
+#define OPS 50000
+
+static uint64_t keys[SIZE];
+static int lens[SIZE];
+static char in[2][SIZE];
+static nod *walked_set;
+static long walked, strays;
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+static void
+count(uint64_t key, int bit, void *v)
+{
+    walked++;
+    if (!radix_trie_set_has(walked_set, key >> (64 - bit), bit))
+        strays++;
+}
+
+static int
+check(nod *t, const char *model)
+{
+    long expect = 0;
+    int errors = 0, i;
+
+    for (i = 0; i < SIZE; i++)
+    {
+        if (radix_trie_set_has(t, keys[i], lens[i]) != model[i])
+            errors++;
+        expect += model[i];
+    }
+    if (radix_trie_set_count(t) != (size_t)expect)
+        errors++;
+
+    walked = strays = 0;
+    walked_set = t;
+    radix_trie_set_walk(t, count);
+    if (walked != expect || strays)
+        errors++;
+    return errors;
+}
+
+static int
+run(int flags)
+{
+    nod *t[2], *u;
+    struct radix_trie_stats st;
+    unsigned seed = flags + 1;
+    int errors = 0, i, j, n, s;
+
+    // distinct keys, clustered so leaves hold many, and short ones
+    for (i = 0; i < SIZE; i++)
+    {
+        do
+        {
+            lens[i] = i % 10 == 0 ? 1 + rnd(&seed) % 8 : 12 + rnd(&seed) % 53;
+            keys[i] = ((uint64_t)rnd(&seed) << 32 | rnd(&seed)) & (~(uint64_t)0 >> (64 - lens[i]));
+            if (i % 2 && lens[i] > 12)
+                keys[i] &= ~(uint64_t)0xfff00;
+            for (j = 0; j < i && (keys[j] != keys[i] || lens[j] != lens[i]); j++)
+                ;
+        } while (j < i);
+        in[0][i] = in[1][i] = 0;
+    }
+
+    for (s = 0; s < 2; s++)
+    {
+        t[s] = radix_trie_create(flags | RADIX_TRIE_SET);
+        for (n = 0; n < OPS; n++)
+        {
+            i = rnd(&seed) % SIZE;
+            if (n % 3 == 0)
+            {
+                if (radix_trie_set_remove(t[s], keys[i], lens[i]) != in[s][i])
+                    errors++;
+                in[s][i] = 0;
+            }
+            else
+            {
+                if (radix_trie_set_add(t[s], keys[i], lens[i]) != !in[s][i])
+                    errors++;
+                in[s][i] = 1;
+            }
+        }
+        errors += check(t[s], in[s]);
+    }
+
+    // u = t0, then u | t1, u & t1 and u - t1
+    for (n = 0; n < 3; n++)
+    {
+        u = radix_trie_create(flags | RADIX_TRIE_SET);
+        radix_trie_set_union(u, t[0]);
+        errors += check(u, in[0]);
+
+        if (n == 0)
+            radix_trie_set_union(u, t[1]);
+        else if (n == 1)
+            radix_trie_set_intersect(u, t[1]);
+        else
+            radix_trie_set_subtract(u, t[1]);
+
+        {
+            char m[SIZE];
+
+            for (i = 0; i < SIZE; i++)
+                m[i] = n == 0 ? in[0][i] | in[1][i] : n == 1 ? in[0][i] & in[1][i] : in[0][i] & !in[1][i];
+            errors += check(u, m);
+        }
+
+        // and with itself
+        radix_trie_set_intersect(u, u);
+        radix_trie_set_union(u, u);
+        radix_trie_set_subtract(u, u);
+        if (radix_trie_set_count(u) != 0)
+            errors++;
+        radix_trie_delete_all(u);
+    }
+
+    // no leaf is left once all keys are gone
+    for (i = 0; i < SIZE; i++)
+        radix_trie_set_remove(t[0], keys[i], lens[i]);
+    radix_trie_stats(t[0], &st);
+    if (radix_trie_set_count(t[0]) != 0 || st.keys != 0)
+        errors++;
+
+    printf("flags %d: %d errors\n", flags, errors);
+    radix_trie_delete_all(t[0]);
+    radix_trie_delete_all(t[1]);
+    return errors != 0;
+}
+
+/* bytes a key of the dense sets 0 .. size - 1 of 32 bit keys */
+static int
+dense(int size, double most)
+{
+    nod *t = radix_trie_create(RADIX_TRIE_SET);
+    nod *m = radix_trie_create(RADIX_TRIE_AUTO);
+    struct radix_trie_stats st, sm;
+    int errors = 0, i;
+
+    for (i = 0; i < size; i++)
+    {
+        radix_trie_set_add(t, i, 32);
+        radix_trie_insert(m, i, 32, (void*)(long)(i + 1));
+    }
+    radix_trie_stats(t, &st);
+    radix_trie_stats(m, &sm);
+    if ((double)st.bytes / size > most)
+        errors++;
+    for (i = 0; i < size; i++)
+        if (!radix_trie_set_has(t, i, 32))
+            errors++;
+
+    printf("dense 0 .. %d: %.2f bytes a key as a set, %.2f as a map, %d errors\n",
+           size - 1, (double)st.bytes / size, (double)sm.bytes / size, errors);
+    radix_trie_delete_all(t);
+    radix_trie_delete_all(m);
+    return errors != 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    int errors = 0;
+
+    errors += run(RADIX_TRIE_AUTO);
+    errors += run(RADIX_TRIE_FULL);
+    errors += run(RADIX_TRIE_ARENA);
+    errors += run(RADIX_TRIE_COMPACT | RADIX_TRIE_ORDER(2));
+
+    errors += dense(1024, 1.0);
+    errors += dense(1 << 20, 0.25);
+
+    if (radix_trie_create(RADIX_TRIE_SET | RADIX_TRIE_SHARED))
+        errors++;
+
+    return errors != 0;
+}
@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "radix-trie.h"
+
+/*
+ * radix_trie_insert_range: random ranges over each other, with keys
+ * inserted and deleted in and around them, must leave what a plain
+ * array of values holds, for radix_trie_find and the batch lookups,
+ * with keys of another length beside them untouched. A snapshot keeps
+ * the ranges it saw, a trie grown from NULL and a shared trie take the
+ * keys one by one. The CJK block of a CMap must take a few entries.
+ */
+
+#define BITS 14
+#define SIZE (1 << BITS)
+#define OPS 4000
+
+static uintptr_t model[SIZE];
+static char in[SIZE];
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+static int
+check(nod *t)
+{
+    static uint32_t keys[SIZE];
+    static void *vals[SIZE];
+    static int found[SIZE], lens[SIZE];
+    size_t hits = 0;
+    int errors = 0, i;
+    void *v;
+
+    for (i = 0; i < SIZE; i++)
+    {
+        int f = radix_trie_find(t, i, BITS, &v);
+
+        if (f != in[i] || (f && (uintptr_t)v != model[i]))
+            errors++;
+        keys[i] = i;
+        lens[i] = BITS;
+        hits += in[i];
+    }
+
+    if (radix_trie_find_batch(t, keys, lens, SIZE, vals, found) != hits)
+        errors++;
+    for (i = 0; i < SIZE; i++)
+    {
+        if (found[i] != in[i] || (found[i] && (uintptr_t)vals[i] != model[i]))
+            errors++;
+    }
+
+    // the keys of 8 bits, from the other end of the value space
+    for (i = 0; i < 256; i++)
+    {
+        if (!radix_trie_find(t, i, 8, &v) || (uintptr_t)v != ~(uintptr_t)i)
+            errors++;
+    }
+    return errors;
+}
+
+static int
+run(int flags)
+{
+    nod *t = radix_trie_create(flags);
+    nod *s = 0;
+    static uintptr_t kept[SIZE];
+    static char kept_in[SIZE];
+    unsigned seed = flags + 1;
+    int errors = 0, i, op;
+    void *v;
+
+    for (i = 0; i < SIZE; i++)
+        in[i] = 0;
+    for (i = 0; i < 256; i++)
+        radix_trie_insert(t, i, 8, (void*)~(uintptr_t)i);
+
+    for (op = 0; op < OPS; op++)
+    {
+        uint32_t lo = rnd(&seed) % SIZE, hi;
+        uintptr_t base = rnd(&seed);
+        int r = rnd(&seed) % 8;
+
+        if (r < 3)
+        {
+            hi = lo + rnd(&seed) % (r == 0 ? SIZE / 4 : 64);
+            if (hi >= SIZE)
+                hi = SIZE - 1;
+            radix_trie_insert_range(t, lo, hi, BITS, (void*)base);
+            for (i = lo; i <= (int)hi; i++)
+            {
+                model[i] = base + (i - lo);
+                in[i] = 1;
+            }
+        }
+        else if (r < 6)
+        {
+            radix_trie_insert(t, lo, BITS, (void*)base);
+            model[lo] = base;
+            in[lo] = 1;
+        }
+        else
+        {
+            if (radix_trie_delete(t, lo, BITS) != in[lo])
+                errors++;
+            in[lo] = 0;
+        }
+
+        if (op == OPS / 2)
+        {
+            s = radix_trie_snapshot(t);
+            for (i = 0; i < SIZE; i++)
+            {
+                kept[i] = model[i];
+                kept_in[i] = in[i];
+            }
+        }
+        if (op % 500 == 0)
+            errors += check(t);
+    }
+    errors += check(t);
+
+    if (s)
+    {
+        for (i = 0; i < SIZE; i++)
+        {
+            int f = radix_trie_find(s, i, BITS, &v);
+
+            if (f != kept_in[i] || (f && (uintptr_t)v != kept[i]))
+                errors++;
+        }
+        radix_trie_delete_all(s);
+    }
+
+    // a range over all keys of the length, then none
+    radix_trie_insert_range(t, 0, SIZE - 1, BITS, (void*)1);
+    for (i = 0; i < SIZE; i++)
+    {
+        model[i] = i + 1;
+        in[i] = 1;
+    }
+    errors += check(t);
+    for (i = 0; i < SIZE; i++)
+        radix_trie_delete(t, i, BITS);
+    for (i = 0; i < SIZE; i++)
+        in[i] = 0;
+    errors += check(t);
+
+    printf("flags %d: %d errors\n", flags, errors);
+    radix_trie_delete_all(t);
+    return errors != 0;
+}
+
+/* tries that take the keys one by one, and keys of 64 bits */
+static int
+others(void)
+{
+    nod *t = 0, *u = radix_trie_create(RADIX_TRIE_SHARED), *w = radix_trie_create(RADIX_TRIE_AUTO);
+    uint64_t top = ~(uint64_t)0;
+    int errors = 0;
+    void *v;
+
+    t = radix_trie_insert_range(t, 10, 20, 16, (void*)100);
+    u = radix_trie_insert_range(u, 10, 20, 16, (void*)100);
+    if (!radix_trie_find(t, 15, 16, &v) || (uintptr_t)v != 105 || radix_trie_find(t, 21, 16, &v))
+        errors++;
+    if (!radix_trie_find(u, 20, 16, &v) || (uintptr_t)v != 110 || radix_trie_find(u, 9, 16, &v))
+        errors++;
+
+    // all of the keys of 64 bits, in two blocks
+    radix_trie_insert_range64(w, 0, top, 64, (void*)0);
+    if (!radix_trie_find64(w, top, 64, &v) || (uintptr_t)v != (uintptr_t)top)
+        errors++;
+    if (!radix_trie_find64(w, top / 2 + 1, 64, &v) || (uintptr_t)v != (uintptr_t)(top / 2 + 1))
+        errors++;
+    radix_trie_delete64(w, top / 2, 64);
+    if (radix_trie_find64(w, top / 2, 64, &v) || !radix_trie_find64(w, top / 2 - 1, 64, &v))
+        errors++;
+
+    // bad ranges change nothing
+    radix_trie_insert_range(w, 5, 4, 16, 0);
+    radix_trie_insert_range(w, 0, 1 << 16, 16, 0);
+    if (radix_trie_find(w, 5, 16, &v) || radix_trie_find(w, 0, 16, &v))
+        errors++;
+    if (radix_trie_save(w, "test21.img") == 0 || radix_trie_freeze(w))
+        errors++;
+
+    printf("others: %d errors\n", errors);
+    radix_trie_delete_all(t);
+    radix_trie_delete_all(u);
+    radix_trie_delete_all(w);
+    return errors != 0;
+}
+
+/* the CJK ideographs of a CMap, from CID 1234 on */
+static int
+cmap(void)
+{
+    nod *t = radix_trie_create(RADIX_TRIE_AUTO);
+    nod *k = radix_trie_create(RADIX_TRIE_AUTO);
+    struct radix_trie_stats st, sk;
+    int errors = 0, i;
+    void *v;
+
+    radix_trie_insert_range(t, 0x4e00, 0x9fff, 16, (void*)1234);
+    for (i = 0x4e00; i <= 0x9fff; i++)
+        radix_trie_insert(k, i, 16, (void*)(uintptr_t)(1234 + i - 0x4e00));
+    for (i = 0x4d00; i <= 0xa0ff; i++)
+    {
+        void *w;
+        int f = radix_trie_find(t, i, 16, &v);
+
+        if (f != radix_trie_find(k, i, 16, &w) || (f && v != w))
+            errors++;
+    }
+
+    radix_trie_stats(t, &st);
+    radix_trie_stats(k, &sk);
+    if (st.bytes * 20 > sk.bytes)
+        errors++;
+
+    printf("cmap: %lu bytes, against %lu for the keys one by one, %d errors\n",
+           (unsigned long)st.bytes, (unsigned long)sk.bytes, errors);
+    radix_trie_delete_all(t);
+    radix_trie_delete_all(k);
+    return errors != 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    static const int flags[] = { RADIX_TRIE_AUTO, RADIX_TRIE_FULL | RADIX_TRIE_ORDER(2),
+                                 RADIX_TRIE_COMPACT, RADIX_TRIE_ARENA | RADIX_TRIE_ORDER(5) };
+    int errors = 0, i;
+
+    for (i = 0; i < (int)(sizeof(flags) / sizeof(flags[0])); i++)
+        errors += run(flags[i]);
+    errors += others();
+    errors += cmap();
+
+    return errors != 0;
+}
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "radix-trie.h"
+
+/*
+ * radix_trie_build_parallel: random, dense and clustered keys, of one
+ * and of mixed lengths, some given twice, built on a few threads into
+ * tries of each layout and order, must hold what inserts one by one
+ * give, entry by entry in cursor order, and the nodes must add up.
+ * Random 32 bit keys must give the nodes and slots radix_trie_build_sorted
+ * gives, at orders whose nodes do not line up on 32 and 64 bits alike.
+ */
+
+#define SIZE 100000
+
+static uint64_t keys[SIZE];
+static uint32_t keys32[SIZE];
+static int lens[SIZE];
+static void *values[SIZE];
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+/* the same entries, in the same order */
+static int
+same(nod *t, nod *u)
+{
+    radix_trie_cursor c, d;
+    int errors = 0, more = radix_trie_first(&c, t);
+
+    if (radix_trie_first(&d, u) != more)
+        return 1;
+    while (more)
+    {
+        if (c.key != d.key || c.len != d.len || c.value != d.value)
+            errors++;
+        more = radix_trie_next(&c);
+        if (radix_trie_next(&d) != more)
+            return errors + 1;
+    }
+    return errors;
+}
+
+static int
+nodes(nod *t)
+{
+    struct radix_trie_stats st;
+
+    if (radix_trie_stats(t, &st) != 0)
+        return 1;
+    return st.nodes && st.internal + st.composite != st.nodes - 1;
+}
+
+static int
+run(int kind, int flags, int threads)
+{
+    static const char *kinds[] = { "random", "dense", "clustered", "mixed" };
+    nod *t = radix_trie_create(flags), *u = radix_trie_create(flags);
+    unsigned seed = kind * 64 + flags + threads;
+    int errors = 0, i;
+
+    for (i = 0; i < SIZE; i++)
+    {
+        uint64_t r = (uint64_t)rnd(&seed) << 32 | rnd(&seed);
+
+        switch (kind)
+        {
+            case 0: lens[i] = 32; keys[i] = r & 0xffffffff; break;
+            case 1: lens[i] = 32; keys[i] = i * 3; break;
+            case 2: lens[i] = 64; keys[i] = (uint64_t)0x5a5a5a5a5a5 << 20 | (r & 0xfffff); break;
+            default:
+                lens[i] = i % 50 ? 6 + r % 59 : 1 + r % 8;
+                keys[i] = r >> 8 & (~(uint64_t)0 >> (64 - lens[i]));
+                break;
+        }
+        if (i % 7 == 0 && i > 0)
+        {
+            int j = rnd(&seed) % i;
+
+            keys[i] = keys[j];
+            lens[i] = lens[j];
+        }
+        keys32[i] = (uint32_t)keys[i];
+        values[i] = (void*)(long)(i + 1);
+        radix_trie_insert64(u, keys[i], lens[i], values[i]);
+    }
+
+    if (kind == 3)
+        radix_trie_build_parallel64(t, keys, lens, values, SIZE, threads);
+    else if (kind == 2)
+        radix_trie_build_parallel64(t, keys, 0, values, SIZE, threads);
+    else
+        radix_trie_build_parallel(t, keys32, 0, values, SIZE, threads);
+
+    errors += same(t, u);
+    errors += nodes(t);
+
+    printf("%-9s flags %4d, %d threads: %d errors\n", kinds[kind], flags, threads, errors);
+    radix_trie_delete_all(t);
+    radix_trie_delete_all(u);
+    return errors != 0;
+}
+
+static int
+cmp32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* the same shape as a bulk load of the keys sorted */
+static int
+shape(int order, int threads)
+{
+    nod *t = radix_trie_create(RADIX_TRIE_AUTO | RADIX_TRIE_ORDER(order));
+    nod *u = radix_trie_create(RADIX_TRIE_AUTO | RADIX_TRIE_ORDER(order));
+    struct radix_trie_stats a, b;
+    unsigned seed = order;
+    int errors = 0, i;
+
+    for (i = 0; i < SIZE; i++)
+    {
+        keys32[i] = rnd(&seed);
+        values[i] = (void*)(long)(i + 1);
+    }
+    radix_trie_build_parallel(t, keys32, 0, values, SIZE, threads);
+    qsort(keys32, SIZE, sizeof(keys32[0]), cmp32);
+    radix_trie_build_sorted(u, keys32, 0, values, SIZE);
+
+    if (radix_trie_stats(t, &a) != 0 || radix_trie_stats(u, &b) != 0 ||
+        a.nodes != b.nodes || a.slots != b.slots || a.keys != b.keys)
+        errors++;
+
+    printf("order %d, %d threads: %lu nodes, %lu built sorted, %d errors\n", order, threads,
+           (unsigned long)a.nodes, (unsigned long)b.nodes, errors);
+    radix_trie_delete_all(t);
+    radix_trie_delete_all(u);
+    return errors != 0;
+}
+
+/* a NULL root, and a trie that is not empty, as inserts give */
+static int
+others(void)
+{
+    nod *t = 0, *u = radix_trie_create(RADIX_TRIE_AUTO), *v = radix_trie_create(RADIX_TRIE_AUTO);
+    int errors = 0, i;
+
+    for (i = 0; i < SIZE; i++)
+    {
+        keys32[i] = i * 7;
+        values[i] = (void*)(long)(i + 1);
+        radix_trie_insert(v, keys32[i], 32, values[i]);
+    }
+    t = radix_trie_build_parallel(t, keys32, 0, values, SIZE, 4);
+    errors += same(t, v);
+
+    radix_trie_insert(u, 0, 32, values[0]);
+    radix_trie_build_parallel(u, keys32, 0, values, SIZE, 4);
+    errors += same(u, v);
+
+    printf("others: %d errors\n", errors);
+    radix_trie_delete_all(t);
+    radix_trie_delete_all(u);
+    radix_trie_delete_all(v);
+    return errors != 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    static const int flags[] = { RADIX_TRIE_AUTO, RADIX_TRIE_FULL, RADIX_TRIE_COMPACT, RADIX_TRIE_ARENA,
+                                 RADIX_TRIE_ORDER(1), RADIX_TRIE_ORDER(3), RADIX_TRIE_ORDER(5) | RADIX_TRIE_ARENA };
+    int errors = 0, kind, i;
+
+    for (kind = 0; kind < 4; kind++)
+        for (i = 0; i < (int)(sizeof(flags) / sizeof(flags[0])); i++)
+            errors += run(kind, flags[i], 1 + i % 2 * 3 + (i == 6) * 4);
+    errors += shape(3, 4);
+    errors += shape(5, 4);
+    errors += others();
+
+    return errors != 0;
+}
@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "radix-trie.h"
+
+/*
+ * radix_trie_walk_parallel and radix_trie_destroy_parallel: tries of
+ * random keys of mixed length, of each layout and order, walked on a
+ * few threads, must give what radix_trie_walk gives, each entry once
+ * on a thread of the range, summed up per thread; in the same order,
+ * one call at a time, for an ordered walk. Destroying them, and sets,
+ * string tries, a trie grown from NULL, tries of an arena, shared ones
+ * and snapshots, must call fn once for each entry, with key 0 and bit 0
+ * for string keys, which the walks leave alone.
+ */
+
+#define SIZE 60000
+#define THREADS 8
+
+struct sums
+{
+    long count;
+    uint64_t keys;
+    uintptr_t values;
+    char pad[40];
+};
+
+struct entry
+{
+    uint64_t key;
+    int bit;
+    void *value;
+};
+
+static struct entry walked[SIZE + 1], ordered[SIZE + 1];
+static long nwalked, nordered;
+static int inside, overlaps;
+
+static uint32_t
+rnd(unsigned *seed)
+{
+    return ((uint32_t)rand_r(seed) << 16) ^ (uint32_t)rand_r(seed);
+}
+
+static void
+walk(uint64_t key, int bit, void *v)
+{
+    if (nwalked <= SIZE)
+    {
+        walked[nwalked].key = key;
+        walked[nwalked].bit = bit;
+        walked[nwalked].value = v;
+    }
+    nwalked++;
+}
+
+static void
+walk32(uint32_t key, int bit, void *v)
+{
+    walk((uint64_t)key << 32, bit, v);
+}
+
+static void
+walk_str(const void *key, size_t len, void *v)
+{
+    walk(0, 0, v);
+}
+
+/* arg holds a sum for each thread */
+static void
+sum(uint64_t key, int bit, void *v, int thread, void *arg)
+{
+    struct sums *s = (struct sums*)arg;
+
+    if (thread < 0 || thread >= THREADS)
+    {
+        __atomic_fetch_add(&overlaps, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    s[thread].count++;
+    s[thread].keys += key * 31 + bit;
+    s[thread].values += (uintptr_t)v;
+}
+
+static void
+sum32(uint32_t key, int bit, void *v, int thread, void *arg)
+{
+    sum((uint64_t)key << 32, bit, v, thread, arg);
+}
+
+static void
+in_order(uint64_t key, int bit, void *v, int thread, void *arg)
+{
+    if (__atomic_add_fetch(&inside, 1, __ATOMIC_ACQUIRE) != 1)
+        overlaps++;
+    if (nordered <= SIZE)
+    {
+        ordered[nordered].key = key;
+        ordered[nordered].bit = bit;
+        ordered[nordered].value = v;
+    }
+    nordered++;
+    __atomic_sub_fetch(&inside, 1, __ATOMIC_RELEASE);
+}
+
+/* the sums of the threads against those of the entries walked */
+static int
+compare(struct sums *s, int threads)
+{
+    struct sums all = { 0, 0, 0, { 0 } };
+    long i;
+
+    for (i = 0; i < THREADS; i++)
+    {
+        if (i >= threads && s[i].count)
+            return 1;
+        all.count += s[i].count;
+        all.keys += s[i].keys;
+        all.values += s[i].values;
+        s[i].count = s[i].keys = s[i].values = 0;
+    }
+    for (i = 0; i < nwalked && i <= SIZE; i++)
+    {
+        all.count--;
+        all.keys -= walked[i].key * 31 + walked[i].bit;
+        all.values -= (uintptr_t)walked[i].value;
+    }
+    return all.count || all.keys || all.values;
+}
+
+static int
+run(int flags, int threads)
+{
+    static struct sums s[THREADS];
+    nod *t = radix_trie_create(flags);
+    unsigned seed = flags + threads;
+    int errors = 0, i;
+    long n;
+
+    for (i = 0; i < SIZE; i++)
+    {
+        uint64_t r = (uint64_t)rnd(&seed) << 32 | rnd(&seed);
+        int len = i % 4 ? 8 + r % 57 : 32;
+
+        radix_trie_insert64(t, i % 4 ? r >> 8 & (~(uint64_t)0 >> (64 - len)) : (uint64_t)i * 5, len,
+                            (void*)(long)(i + 1));
+    }
+
+    nwalked = 0;
+    radix_trie_walk64(t, walk);
+    radix_trie_walk_parallel64(t, sum, s, threads, 0);
+    errors += compare(s, threads);
+
+    nordered = 0;
+    radix_trie_walk_parallel64(t, in_order, 0, threads, RADIX_TRIE_WALK_ORDERED);
+    if (nordered != nwalked)
+        errors++;
+    for (n = 0; n < nwalked && n <= SIZE; n++)
+    {
+        if (ordered[n].key != walked[n].key || ordered[n].bit != walked[n].bit ||
+            ordered[n].value != walked[n].value)
+            errors++;
+    }
+
+    nwalked = 0;
+    radix_trie_walk(t, walk32);
+    radix_trie_walk_parallel(t, sum32, s, threads, 0);
+    errors += compare(s, threads);
+
+    radix_trie_destroy_parallel(t, sum32, s, threads);
+    errors += compare(s, threads);
+
+    printf("flags %4d, %d threads: %ld entries, %d errors\n", flags, threads, nwalked, errors);
+    return errors != 0;
+}
+
+/* destroy a trie, against its walk, that of its strings for a string trie */
+static int
+destroy(nod *t, int threads, int strings)
+{
+    static struct sums s[THREADS];
+
+    nwalked = 0;
+    if (strings)
+        radix_trie_walk_str(t, 0, 0, walk_str);
+    else
+        radix_trie_walk(t, walk32);
+    radix_trie_destroy_parallel(t, sum32, s, threads);
+    return compare(s, threads);
+}
+
+static int
+others(void)
+{
+    nod *t = 0, *u, *v, *w, *x = 0, *y;
+    unsigned seed = 3;
+    int errors = 0, i;
+
+    u = radix_trie_create(RADIX_TRIE_SET);
+    v = radix_trie_create(RADIX_TRIE_ARENA);
+    w = radix_trie_create(RADIX_TRIE_SHARED);
+    y = radix_trie_create(RADIX_TRIE_AUTO);
+    for (i = 0; i < SIZE; i++)
+    {
+        uint32_t r = rnd(&seed);
+        char s[12];
+        int j, len = 1 + r % sizeof(s);
+
+        t = radix_trie_insert(t, r, 32, (void*)(long)(i + 1));
+        radix_trie_set_add(u, r >> (r % 24), 8 + r % 24);
+        radix_trie_insert(v, r, 32, (void*)(long)(i + 1));
+        if (i % 8 == 0)
+            radix_trie_insert(w, r, 32, (void*)(long)(i + 1));
+        for (j = 0; j < len; j++)
+            s[j] = 'a' + (r >> (2 * j)) % 4;
+        x = radix_trie_insert_str(x, s, len, (void*)(long)(i + 1));
+        radix_trie_insert(y, r >> 8, 24, (void*)(long)(i + 1));
+    }
+
+    errors += destroy(t, 4, 0);
+    errors += destroy(u, 3, 0);
+    errors += destroy(v, 4, 0);
+    errors += destroy(w, 2, 0);
+    // the walks leave string keys alone
+    nwalked = nordered = 0;
+    radix_trie_walk(x, walk32);
+    radix_trie_walk_parallel64(x, in_order, 0, 4, 0);
+    if (nwalked || nordered)
+        errors++;
+    errors += destroy(x, 4, 1);
+
+    // and so does radix_trie_destroy, which hands their values
+    x = radix_trie_insert_str(0, "ab", 2, (void*)1);
+    x = radix_trie_insert_str(x, "abc", 3, (void*)2);
+    x = radix_trie_insert_str(x, "b", 1, (void*)4);
+    nwalked = 0;
+    radix_trie_destroy(x, walk32);
+    if (nwalked != 3 || walked[0].key || walked[0].bit ||
+        (uintptr_t)walked[0].value + (uintptr_t)walked[1].value + (uintptr_t)walked[2].value != 7)
+        errors++;
+
+    // a snapshot, then the trie, and tries with a few keys or none
+    t = radix_trie_snapshot(y);
+    errors += destroy(t, 4, 0);
+    errors += destroy(y, 4, 0);
+    t = radix_trie_create(RADIX_TRIE_AUTO);
+    radix_trie_walk_parallel(t, sum32, 0, 4, RADIX_TRIE_WALK_ORDERED);
+    radix_trie_insert(t, 7, 32, (void*)1);
+    errors += destroy(t, 4, 0);
+    radix_trie_delete_all_parallel(radix_trie_create(RADIX_TRIE_AUTO), 4);
+    radix_trie_delete_all_parallel(0, 4);
+    radix_trie_walk_parallel(0, sum32, 0, 4, 0);
+
+    printf("others: %d errors\n", errors);
+    return errors != 0;
+}
+
+int
+main(int argc, char **argv)
+{
+    static const int flags[] = { RADIX_TRIE_AUTO, RADIX_TRIE_FULL, RADIX_TRIE_COMPACT,
+                                 RADIX_TRIE_ORDER(1), RADIX_TRIE_ORDER(5) | RADIX_TRIE_FULL };
+    int errors = 0, i;
+
+    for (i = 0; i < (int)(sizeof(flags) / sizeof(flags[0])); i++)
+    {
+        errors += run(flags[i], 1 + i % 4);
+        errors += run(flags[i], THREADS);
+    }
+    errors += others();
+    if (overlaps)
+        errors++;
+
+    return errors != 0;
+}
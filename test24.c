@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "radix-trie-int.h"
+
+/*
+ * node classes of RADIX_TRIE_AUTO, built with -DRADIX_ORDER_MAX=6: a
+ * node of order 6 filled slot by slot, in random order, must go
+ * through the compact classes of 1, 4 and 16 slots, the indexed one of
+ * RT_INDEXED_MIN (48) and the full node, and back down as slots go,
+ * leaving a class only once a quarter of the smaller one would still be
+ * free. Going back and forth across a boundary must not change the
+ * class until then, and every key must be found all along.
+ */
+
+#define ORDER 6
+#define SLOTS (1 << ORDER)
+
+static const int classes[] = { 1, 4, 16, 48, SLOTS };
+
+/* the class a node of count slots is made in */
+static int
+fit(int count)
+{
+    int i;
+
+    for (i = 0; classes[i] < count; i++)
+        ;
+    return classes[i];
+}
+
+static int
+kind_of(int cap)
+{
+    if (cap == SLOTS)
+        return RT_FULL;
+    return cap < RT_INDEXED_MIN ? RT_COMPACT : RT_INDEXED;
+}
+
+/* the node of keys 0x2a << ORDER | j */
+static nod*
+node(nod *t)
+{
+    nod *top = radix_trie_top(t);
+    int i = radix_trie_find_slot(radix_trie_key(0x2a << ORDER, 2 * ORDER), top->order, top->crit_bit);
+
+    if (radix_trie_get_nodetype(top, i) != n_internal)
+        return 0;
+    return RT_CHILD(top, i);
+}
+
+static int
+check(nod *t, const char *in, int cap)
+{
+    nod *n = node(t);
+    int errors = 0, j;
+    void *v;
+
+    for (j = 0; j < SLOTS; j++)
+    {
+        int f = radix_trie_find(t, 0x2a << ORDER | j, 2 * ORDER, &v);
+
+        if (f != in[j] || (f && (long)v != j + 1))
+            errors++;
+    }
+    if (!n || n->crit_bit != ORDER || n->cap != cap || n->kind != kind_of(cap))
+    {
+        printf("cap %d, kind %d, expected %d, %d\n", n ? n->cap : -1, n ? n->kind : -1, cap, kind_of(cap));
+        errors++;
+    }
+    return errors;
+}
+
+static void
+add(nod *t, char *in, int *count, int *cap, int j)
+{
+    radix_trie_insert(t, 0x2a << ORDER | j, 2 * ORDER, (void*)(long)(j + 1));
+    in[j] = 1;
+    if (++*count > *cap)
+        *cap = fit(*count);
+}
+
+static void
+del(nod *t, char *in, int *count, int *cap, int j)
+{
+    int c;
+
+    radix_trie_delete(t, 0x2a << ORDER | j, 2 * ORDER);
+    in[j] = 0;
+    c = fit(--*count);
+    if (c < *cap && *count <= c - c / 4)
+        *cap = c;
+}
+
+int
+main(int argc, char **argv)
+{
+    nod *t = radix_trie_create(RADIX_TRIE_AUTO | RADIX_TRIE_ORDER(ORDER));
+    char in[SLOTS] = { 0 };
+    int order[SLOTS];
+    int errors = 0, count = 0, cap = 0, i, r;
+    unsigned seed = 1;
+
+    // a key beside them keeps the node below the root
+    radix_trie_insert(t, 0x15 << ORDER, 2 * ORDER, (void*)1);
+
+    for (i = 0; i < SLOTS; i++)
+        order[i] = i;
+    for (i = SLOTS - 1; i > 0; i--)
+    {
+        int j = rand_r(&seed) % (i + 1), x = order[i];
+
+        order[i] = order[j];
+        order[j] = x;
+    }
+
+    // up through every class
+    for (i = 0; i < SLOTS; i++)
+    {
+        add(t, in, &count, &cap, order[i]);
+        errors += check(t, in, cap);
+    }
+
+    // down to a single slot
+    for (i = 0; i < SLOTS - 1; i++)
+    {
+        del(t, in, &count, &cap, order[i]);
+        errors += check(t, in, cap);
+    }
+
+    // back and forth across each boundary, and past its hysteresis
+    for (r = 1; r < (int)(sizeof(classes) / sizeof(classes[0])); r++)
+    {
+        int b = classes[r - 1];
+
+        while (count < b + 1)
+        {
+            for (i = 0; in[order[i]]; i++)
+                ;
+            add(t, in, &count, &cap, order[i]);
+            errors += check(t, in, cap);
+        }
+        for (i = 0; i < 3; i++)
+        {
+            int j;
+
+            for (j = 0; !in[order[j]]; j++)
+                ;
+            del(t, in, &count, &cap, order[j]);
+            errors += check(t, in, cap);
+            for (j = 0; in[order[j]]; j++)
+                ;
+            add(t, in, &count, &cap, order[j]);
+            errors += check(t, in, cap);
+        }
+    }
+    while (count > 1)
+    {
+        for (i = 0; !in[order[i]]; i++)
+            ;
+        del(t, in, &count, &cap, order[i]);
+        errors += check(t, in, cap);
+    }
+
+    printf("%d errors\n", errors);
+    radix_trie_delete_all(t);
+    return errors != 0;
+}
@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "radix-trie-int.h"
+
+/*
+ * the slot decoding of the batched lookups: each version the cpu runs,
+ * called directly on nodes of random slot types, of every order and
+ * crit_bit, for batches of 0 to 16 random keys, must give the slots
+ * and slot types of the plain C one.
+ */
+
+#define BATCH 16
+#define ROUNDS 64
+
+static uint64_t
+rnd(unsigned *seed)
+{
+    return (uint64_t)rand_r(seed) << 42 ^ (uint64_t)rand_r(seed) << 21 ^ (uint64_t)rand_r(seed);
+}
+
+int
+main(int argc, char **argv)
+{
+    static const char *names[] = { "scalar", "sse2", "avx2" };
+    radix_trie_slots_fn scalar = radix_trie_slots_kernel(RT_SLOTS_SCALAR);
+    nod *n = (nod*)calloc(1, NODE_SIZE(0));
+    unsigned seed = 1;
+    int errors = 0, which;
+
+    for (which = RT_SLOTS_SSE2; which <= RT_SLOTS_AVX2; which++)
+    {
+        radix_trie_slots_fn f = radix_trie_slots_kernel(which);
+        int order, crit_bit, r, i, e = 0;
+        long calls = 0;
+
+        if (!f)
+        {
+            printf("%s: not run by this cpu\n", names[which]);
+            continue;
+        }
+
+        for (order = 1; order <= RADIX_ORDER_MAX; order++)
+            for (crit_bit = 0; crit_bit + order <= KEYSIZE_MAX; crit_bit++)
+                for (r = 0; r < ROUNDS; r++)
+                {
+                    uint64_t k[BATCH];
+                    int slot[BATCH], nt[BATCH], slot0[BATCH], nt0[BATCH];
+                    int count = r % (BATCH + 1);
+                    tag_t all = (1 << order) == 8 * (int)sizeof(tag_t) ? ~(tag_t)0 : ((tag_t)1 << (1 << order)) - 1;
+
+                    n->order = order;
+                    n->crit_bit = crit_bit;
+                    n->tag = (tag_t)rnd(&seed) & all;
+                    n->tag1 = (tag_t)rnd(&seed) & all;
+                    for (i = 0; i < BATCH; i++)
+                    {
+                        k[i] = rnd(&seed);
+                        slot[i] = slot0[i] = nt[i] = nt0[i] = -1;
+                    }
+
+                    scalar(n, k, count, slot0, nt0);
+                    f(n, k, count, slot, nt);
+                    calls++;
+                    for (i = 0; i < BATCH; i++)
+                    {
+                        if (slot[i] != slot0[i] || nt[i] != nt0[i])
+                            e++;
+                    }
+                }
+
+        printf("%s: %ld batches, %d errors\n", names[which], calls, e);
+        errors += e;
+    }
+
+    free(n);
+    return errors != 0;
+}
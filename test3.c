@@ -0,0 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "radix-trie.h"
+
+/*
+ * test2 workload on each node layout, with and without the arena,
+ * every key must be found and deleted, whatever the layout.
+ */
+
+static const char *layouts[] = { "auto", "full", "compact" };
+
+int
+main(int argc, char **argv)
+{
+
+    nod *trie;
+    void *val;
+
+    int i, l, size = 1024;
+    int arr[1024];
+    int errors = 0;
+
+    for (l = 0; l < 6; l++)
+    {
+        srand(1);
+        trie = radix_trie_create(l % 3 | (l < 3 ? 0 : RADIX_TRIE_ARENA));
+
+        for (i = 0; i < size; i++)
+        {
+            arr[i] = rand();
+            trie = radix_trie_insert(trie, arr[i], 32, (void*)(long)arr[i]);
+        }
+
+        for (i = 0; i < size; i++)
+        {
+            if (!radix_trie_find(trie, arr[i], 32, &val) || (long)val != arr[i])
+            {
+                printf("key = %08X is not found\n", arr[i]);
+                errors++;
+            }
+        }
+
+        // keys never inserted
+        for (i = 0; i < size; i++)
+        {
+            if (radix_trie_find(trie, arr[i] ^ 0x10, 32, &val))
+            {
+                printf("key = %08X should not be found\n", arr[i] ^ 0x10);
+                errors++;
+            }
+        }
+
+        // delete all entries
+        for (i = 0; i < size; i++)
+        {
+            if (!radix_trie_delete(trie, arr[i], 32))
+            {
+                printf("key = %08X is not deleted\n", arr[i]);
+                errors++;
+            }
+        }
+
+        for (i = 0; i < size; i++)
+        {
+            if (radix_trie_find(trie, arr[i], 32, &val))
+            {
+                printf("key = %08X is still found\n", arr[i]);
+                errors++;
+            }
+        }
+
+        // the arena hands out the deleted nodes again
+        for (i = 0; i < size; i++)
+        {
+            trie = radix_trie_insert(trie, arr[i], 32, (void*)(long)arr[i]);
+        }
+        for (i = 0; i < size; i++)
+        {
+            if (!radix_trie_find(trie, arr[i], 32, &val) || (long)val != arr[i])
+            {
+                printf("key = %08X is not found again\n", arr[i]);
+                errors++;
+            }
+        }
+
+        printf("%s layout%s, %d errors\n", layouts[l % 3], l < 3 ? "" : " in arena", errors);
+
+        // delete the whole tree
+        radix_trie_delete_all(trie);
+    }
+
+    return errors != 0;
+}
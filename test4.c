@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "radix-trie.h"
+
+/*
+ * 64 bit keys: (tenant << 32 | id) composite ids, and IPv6 routing
+ * prefixes of /32, /48 and /64 in the same trie.
+ */
+
+struct pair
+{
+    uint64_t k;
+    int  len;
+    long v;
+};
+
+
+static struct pair prefixes[]=
+{
+    {0x20010db8ULL, 32, 1},
+    {0x20010db80001ULL, 48, 2},
+    {0x20010db80002ULL, 48, 3},
+    {0x20010db800010000ULL, 64, 4},
+    {0x20010db800010001ULL, 64, 5},
+    {0x20010db8000100ffULL, 64, 6},
+    {0xfe80000000000000ULL, 64, 7},
+};
+
+static int walked;
+
+static void
+count_entry(uint64_t key, int bit, void *v)
+{
+    walked++;
+}
+
+int
+main(int argc, char **argv)
+{
+
+    nod *trie = 0;
+    void *val;
+    uint64_t key;
+
+    int i, t, size = 1024;
+    int errors = 0;
+
+    for (t = 0; t < 4; t++)
+    {
+        for (i = 0; i < size; i++)
+        {
+            key = ((uint64_t)t << 32) | (uint32_t)(i * 2654435761U);
+            trie = radix_trie_insert64(trie, key, 64, (void*)(long)(t * size + i));
+        }
+    }
+
+    for (i = 0; i < sizeof(prefixes)/sizeof(struct pair); i++)
+    {
+        trie = radix_trie_insert64(trie, prefixes[i].k, prefixes[i].len, (void*)prefixes[i].v);
+    }
+
+    for (t = 0; t < 4; t++)
+    {
+        for (i = 0; i < size; i++)
+        {
+            key = ((uint64_t)t << 32) | (uint32_t)(i * 2654435761U);
+            if (!radix_trie_find64(trie, key, 64, &val) || (long)val != t * size + i)
+            {
+                printf("key = %016llX is not found\n", (unsigned long long)key);
+                errors++;
+            }
+        }
+    }
+
+    for (i = 0; i < sizeof(prefixes)/sizeof(struct pair); i++)
+    {
+        if (radix_trie_find64(trie, prefixes[i].k, prefixes[i].len, &val) && (long)val == prefixes[i].v)
+        {
+            printf("%016llX/%d Found, of Value = %ld\n",
+                   (unsigned long long)prefixes[i].k, prefixes[i].len, (long)val);
+        }
+        else
+        {
+            printf("%016llX/%d Not Found\n", (unsigned long long)prefixes[i].k, prefixes[i].len);
+            errors++;
+        }
+    }
+
+    // same bits, other tenant
+    key = ((uint64_t)9 << 32) | 2654435761U;
+    if (radix_trie_find64(trie, key, 64, &val))
+    {
+        printf("key = %016llX should not be found\n", (unsigned long long)key);
+        errors++;
+    }
+
+    // a /40 that was never inserted
+    if (radix_trie_find64(trie, 0x20010db800ULL, 40, &val))
+    {
+        printf("%s", "20010DB800/40 should not be found\n");
+        errors++;
+    }
+
+    radix_trie_walk64(trie, count_entry);
+    if (walked != 4 * size + sizeof(prefixes)/sizeof(struct pair))
+    {
+        printf("walked %d entries\n", walked);
+        errors++;
+    }
+
+    // delete the prefixes, ids must stay
+    for (i = 0; i < sizeof(prefixes)/sizeof(struct pair); i++)
+    {
+        if (!radix_trie_delete64(trie, prefixes[i].k, prefixes[i].len))
+        {
+            printf("%016llX/%d is not deleted\n", (unsigned long long)prefixes[i].k, prefixes[i].len);
+            errors++;
+        }
+    }
+
+    walked = 0;
+    radix_trie_walk64(trie, count_entry);
+    if (walked != 4 * size)
+    {
+        printf("walked %d entries after delete\n", walked);
+        errors++;
+    }
+
+    printf("%d errors\n", errors);
+
+    // delete the whole tree
+    radix_trie_delete_all(trie);
+
+    return errors != 0;
+}
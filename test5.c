@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "radix-trie.h"
+
+/*
+ * byte string keys: CMap codes of 1 to 4 bytes, URLs sharing long
+ * prefixes, and serialized tuples with embedded 0 bytes.
+ */
+
+static const char *urls[] =
+{
+    "http://example.com/",
+    "http://example.com/index.html",
+    "http://example.com/images/a.png",
+    "http://example.com/images/b.png",
+    "http://example.org/",
+    "https://example.com/",
+    "https://example.com/login",
+};
+
+static const char *layouts[] = { "auto", "full", "compact" };
+
+static int walked;
+static unsigned char last[64];
+static size_t last_len;
+static int unsorted;
+
+static void
+check_entry(const void *key, size_t len, void *v)
+{
+    size_t m = len < last_len ? len : last_len;
+    int c = memcmp(last, key, m);
+
+    if (walked && (c > 0 || (c == 0 && last_len >= len)))
+        unsorted++;
+
+    memcpy(last, key, len < sizeof(last) ? len : sizeof(last));
+    last_len = len < sizeof(last) ? len : sizeof(last);
+    walked++;
+}
+
+/* a CMap code of "len" bytes */
+static size_t
+code(unsigned char *buf, int i, int len)
+{
+    int j;
+
+    for (j = 0; j < len; j++)
+        buf[j] = (unsigned char)(i >> (8 * (len - 1 - j)));
+    return len;
+}
+
+/* a (uint32, string) tuple */
+static size_t
+tuple(unsigned char *buf, unsigned int id, const char *s)
+{
+    buf[0] = id >> 24;
+    buf[1] = id >> 16;
+    buf[2] = id >> 8;
+    buf[3] = id;
+    strcpy((char*)buf + 4, s);
+    return 4 + strlen(s) + 1;
+}
+
+int
+main(int argc, char **argv)
+{
+    unsigned char buf[64];
+    nod *trie;
+    void *val;
+    size_t len;
+    int i, l, n, nurls = sizeof(urls) / sizeof(urls[0]);
+    int errors = 0;
+
+    for (l = 0; l < 4; l++)
+    {
+        trie = l < 3 ? radix_trie_create(l) : 0;
+        n = 0;
+
+        for (i = 0; i < 256; i++)
+        {
+            trie = radix_trie_insert_str(trie, buf, code(buf, i, 1), (void*)(long)(i + 1));
+            trie = radix_trie_insert_str(trie, buf, code(buf, 0x8140 + i, 2), (void*)(long)(0x10000 + i));
+            trie = radix_trie_insert_str(trie, buf, code(buf, i * 977, 4), (void*)(long)(0x20000 + i));
+            n += 3;
+        }
+        for (i = 0; i < nurls; i++, n++)
+            trie = radix_trie_insert_str(trie, urls[i], strlen(urls[i]), (void*)(long)(0x30000 + i));
+        for (i = 0; i < 100; i++, n++)
+            trie = radix_trie_insert_str(trie, buf, tuple(buf, i, i & 1 ? "odd" : ""), (void*)(long)(0x40000 + i));
+
+        for (i = 0; i < 256; i++)
+        {
+            if (!radix_trie_find_str(trie, buf, code(buf, i, 1), &val) || (long)val != i + 1)
+            {
+                printf("1 byte code %02X is not found\n", i);
+                errors++;
+            }
+            if (!radix_trie_find_str(trie, buf, code(buf, 0x8140 + i, 2), &val) || (long)val != 0x10000 + i)
+            {
+                printf("2 byte code %04X is not found\n", 0x8140 + i);
+                errors++;
+            }
+            if (!radix_trie_find_str(trie, buf, code(buf, i * 977, 4), &val) || (long)val != 0x20000 + i)
+            {
+                printf("4 byte code %08X is not found\n", i * 977);
+                errors++;
+            }
+            // 3 byte codes were never inserted
+            if (radix_trie_find_str(trie, buf, code(buf, i * 977, 3), &val))
+            {
+                printf("3 byte code %06X should not be found\n", i * 977);
+                errors++;
+            }
+        }
+
+        for (i = 0; i < nurls; i++)
+        {
+            if (!radix_trie_find_str(trie, urls[i], strlen(urls[i]), &val) || (long)val != 0x30000 + i)
+            {
+                printf("%s is not found\n", urls[i]);
+                errors++;
+            }
+        }
+        if (radix_trie_find_str(trie, "http://example.com/images/", 26, &val) ||
+            radix_trie_find_str(trie, "http://example.com/images/c.png", 31, &val))
+        {
+            printf("%s", "http://example.com/images/ should not be found\n");
+            errors++;
+        }
+
+        for (i = 0; i < 100; i++)
+        {
+            len = tuple(buf, i, i & 1 ? "odd" : "");
+            if (!radix_trie_find_str(trie, buf, len, &val) || (long)val != 0x40000 + i)
+            {
+                printf("tuple %d is not found\n", i);
+                errors++;
+            }
+        }
+
+        walked = 0;
+        unsorted = 0;
+        radix_trie_walk_str(trie, 0, 0, check_entry);
+        if (walked != n || unsorted)
+        {
+            printf("walked %d entries of %d, %d out of order\n", walked, n, unsorted);
+            errors++;
+        }
+
+        walked = 0;
+        radix_trie_walk_str(trie, "http://example.com/", 19, check_entry);
+        if (walked != 4)
+        {
+            printf("walked %d entries under http://example.com/\n", walked);
+            errors++;
+        }
+
+        walked = 0;
+        radix_trie_walk_str(trie, "\x81", 1, check_entry);
+        if (walked != 192 + 1)
+        {
+            printf("walked %d entries under 81\n", walked);
+            errors++;
+        }
+
+        // delete the 1 byte codes and the URLs, the rest must stay
+        for (i = 0; i < 256; i++)
+        {
+            if (!radix_trie_delete_str(trie, buf, code(buf, i, 1)))
+            {
+                printf("1 byte code %02X is not deleted\n", i);
+                errors++;
+            }
+        }
+        for (i = 0; i < nurls; i++)
+        {
+            if (!radix_trie_delete_str(trie, urls[i], strlen(urls[i])))
+            {
+                printf("%s is not deleted\n", urls[i]);
+                errors++;
+            }
+        }
+        if (radix_trie_find_str(trie, urls[0], strlen(urls[0]), &val) ||
+            radix_trie_find_str(trie, buf, code(buf, 0x41, 1), &val))
+        {
+            printf("%s", "deleted keys are still found\n");
+            errors++;
+        }
+
+        walked = 0;
+        radix_trie_walk_str(trie, 0, 0, check_entry);
+        if (walked != n - 256 - nurls)
+        {
+            printf("walked %d entries after delete\n", walked);
+            errors++;
+        }
+
+        printf("%s layout, %d errors\n", l < 3 ? layouts[l] : "NULL root", errors);
+
+        radix_trie_delete_all(trie);
+    }
+
+    return errors != 0;
+}
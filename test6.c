@@ -0,0 +1,147 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "radix-trie.h"
+
+/*
+ * radix_trie_build_sorted: the built trie must hold the same entries,
+ * walked in the same order, as the one made by inserts, for sequential
+ * keys, random keys, and prefixes of mixed length.
+ */
+
+#define SIZE 4096
+
+static uint32_t keys[SIZE];
+static int lens[SIZE];
+static void *vals[SIZE];
+
+static uint64_t seen[2][SIZE + 1];
+static int walked[2], which;
+
+static void
+record(uint32_t key, int bit, void *v)
+{
+    if (walked[which] < SIZE + 1)
+        seen[which][walked[which]] = ((uint64_t)key << 32) | ((uint64_t)bit << 24) | ((long)v & 0xffffff);
+    walked[which]++;
+}
+
+static int
+cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static int
+check(const char *name, int flags, int size)
+{
+    nod *built = radix_trie_create(flags);
+    nod *inserted = radix_trie_create(flags);
+    void *val, *v;
+    int i, errors = 0;
+
+    for (i = 0; i < size; i++)
+        inserted = radix_trie_insert(inserted, keys[i], lens[i], vals[i]);
+    built = radix_trie_build_sorted(built, keys, lens, vals, size);
+
+    for (i = 0; i < size; i++)
+    {
+        // a key given twice keeps the last value, in both
+        if (!radix_trie_find(built, keys[i], lens[i], &val) ||
+            !radix_trie_find(inserted, keys[i], lens[i], &v) || val != v)
+        {
+            printf("%s: key = %08X/%d is not found\n", name, keys[i], lens[i]);
+            errors++;
+        }
+    }
+
+    walked[0] = walked[1] = 0;
+    which = 0;
+    radix_trie_walk(built, record);
+    which = 1;
+    radix_trie_walk(inserted, record);
+    if (walked[0] != walked[1])
+    {
+        printf("%s: walked %d entries, %d inserted\n", name, walked[0], walked[1]);
+        errors++;
+    }
+    for (i = 0; i < walked[0] && i <= SIZE && !errors; i++)
+    {
+        if (seen[0][i] != seen[1][i])
+        {
+            printf("%s: entry %d differs\n", name, i);
+            errors++;
+        }
+    }
+
+    // the built trie takes inserts and deletes as any other
+    for (i = 0; i < size; i += 2)
+        radix_trie_delete(built, keys[i], lens[i]);
+    for (i = 0; i < size; i += 2)
+        built = radix_trie_insert(built, keys[i], lens[i], vals[i]);
+    for (i = 0; i < size; i++)
+    {
+        if (!radix_trie_find(built, keys[i], lens[i], &val))
+        {
+            printf("%s: key = %08X/%d is lost\n", name, keys[i], lens[i]);
+            errors++;
+        }
+    }
+
+    printf("%s, %d errors\n", name, errors);
+
+    radix_trie_delete_all(built);
+    radix_trie_delete_all(inserted);
+    return errors;
+}
+
+int
+main(int argc, char **argv)
+{
+    int i, l, errors = 0;
+
+    for (l = 0; l < 3; l++)
+    {
+        // test1 keys
+        for (i = 0; i < SIZE; i++)
+        {
+            keys[i] = i;
+            lens[i] = 32;
+            vals[i] = (void*)(long)(i + 1);
+        }
+        errors += check("sequential", l, SIZE);
+
+        srand(l);
+        for (i = 0; i < SIZE; i++)
+            keys[i] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+        qsort(keys, SIZE, sizeof(uint32_t), cmp);
+        errors += check("random", l, SIZE);
+
+        // a /16, the /24s in it and a few /32s in each, ordered as walked
+        for (i = 0; i < SIZE; i++)
+        {
+            int net = i / 16;
+
+            if (i % 16 == 0)
+            {
+                keys[i] = 0x0a00 + net;
+                lens[i] = 24;
+            }
+            else
+            {
+                keys[i] = ((0x0a00 + net) << 8) | (i % 16) * 13;
+                lens[i] = 32;
+            }
+        }
+        keys[0] = 0x000a;
+        lens[0] = 16;
+        errors += check("prefixes", l, SIZE);
+
+        // out of order, still the same entries
+        keys[SIZE / 2] = 1;
+        lens[SIZE / 2] = 32;
+        errors += check("unsorted", l, SIZE);
+    }
+
+    return errors != 0;
+}
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "radix-trie.h"
+
+/*
+ * radix_trie_find_batch: every key must give what radix_trie_find
+ * gives, for keys present and missing, prefixes of mixed length, bad
+ * lengths, and batches of any size.
+ */
+
+#define SIZE 5000
+
+static uint32_t keys[2 * SIZE];
+static uint64_t keys64[2 * SIZE];
+static int lens[2 * SIZE];
+static void *vals[2 * SIZE];
+static int found[2 * SIZE];
+
+static int
+check(const char *name, nod *trie, int size, const int *l)
+{
+    void *val;
+    size_t hits, n;
+    int i, f, errors = 0, expect = 0;
+
+    // a batch of every size up to 40, then all of them
+    for (n = 1; n <= 40; n++)
+    {
+        if (radix_trie_find_batch(trie, keys, l, n, vals, found) > n)
+            errors++;
+    }
+
+    hits = radix_trie_find_batch(trie, keys, l, size, vals, found);
+    for (i = 0; i < size; i++)
+    {
+        f = radix_trie_find(trie, keys[i], l ? l[i] : 32, &val);
+        expect += f;
+        if (f != found[i] || (f && val != vals[i]))
+        {
+            printf("%s: key = %08X/%d found %d, %d in batch\n", name, keys[i], l ? l[i] : 32, f, found[i]);
+            errors++;
+        }
+    }
+    if (hits != expect)
+    {
+        printf("%s: %lu found in batch, %d expected\n", name, (unsigned long)hits, expect);
+        errors++;
+    }
+
+    hits = radix_trie_find_batch64(trie, keys64, l, size, vals, found);
+    for (i = 0; i < size; i++)
+    {
+        f = radix_trie_find64(trie, keys64[i], l ? l[i] : 64, &val);
+        if (f != found[i] || (f && val != vals[i]))
+        {
+            printf("%s: key64 = %016llX found %d, %d in batch\n", name, (unsigned long long)keys64[i], f, found[i]);
+            errors++;
+        }
+    }
+
+    printf("%s, %d errors\n", name, errors);
+    return errors;
+}
+
+int
+main(int argc, char **argv)
+{
+    nod *trie;
+    int i, l, errors = 0;
+
+    for (l = 0; l < 3; l++)
+    {
+        // random keys, every other one is inserted
+        trie = radix_trie_create(l);
+        srand(l);
+        for (i = 0; i < 2 * SIZE; i++)
+        {
+            keys[i] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+            keys64[i] = ((uint64_t)keys[i] << 32) | (uint32_t)rand();
+            lens[i] = 32;
+            if (i & 1)
+                continue;
+            trie = radix_trie_insert(trie, keys[i], 32, (void*)(long)(i + 1));
+            trie = radix_trie_insert64(trie, keys64[i], 64, (void*)(long)(i + 2));
+        }
+        errors += check("random", trie, 2 * SIZE, 0);
+
+        // prefixes, and lengths that are never found
+        for (i = 0; i < 2 * SIZE; i++)
+        {
+            lens[i] = (i % 5 == 4) ? 0 : 8 + i % 25;
+            if (i % 7 == 0)
+                lens[i] = 40;
+            if (i & 1)
+                continue;
+            trie = radix_trie_insert(trie, keys[i], lens[i], (void*)(long)(i + 3));
+            trie = radix_trie_insert64(trie, keys64[i], lens[i], (void*)(long)(i + 4));
+        }
+        errors += check("prefixes", trie, 2 * SIZE, lens);
+
+        radix_trie_delete_all(trie);
+    }
+
+    // a NULL root finds nothing
+    if (radix_trie_find_batch(0, keys, 0, SIZE, vals, found) != 0)
+        errors++;
+
+    return errors != 0;
+}
@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "radix-trie.h"
+
+/*
+ * radix_trie_lpm: a routing table of /12 to /32 prefixes, every lookup
+ * must give the longest prefix found by probing all the lengths with
+ * radix_trie_find, before and after deleting some of the prefixes.
+ */
+
+#define SIZE 20000
+
+static uint32_t rnd(void)
+{
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+/* the longest prefix of key, the slow way */
+static int
+probe(nod *trie, uint32_t key, int *len, void **val)
+{
+    int l;
+
+    for (l = 32; l > 0; l--)
+    {
+        if (radix_trie_find(trie, key >> (32 - l), l, val))
+        {
+            *len = l;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int
+check(const char *name, nod *trie, const uint32_t *nets)
+{
+    void *v0, *v1;
+    int i, l0, l1, f0, f1, hits = 0, errors = 0;
+
+    for (i = 0; i < 4 * SIZE; i++)
+    {
+        // addresses in the table, and next to its prefixes
+        uint32_t key = i & 1 ? rnd() : nets[(i / 2) % SIZE] ^ (rnd() >> (rand() % 32));
+
+        f0 = probe(trie, key, &l0, &v0);
+        f1 = radix_trie_lpm(trie, key, &l1, &v1);
+        if (f0 != f1 || (f0 && (l0 != l1 || v0 != v1)))
+        {
+            printf("%s: %08X matched /%d, /%d expected\n", name, key, f1 ? l1 : 0, f0 ? l0 : 0);
+            errors++;
+        }
+        hits += f1;
+
+        f1 = radix_trie_lpm64(trie, (uint64_t)key << 32 | rnd(), &l1, &v1);
+        if (f0 != f1 || (f0 && (l0 != l1 || v0 != v1)))
+        {
+            printf("%s: %08X matched /%d as 64 bit key, /%d expected\n", name, key, f1 ? l1 : 0, f0 ? l0 : 0);
+            errors++;
+        }
+    }
+
+    printf("%s, %d matches, %d errors\n", name, hits, errors);
+    return errors;
+}
+
+int
+main(int argc, char **argv)
+{
+    static uint32_t nets[SIZE];
+    static int lens[SIZE];
+    static const int plen[] = { 12, 14, 16, 20, 22, 24, 24, 24, 28, 32 };
+    nod *trie;
+    void *val;
+    int i, l, len, errors = 0;
+
+    for (l = 0; l < 3; l++)
+    {
+        trie = radix_trie_create(l);
+        srand(l);
+
+        for (i = 0; i < SIZE; i++)
+        {
+            lens[i] = plen[rand() % 10];
+            nets[i] = rnd() & ~(uint32_t)0 << (32 - lens[i]);
+            trie = radix_trie_insert(trie, nets[i] >> (32 - lens[i]), lens[i], (void*)(long)(i + 1));
+        }
+        errors += check("inserted", trie, nets);
+
+        // a default route matches everything else
+        trie = radix_trie_insert(trie, 0, 1, (void*)-1L);
+        trie = radix_trie_insert(trie, 1, 1, (void*)-2L);
+        if (!radix_trie_lpm(trie, 0x8badf00d, &len, &val) || len < 1)
+        {
+            printf("%s", "no default route\n");
+            errors++;
+        }
+        errors += check("default route", trie, nets);
+
+        for (i = 0; i < SIZE; i += 3)
+            radix_trie_delete(trie, nets[i] >> (32 - lens[i]), lens[i]);
+        errors += check("deleted", trie, nets);
+
+        radix_trie_delete_all(trie);
+    }
+
+    if (radix_trie_lpm(0, 0, &len, &val))
+        errors++;
+
+    return errors != 0;
+}
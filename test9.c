@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "radix-trie.h"
+
+/*
+ * cursors: a scan from radix_trie_first must hand out what
+ * radix_trie_walk64 does, radix_trie_last and radix_trie_prev the same
+ * backwards, and lower_bound/upper_bound must land where a search of
+ * the walked entries does, for keys of mixed length.
+ */
+
+#define SIZE 6000
+
+struct entry
+{
+    uint64_t key;
+    int len;
+    void *v;
+};
+
+static struct entry walked[SIZE + 1];
+static int nwalked;
+
+static void
+record(uint64_t key, int bit, void *v)
+{
+    if (nwalked < SIZE)
+    {
+        walked[nwalked].key = key;
+        walked[nwalked].len = bit;
+        walked[nwalked].v = v;
+    }
+    nwalked++;
+}
+
+static uint32_t
+rnd(void)
+{
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+/* the index of the first walked entry not before (k, len) */
+static int
+search(uint64_t k, int len)
+{
+    int i;
+
+    for (i = 0; i < nwalked; i++)
+    {
+        if (walked[i].key > k || (walked[i].key == k && walked[i].len >= len))
+            break;
+    }
+    return i;
+}
+
+static int
+same(radix_trie_cursor *c, int i)
+{
+    return c->key == walked[i].key && c->len == walked[i].len && c->value == walked[i].v;
+}
+
+static int
+check(const char *name, nod *trie)
+{
+    radix_trie_cursor c;
+    int i, j, ok, len, errors = 0;
+    uint64_t k;
+
+    nwalked = 0;
+    radix_trie_walk64(trie, record);
+
+    // forward
+    for (i = 0, ok = radix_trie_first(&c, trie); ok; ok = radix_trie_next(&c), i++)
+    {
+        if (i >= nwalked || !same(&c, i))
+            break;
+    }
+    if (ok || i != nwalked)
+    {
+        printf("%s: forward scan differs at %d of %d\n", name, i, nwalked);
+        errors++;
+    }
+
+    // backward
+    for (i = nwalked - 1, ok = radix_trie_last(&c, trie); ok; ok = radix_trie_prev(&c), i--)
+    {
+        if (i < 0 || !same(&c, i))
+            break;
+    }
+    if (ok || i != -1)
+    {
+        printf("%s: backward scan differs at %d of %d\n", name, i, nwalked);
+        errors++;
+    }
+
+    for (j = 0; j < 2000 && nwalked; j++)
+    {
+        // stored keys, and keys next to them
+        i = rand() % nwalked;
+        len = j & 1 ? walked[i].len : 1 + rand() % 32;
+        k = walked[i].key ^ (j & 2 ? (uint64_t)rnd() << (rand() % 32) : 0);
+        k = (k >> 32) >> (32 - len);
+
+        i = search(k << (64 - len), len);
+        ok = radix_trie_lower_bound(&c, trie, (uint32_t)k, len);
+        if (ok != (i < nwalked) || (ok && !same(&c, i)))
+        {
+            printf("%s: lower_bound %08X/%d is not entry %d\n", name, (uint32_t)k, len, i);
+            errors++;
+            continue;
+        }
+        if (i < nwalked && walked[i].key == k << (64 - len) && walked[i].len == len)
+            i++;
+        ok = radix_trie_upper_bound(&c, trie, (uint32_t)k, len);
+        if (ok != (i < nwalked) || (ok && !same(&c, i)))
+        {
+            printf("%s: upper_bound %08X/%d is not entry %d\n", name, (uint32_t)k, len, i);
+            errors++;
+            continue;
+        }
+
+        // a step back and forth
+        if (ok && i > 0)
+        {
+            if (!radix_trie_prev(&c) || !same(&c, i - 1) ||
+                !radix_trie_next(&c) || !same(&c, i))
+            {
+                printf("%s: prev/next around entry %d\n", name, i);
+                errors++;
+            }
+        }
+    }
+
+    printf("%s, %d entries, %d errors\n", name, nwalked, errors);
+    return errors;
+}
+
+int
+main(int argc, char **argv)
+{
+    radix_trie_cursor c;
+    nod *trie;
+    int i, l, len, count, errors = 0;
+
+    for (l = 0; l < 4; l++)
+    {
+        trie = l < 3 ? radix_trie_create(l) : 0;
+        srand(l);
+
+        for (i = 0; i < SIZE / 2; i++)
+            trie = radix_trie_insert(trie, rnd(), 32, (void*)(long)(i + 1));
+        errors += check("random", trie);
+
+        for (i = 0; i < SIZE / 2; i++)
+        {
+            len = 1 + rand() % 32;
+            trie = radix_trie_insert(trie, rnd() >> (32 - len), len, (void*)(long)(SIZE + i));
+        }
+        errors += check("prefixes", trie);
+
+        radix_trie_delete_all(trie);
+    }
+
+    // CJK unified ideographs out of a code point map, stopping early
+    trie = radix_trie_create(RADIX_TRIE_AUTO);
+    for (i = 0; i < 0x30000; i += 3)
+        trie = radix_trie_insert(trie, i, 32, (void*)(long)(i + 1));
+    count = 0;
+    for (l = radix_trie_lower_bound(&c, trie, 0x4e00, 32); l && (c.key >> 32) <= 0x9fff; l = radix_trie_next(&c))
+        count++;
+    if (count != (0x9fff - 0x4e00 + 1 + 2) / 3)
+    {
+        printf("%d code points in 4E00..9FFF\n", count);
+        errors++;
+    }
+    radix_trie_delete_all(trie);
+
+    if (radix_trie_first(&c, 0) || radix_trie_last(&c, 0) || radix_trie_next(&c))
+        errors++;
+
+    return errors != 0;
+}